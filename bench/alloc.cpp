@@ -0,0 +1,106 @@
+// cluster allocation under contention: every thread stores files of n clusters and removes
+// the oldest once it holds more than a few, so clusters keep going out of and back into the
+// allocator from all threads at once. usage: alloc [seconds per run]
+#include <atomic>
+#include <deque>
+#include <thread>
+
+#include "bench.h"
+
+using namespace VFS;
+using namespace VFS::IFS;
+
+namespace {
+    constexpr int HOLD = 8;
+
+    struct result_t {
+        double files_s;
+        double clusters_s;
+    };
+
+    result_t run(fat32& fs, int threads, uint32_t clus, double secs) {
+        std::atomic<bool> go = {false}, stop = {false};
+        std::atomic<uint64_t> ops = {};
+        std::vector<std::thread> workers;
+
+        for(int t = 0; t < threads; t++) {
+            workers.emplace_back([&, t] {
+                buffer sink;
+                buffer::scope bind(sink);
+
+                std::string dir = "t" + std::to_string(t);
+                fs.mkdir(dir.c_str());
+
+                // each cluster is stamped with the file's number, nothing dedups against anything else.
+                std::vector<char> data(clus * CFG_CLUSTER_SIZE, 'x');
+                std::deque<std::string> live;
+                uint64_t k = {};
+
+                while(!go)
+                    std::this_thread::yield();
+
+                while(!stop) {
+                    for(uint32_t c = 0; c < clus; c++)
+                        snprintf(data.data() + c * CFG_CLUSTER_SIZE, 32, "%d/%lu/%u", t, (unsigned long)k, c);
+
+                    std::vector<std::string> touch = {dir + "/f" + std::to_string(k % 100000)};
+                    fs.touch(touch, data.data(), data.size());
+                    live.push_back(touch[0]);
+
+                    if(live.size() > HOLD) {
+                        std::vector<std::string> rm = {live.front()};
+                        fs.rm(rm);
+                        live.pop_front();
+                    }
+                    sink.clear();
+                    k++;
+                }
+
+                for(auto& it : live) {
+                    std::vector<std::string> rm = {it};
+                    fs.rm(rm);
+                }
+                std::vector<std::string> rm = {dir};
+                fs.rm(rm);
+                ops += k;
+            });
+        }
+
+        auto start = bench::now();
+        go = true;
+        std::this_thread::sleep_for(std::chrono::duration<double>(secs));
+        stop = true;
+
+        for(auto& it : workers)
+            it.join();
+
+        double elapsed = bench::ms_since(start) / 1e3;
+        return {ops / elapsed, ops * (double)clus / elapsed};
+    }
+}
+
+int main(int argc, char** argv) {
+    double secs = argc > 1 ? atof(argv[1]) : 2.0;
+
+    bench::scratch_disk("alloc");
+    buffer out;
+    buffer::scope bind(out);
+    fat32 fs("alloc");
+    out.clear();
+
+    uint32_t start_free = bench::free_clusters(fs, out);
+    printf("hardware threads: %u, cluster %lu bytes, %.1fs per run\n", std::thread::hardware_concurrency(), (unsigned long)CFG_CLUSTER_SIZE, secs);
+
+    int bad = 0;
+    for(uint32_t clus : {1u, 8u, 64u}) {
+        for(int threads : {1, 2, 4, 8}) {
+            result_t r = run(fs, threads, clus, secs);
+            uint32_t free_n = bench::free_clusters(fs, out);
+
+            printf("threads %d, %2u clusters/file: %9.0f files/s  %7.3f Mclusters/s%s\n", threads, clus, r.files_s, r.clusters_s / 1e6,
+                   free_n == start_free ? "" : "  (clusters not given back)");
+            bad += free_n != start_free;
+        }
+    }
+    return bad;
+}
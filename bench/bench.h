@@ -0,0 +1,64 @@
+#ifndef _BENCH_H_
+#define _BENCH_H_
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "fat32.h"
+#include "buffer.h"
+
+// helpers shared by the programs under bench/, each one runs on a scratch disk of its own in ./disks.
+namespace bench {
+
+    using clock = std::chrono::steady_clock;
+
+    inline clock::time_point now() noexcept {
+        return clock::now();
+    }
+
+    inline double ms_since(clock::time_point start) noexcept {
+        return std::chrono::duration<double, std::milli>(clock::now() - start).count();
+    }
+
+    // a fresh disk every run, left behind in ./disks for a look afterwards.
+    inline void scratch_disk(const char* name) noexcept {
+        std::string cmd = std::string("mkdir -p disks && rm -f disks/") + name;
+        if(system(cmd.c_str()) != 0)
+            fprintf(stderr, "could not clear disks/%s\n", name);
+    }
+
+    // reproducible contents that differ between seeds and from one cluster to the next.
+    inline std::string pattern(uint64_t seed, size_t n) noexcept {
+        std::string s(n, 0);
+        for(size_t i = 0; i < n; i++)
+            s[i] = (char)('a' + (seed * 7 + i * 13 + i / 4096) % 26);
+        return s;
+    }
+
+    // the free cluster count as print_super_block reports it, out is the sink bound for this thread.
+    inline uint32_t free_clusters(VFS::IFS::fat32& fs, VFS::buffer& out) noexcept {
+        out.clear();
+        fs.print_super_block();
+        std::string s(out.data(), out.size());
+        out.clear();
+
+        size_t at = s.rfind("Clusters free:");
+        return at == std::string::npos ? 0 : (uint32_t)atoi(s.c_str() + at + 14);
+    }
+
+    // p50/p99/max of a set of samples in ms.
+    inline void print_latency(const char* name, std::vector<double>& samples) noexcept {
+        if(samples.empty())
+            return;
+
+        std::sort(samples.begin(), samples.end());
+        printf("%-8s n=%-6zu p50 %8.3fms  p99 %8.3fms  max %8.3fms\n", name, samples.size(),
+               samples[samples.size() / 2], samples[samples.size() * 99 / 100], samples.back());
+    }
+}
+
+#endif // _BENCH_H_
@@ -0,0 +1,91 @@
+// crc32c: the check value, the hardware path against slicing-by-8 over random buffers, lengths and
+// alignments, a crc carried on over split buffers, then the throughput of each. usage: crc
+#include <chrono>
+#include <random>
+#include <vector>
+#include <stdio.h>
+
+#include "crc32c.h"
+
+using namespace VFS;
+
+namespace {
+    typedef uint32_t (*crc_fn)(uint32_t, const char*, size_t);
+
+    int check(const char* what, uint32_t got, uint32_t want) {
+        if(got == want)
+            return 0;
+
+        printf("%s: %08x, expected %08x\n", what, got, want);
+        return 1;
+    }
+
+    double throughput(crc_fn fn, const std::vector<char>& buf, size_t len) {
+        uint32_t crc = 0;
+        uint64_t done = 0;
+        auto start = std::chrono::steady_clock::now();
+        double secs = 0;
+
+        while(secs < 0.3) {
+            for(size_t off = 0; off + len <= buf.size(); off += len)
+                crc = fn(crc, buf.data() + off, len);
+            done += buf.size() / len * len;
+            secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+
+        // keeps the loop from being thrown away.
+        if(crc == 0x12345678)
+            printf(" ");
+        return done / secs / 1e9;
+    }
+}
+
+int main() {
+    bool hw = crc32c::has_hardware();
+    int bad = 0;
+
+    bad += check("software(\"123456789\")", crc32c::software(0, "123456789", 9), 0xE3069283);
+    bad += check("update(\"123456789\")", crc32c::update(0, "123456789", 9), 0xE3069283);
+    bad += check("software of nothing", crc32c::software(0, "", 0), 0);
+    if(hw)
+        bad += check("hardware(\"123456789\")", crc32c::hardware(0, "123456789", 9), 0xE3069283);
+
+    // long enough to cover the blocks done three at a time and joined with fold, at every alignment.
+    std::mt19937_64 rng(1);
+    std::vector<char> buf(crc32c::LONG_BLOCK * 3 * 4 + 64);
+    for(auto& it : buf)
+        it = (char)rng();
+
+    for(int i = 0; i < 20000; i++) {
+        size_t len = i % 10 == 0 ? rng() % (buf.size() - 64) : rng() % 4096;
+        size_t align = rng() % 64;
+        size_t split = len ? rng() % len : 0;
+        const char* data = buf.data() + align;
+
+        uint32_t sw = crc32c::software(0, data, len);
+        uint32_t carried = crc32c::update(crc32c::update(0, data, split), data + split, len - split);
+
+        if(hw && crc32c::hardware(0, data, len) != sw) {
+            printf("hardware and slicing-by-8 differ at length %zu, alignment %zu\n", len, align);
+            bad++;
+        }
+        if(carried != sw) {
+            printf("crc carried over a split at %zu of %zu differs\n", split, len);
+            bad++;
+        }
+    }
+
+    printf("crc32c: %s, %d bad\n", crc32c::impl(), bad);
+
+    std::vector<char> big(1 << 20);
+    for(auto& it : big)
+        it = (char)rng();
+
+    for(size_t len : {64ul, 1024ul, 16384ul, 1ul << 20}) {
+        printf("%7zu byte buffers:", len);
+        if(hw)
+            printf("  hardware %6.2f GB/s", throughput(&crc32c::hardware, big, len));
+        printf("  slicing-by-8 %5.2f GB/s\n", throughput(&crc32c::software, big, len));
+    }
+    return bad;
+}
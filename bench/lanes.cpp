@@ -0,0 +1,57 @@
+// times a cp imp and a cp exp of one file through a server, the two copies are compared after.
+// usage: lanes <port> <local file> [runs]
+#include <chrono>
+#include <thread>
+#include <fstream>
+#include <iterator>
+
+#include "vfs.h"
+#include "client.h"
+
+using namespace VFS;
+
+namespace {
+    double timed(RFS::client& conn, std::vector<std::string> args) {
+        auto start = std::chrono::steady_clock::now();
+        uint64_t id = conn.request("cp", (uint8_t)vfs::system_cmd::cp, args, [](const RFS::rfs::message_t&) {});
+        conn.wait(id);
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    bool same(const char* a, const char* b) {
+        std::ifstream fa(a, std::ios::binary), fb(b, std::ios::binary);
+        return std::equal(std::istreambuf_iterator<char>(fa), std::istreambuf_iterator<char>(),
+                          std::istreambuf_iterator<char>(fb), std::istreambuf_iterator<char>());
+    }
+}
+
+int main(int argc, char** argv) {
+    if(argc < 3) {
+        fprintf(stderr, "usage: lanes <port> <local file> [runs]\n");
+        return 1;
+    }
+
+    int runs = argc > 3 ? atoi(argv[3]) : 1;
+    std::string out = std::string(argv[2]) + ".out";
+    RFS::client conn("127.0.0.1", atoi(argv[1]));
+
+    // the hello has to be answered before lanes are offered.
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+
+    int bad = 0;
+    for(int i = 0; i < runs; i++) {
+        remove(out.c_str());
+        double imp = timed(conn, {"imp", argv[2], "lanes"});
+        double exp = timed(conn, {"exp", "lanes", out.c_str()});
+        bool ok = same(argv[2], out.c_str());
+
+        fprintf(stderr, "imp %.2fs  exp %.2fs%s\n", imp, exp, ok ? "" : "  (copy differs)");
+        bad += !ok;
+
+        std::vector<std::string> rm = {"lanes"};
+        uint64_t id = conn.request("rm", (uint8_t)vfs::system_cmd::rm, rm, [](const RFS::rfs::message_t&) {});
+        conn.wait(id);
+    }
+    remove(out.c_str());
+    return bad;
+}
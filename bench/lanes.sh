@@ -0,0 +1,44 @@
+#!/bin/bash
+# cp imp/exp of a file of random data through wanproxy, first over a single connection and then
+# with lanes. the server is the filesystem built at the top, run on a scratch disk in bench/disks.
+# usage: ./lanes.sh [delay ms] [window bytes] [MB] [runs]
+DELAY=${1:-25}
+WINDOW=${2:-1048576}
+MB=${3:-64}
+RUNS=${4:-2}
+PORT=52222
+PROXY=52320
+
+cd "$(dirname "$0")"
+if [ ! -x ../filesystem ] || [ ! -x ./lanes ] || [ ! -x ./wanproxy ]; then
+    echo "build first: make at the top, then make -C bench lanes wanproxy"
+    exit 1
+fi
+
+mkdir -p disks && rm -f disks/lanes
+head -c $((MB << 20)) /dev/urandom > disks/lanes.bin
+
+# the server reads its commands from a pipe that stays open until it's told to exit.
+rm -f disks/server.in && mkfifo disks/server.in
+../filesystem < disks/server.in > disks/server.log 2>&1 &
+SERVER=$!
+exec 3> disks/server.in
+printf '/vfs ifs add lanes\n/vfs mnt lanes\n/vfs server\n' >&3
+sleep 1
+
+for CONNS in 1 0; do
+    ./wanproxy $PROXY $PORT $DELAY $WINDOW $([ $CONNS = 1 ] && echo 1) &
+    WAN=$!
+    sleep 0.3
+
+    echo "$([ $CONNS = 1 ] && echo "one connection" || echo "lanes"), ${MB}MB, ${DELAY}ms each way, ${WINDOW} byte window:"
+    ./lanes $PROXY disks/lanes.bin $RUNS > /dev/null
+    kill $WAN; wait $WAN 2>/dev/null
+done
+
+printf '/exit\n' >&3
+exec 3>&-
+sleep 1
+kill $SERVER 2>/dev/null
+wait $SERVER 2>/dev/null
+rm -f disks/server.in disks/lanes.bin
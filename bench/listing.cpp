@@ -0,0 +1,58 @@
+// output side of the terminal commands: ls of a directory holding many entries and cat of a
+// large file, both formatted into the session's buffer. usage: listing [entries] [file MB]
+#include "bench.h"
+
+using namespace VFS;
+using namespace VFS::IFS;
+
+namespace {
+    template<typename F>
+    double best_of(int runs, buffer& out, F&& op) {
+        double best = 1e18;
+
+        for(int i = 0; i < runs; i++) {
+            out.clear();
+            auto start = bench::now();
+            op();
+            best = std::min(best, bench::ms_since(start));
+        }
+        out.clear();
+        return best;
+    }
+}
+
+int main(int argc, char** argv) {
+    int entries = argc > 1 ? atoi(argv[1]) : 10000;
+    uint64_t file_mb = argc > 2 ? atoi(argv[2]) : 100;
+
+    bench::scratch_disk("listing");
+    buffer out;
+    buffer::scope bind(out);
+    fat32 fs("listing");
+
+    fs.mkdir("big");
+    for(int i = 0; i < entries; i++) {
+        std::vector<std::string> touch = {"big/f" + std::to_string(i), "x"};
+        fs.touch(touch, nullptr, 0);
+        out.clear();
+    }
+
+    std::string block = bench::pattern(1, MB(1));
+    int fd = fs.open("file", O_CREAT | O_TRUNC | O_WRONLY);
+    for(uint64_t i = 0; i < file_mb; i++)
+        fs.write(fd, block.data(), block.size());
+    fs.close(fd);
+
+    // ls lists the working directory, the listing is the size of what it printed.
+    fs.cd("big");
+    size_t listed = 0;
+    double ls_ms = best_of(10, out, [&] { fs.ls(); listed = out.size(); });
+    fs.cd("..");
+
+    size_t shown = 0;
+    double cat_ms = best_of(5, out, [&] { fs.cat("file"); shown = out.size(); });
+
+    printf("ls, %d entries:  %8.2f ms (%zu bytes out)\n", entries, ls_ms, listed);
+    printf("cat, %lu MB file: %8.2f ms (%.1f MB/s)\n", (unsigned long)file_mb, cat_ms, shown / cat_ms / 1e3);
+    return !(listed > (size_t)entries && shown >= file_mb * MB(1));
+}
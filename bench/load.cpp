@@ -0,0 +1,234 @@
+// many clients on one server, speaking the wire protocol directly so a single thread can hold
+// thousands of connections. idle ones only say hello and ping, active ones send ls requests back
+// to back once they've been greeted. usage: load <port> [idle] [active] [requests] [seconds] [server pid]
+#include <chrono>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+
+#include "vfs.h"
+#include "rfs.h"
+
+using namespace VFS;
+using namespace VFS::RFS;
+
+namespace {
+    using clock = std::chrono::steady_clock;
+
+    struct conn_t {
+        int fd = -1;
+        bool active = {};
+        bool greeted = {};
+        bool closed = {};
+        rfs::reader_t reader = {};
+        std::string tx = {};
+        uint64_t next_id = {};
+        uint32_t left = {};
+        clock::time_point sent = {};
+    };
+
+    // only the framing of rfs is used, every connection goes through the one loop below.
+    class wire : public rfs {
+    public:
+        void init() noexcept override {}
+        void run() noexcept override {}
+        void define_fd() noexcept override {}
+
+        // frames are plain, without the lz and crc a client offering no capabilities never gets.
+        void frame(std::string& out, int8_t cmd, uint64_t id, const std::string& args, const char* body, size_t size) const noexcept {
+            for_each_frame(cmd, id, args, body, size, CFG_FRAME_MIN_SIZE, 0,
+                [&](const char* header, size_t header_size, const char* data, uint64_t data_size) {
+                    out.append(header, header_size);
+                    out.append(data, data_size);
+                });
+        }
+
+        void hello(std::string& out) const noexcept {
+            char body[HELLO_SIZE];
+            size_t size = {};
+            hello_body(body, size, 0, 0, 0);
+            frame(out, (int8_t)type_t::hello, 0, std::string(CFG_PACKET_SIGNATURE, CFG_PACKET_SIGNATURE_SIZE), body, size);
+        }
+
+        uint8_t read(rfs::reader_t& reader, std::vector<std::shared_ptr<message_t>>& msgs) const noexcept {
+            return read_frames(reader, msgs, CFG_FRAME_MAX_SIZE, CFG_RFS_REPLY_MAX_SIZE, 0);
+        }
+    };
+
+    uint64_t server_rss_kb(int pid) {
+        char path[64];
+        snprintf(path, sizeof(path), "/proc/%d/status", pid);
+
+        FILE* file = fopen(path, "r");
+        char line[256];
+        uint64_t kb = {};
+
+        while(file && fgets(line, sizeof(line), file)) {
+            if(strncmp(line, "VmRSS:", 6) == 0)
+                kb = strtoull(line + 6, nullptr, 10);
+        }
+        if(file)
+            fclose(file);
+        return kb;
+    }
+
+    void flush(conn_t& conn) {
+        while(!conn.tx.empty()) {
+            ssize_t sent = ::send(conn.fd, conn.tx.data(), conn.tx.size(), MSG_NOSIGNAL);
+            if(sent <= 0)
+                return;
+            conn.tx.erase(0, sent);
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    if(argc < 2) {
+        fprintf(stderr, "usage: load <port> [idle] [active] [requests] [seconds] [server pid]\n");
+        return 1;
+    }
+
+    int port = atoi(argv[1]);
+    int idle = argc > 2 ? atoi(argv[2]) : 1000;
+    int active = argc > 3 ? atoi(argv[3]) : 100;
+    uint32_t requests = argc > 4 ? atoi(argv[4]) : 50;
+    double secs = argc > 5 ? atof(argv[5]) : 15;
+    int server_pid = argc > 6 ? atoi(argv[6]) : 0;
+
+    // a descriptor for every connection, plus a few.
+    rlimit lim = {};
+    getrlimit(RLIMIT_NOFILE, &lim);
+    lim.rlim_cur = lim.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &lim);
+
+    wire proto;
+    std::vector<conn_t> conns(idle + active);
+    int epfd = epoll_create1(0);
+    uint64_t rss_before = server_pid ? server_rss_kb(server_pid) : 0;
+
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    int connected = 0;
+    for(size_t i = 0; i < conns.size(); i++) {
+        conn_t& conn = conns[i];
+        conn.fd = socket(AF_INET, SOCK_STREAM, 0);
+        conn.active = i >= (size_t)idle;
+        conn.left = conn.active ? requests : 0;
+
+        if(conn.fd == -1 || connect(conn.fd, (sockaddr*)&addr, sizeof(addr)) == -1) {
+            if(conn.fd != -1)
+                close(conn.fd);
+            conn.fd = -1;
+            conn.closed = true;
+            continue;
+        }
+
+        int one = 1;
+        setsockopt(conn.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        fcntl(conn.fd, F_SETFL, fcntl(conn.fd, F_GETFL) | O_NONBLOCK);
+
+        epoll_event ev = {};
+        ev.events = EPOLLIN;
+        ev.data.u64 = i;
+        epoll_ctl(epfd, EPOLL_CTL_ADD, conn.fd, &ev);
+
+        proto.hello(conn.tx);
+        flush(conn);
+        connected++;
+    }
+
+    std::vector<double> latency;
+    uint64_t sent_n = {}, replied_n = {}, dropped_n = {};
+    auto start = clock::now(), last_ping = start;
+    std::vector<epoll_event> events(256);
+
+    while(clock::now() - start < std::chrono::duration<double>(secs)) {
+        int n = epoll_wait(epfd, events.data(), (int)events.size(), 100);
+
+        for(int e = 0; e < n; e++) {
+            conn_t& conn = conns[events[e].data.u64];
+            char buf[KB(64)];
+            ssize_t got;
+
+            while((got = ::recv(conn.fd, buf, sizeof(buf), 0)) > 0)
+                conn.reader.rx.insert(conn.reader.rx.end(), buf, buf + got);
+
+            std::vector<std::shared_ptr<rfs::message_t>> msgs;
+            if(got == 0 || proto.read(conn.reader, msgs) == 0) {
+                epoll_ctl(epfd, EPOLL_CTL_DEL, conn.fd, nullptr);
+                close(conn.fd);
+                conn.closed = true;
+                dropped_n += conn.active && conn.next_id > 0 && conn.left > 0;
+                continue;
+            }
+
+            for(auto& msg : msgs) {
+                bool reply = msg->cmd == (int8_t)rfs::type_t::internal && msg->id != 0 && msg->id == conn.next_id;
+                if(msg->cmd == (int8_t)rfs::type_t::hello)
+                    conn.greeted = true;
+
+                if(reply) {
+                    latency.push_back(std::chrono::duration<double, std::milli>(clock::now() - conn.sent).count());
+                    replied_n++;
+                    conn.left--;
+                }
+
+                // the next request goes out once the last one is answered, the first once greeted.
+                bool ready = msg->cmd == (int8_t)rfs::type_t::hello || reply;
+                if(conn.active && conn.greeted && conn.left > 0 && ready) {
+                    proto.frame(conn.tx, (int8_t)vfs::system_cmd::ls, ++conn.next_id, "", nullptr, 0);
+                    conn.sent = clock::now();
+                    sent_n++;
+                }
+            }
+            flush(conn);
+        }
+
+        // the server hangs up on a client it hasn't heard from, every connection pings each interval.
+        if(clock::now() - last_ping >= std::chrono::milliseconds(CFG_HEARTBEAT_INTERVAL)) {
+            for(auto& conn : conns) {
+                if(conn.closed)
+                    continue;
+
+                proto.frame(conn.tx, (int8_t)rfs::type_t::ping, 0, "", nullptr, 0);
+                flush(conn);
+            }
+            last_ping = clock::now();
+        }
+    }
+
+    int greeted_n = 0;
+    for(auto& conn : conns) {
+        greeted_n += conn.greeted && !conn.closed;
+    }
+    uint64_t rss_after = server_pid ? server_rss_kb(server_pid) : 0;
+
+    printf("%d idle + %d active: %d/%zu connected, %d still open and greeted after %.0fs\n",
+           idle, active, connected, conns.size(), greeted_n, secs);
+    printf("requests: %lu sent, %lu answered, %lu connections dropped mid-run\n",
+           (unsigned long)sent_n, (unsigned long)replied_n, (unsigned long)dropped_n);
+
+    if(!latency.empty()) {
+        std::sort(latency.begin(), latency.end());
+        printf("ls latency: p50 %.2fms  p99 %.2fms  max %.2fms\n",
+               latency[latency.size() / 2], latency[latency.size() * 99 / 100], latency.back());
+    }
+    if(server_pid && connected > 0)
+        printf("server rss: %lu KB -> %lu KB, %+.2f KB per connection\n", (unsigned long)rss_before,
+               (unsigned long)rss_after, ((double)rss_after - rss_before) / connected);
+
+    for(auto& conn : conns) {
+        if(!conn.closed)
+            close(conn.fd);
+    }
+    return !(greeted_n == (int)conns.size() && replied_n == (uint64_t)active * requests);
+}
@@ -0,0 +1,37 @@
+#!/bin/bash
+# many clients against one server: idle ones that only keep their connection alive and active ones
+# sending ls back to back. the server is the filesystem built at the top, run on a scratch disk.
+# usage: ./load.sh [idle] [active] [requests] [seconds]
+IDLE=${1:-1000}
+ACTIVE=${2:-100}
+REQUESTS=${3:-50}
+SECS=${4:-15}
+PORT=52222
+
+cd "$(dirname "$0")"
+if [ ! -x ../filesystem ] || [ ! -x ./load ]; then
+    echo "build first: make at the top, then make -C bench load"
+    exit 1
+fi
+
+ulimit -n $(ulimit -Hn)
+mkdir -p disks && rm -f disks/load
+
+# the server reads its commands from a pipe that stays open until it's told to exit.
+rm -f disks/server.in && mkfifo disks/server.in
+../filesystem < disks/server.in > disks/server.log 2>&1 &
+SERVER=$!
+exec 3> disks/server.in
+printf '/vfs ifs add load\n/vfs mnt load\n/vfs server\n' >&3
+sleep 1
+
+./load $PORT $IDLE $ACTIVE $REQUESTS $SECS $SERVER
+STATUS=$?
+
+printf '/exit\n' >&3
+exec 3>&-
+sleep 1
+kill $SERVER 2>/dev/null
+wait $SERVER 2>/dev/null
+rm -f disks/server.in
+exit $STATUS
@@ -0,0 +1,222 @@
+// readers against writers. with no arguments, checks that a reader keeps seeing the file it opened
+// while it's removed, truncated, rewritten and written over in place, that writers never land in
+// clusters handed on to another file, and that a reader's clusters come back once it closes.
+// usage: snapshot [lat <entries> <seconds>] to time ls/cat in a directory a writer keeps changing.
+#include <map>
+#include <atomic>
+#include <thread>
+#include <memory>
+
+#include "bench.h"
+
+using namespace VFS;
+using namespace VFS::IFS;
+
+namespace {
+    void put(fat32& fs, const std::string& path, const std::string& data) {
+        int fd = fs.open(path.c_str(), O_CREAT | O_TRUNC | O_WRONLY);
+        fs.write(fd, data.data(), data.size());
+        fs.close(fd);
+    }
+
+    std::string get(fat32& fs, int fd, size_t n) {
+        std::string s(n, 0);
+        int64_t got = fs.read(fd, s.data(), n);
+        s.resize(got < 0 ? 0 : got);
+        return s;
+    }
+
+    void rm(fat32& fs, const std::string& path) {
+        std::vector<std::string> tokens = {path};
+        fs.rm(tokens);
+    }
+
+    int snap(std::unique_ptr<fat32>& fs, buffer& out) {
+        int bad = 0;
+        uint32_t start_free = bench::free_clusters(*fs, out);
+        std::string a = bench::pattern(1, 3 << 20), b = bench::pattern(2, 1 << 20), c = bench::pattern(3, 2 << 20);
+
+        put(*fs, "a", a);
+        put(*fs, "b", b);
+        int ra = fs->open("a", O_RDONLY), rb = fs->open("b", O_RDONLY);
+
+        // a is removed and its space written over, b is truncated and rewritten.
+        rm(*fs, "a");
+        for(int i = 0; i < 4; i++)
+            put(*fs, "f" + std::to_string(i), bench::pattern(10 + i, 1 << 20));
+        put(*fs, "b", c);
+
+        if(get(*fs, ra, a.size()) != a) {
+            printf("removed file changed under its reader\n");
+            bad++;
+        }
+        if(get(*fs, rb, b.size()) != b) {
+            printf("rewritten file changed under its reader\n");
+            bad++;
+        }
+
+        int nb = fs->open("b", O_RDONLY);
+        if(get(*fs, nb, c.size()) != c) {
+            printf("a new reader doesn't see the new b\n");
+            bad++;
+        }
+
+        // d is written through a handle of its own, in the middle and past the end.
+        std::string d = bench::pattern(4, 2 << 20), patch = bench::pattern(5, 100000);
+        put(*fs, "d", d);
+        int rd = fs->open("d", O_RDONLY), wd = fs->open("d", O_WRONLY);
+        fs->pwrite(wd, patch.data(), patch.size(), 1 << 20);
+        fs->lseek(wd, 0, SEEK_END);
+        fs->write(wd, patch.data(), patch.size());
+        fs->close(wd);
+
+        std::string nd = d;
+        nd.replace(1 << 20, patch.size(), patch);
+        nd += patch;
+        int nrd = fs->open("d", O_RDONLY);
+
+        if(get(*fs, rd, nd.size()) != d) {
+            printf("file written over in place changed under its reader\n");
+            bad++;
+        }
+        if(get(*fs, nrd, nd.size()) != nd) {
+            printf("a new reader doesn't see the writes to d\n");
+            bad++;
+        }
+
+        uint32_t held = bench::free_clusters(*fs, out);
+        fs->close(ra);
+        fs->close(rb);
+        fs->close(nb);
+        fs->close(rd);
+        fs->close(nrd);
+        uint32_t closed = bench::free_clusters(*fs, out);
+
+        // e is replaced through a truncating handle while another writes to it, g is removed under
+        // its writer. neither may write into the clusters h gets meanwhile, the last close wins.
+        put(*fs, "e", bench::pattern(6, 1 << 20));
+        put(*fs, "g", bench::pattern(7, 1 << 20));
+        int we = fs->open("e", O_WRONLY), wg = fs->open("g", O_WRONLY);
+        put(*fs, "e", bench::pattern(8, 1 << 20));
+        rm(*fs, "g");
+
+        std::string h = bench::pattern(9, 3 << 20), late = bench::pattern(10, 2 << 20);
+        put(*fs, "h", h);
+        fs->pwrite(we, late.data(), late.size(), 0);
+        fs->pwrite(wg, late.data(), late.size(), 0);
+        fs->close(we);
+        fs->close(wg);
+
+        int rh = fs->open("h", O_RDONLY), re = fs->open("e", O_RDONLY);
+        if(get(*fs, rh, h.size()) != h) {
+            printf("a writer wrote into clusters handed on to another file\n");
+            bad++;
+        }
+        if(get(*fs, re, late.size() + 1) != late) {
+            printf("the last writer to close didn't leave its version of e\n");
+            bad++;
+        }
+        fs->close(rh);
+        fs->close(re);
+        rm(*fs, "e");
+        rm(*fs, "h");
+
+        for(int i = 0; i < 4; i++)
+            rm(*fs, "f" + std::to_string(i));
+        rm(*fs, "b");
+        rm(*fs, "d");
+        uint32_t end_free = bench::free_clusters(*fs, out);
+
+        printf("free clusters: start %u, readers open %u, closed %u, all removed %u\n", start_free, held, closed, end_free);
+        if(closed <= held) {
+            printf("clusters held for the readers not given back on close\n");
+            bad++;
+        }
+        if(end_free != start_free) {
+            printf("clusters leaked\n");
+            bad++;
+        }
+
+        fs.reset();
+        fs = std::make_unique<fat32>("snapshot");
+        if(bench::free_clusters(*fs, out) != end_free) {
+            printf("free count differs after a reload\n");
+            bad++;
+        }
+
+        printf("snapshot: %d bad\n", bad);
+        return bad;
+    }
+
+    // one writer touching and removing in h, a reader listing h and catting h/big meanwhile.
+    void latency(fat32& fs, buffer& out, int entries, double secs) {
+        fs.mkdir("h");
+        for(int i = 0; i < entries; i++) {
+            std::vector<std::string> touch = {"h/e" + std::to_string(i), "x"};
+            fs.touch(touch, nullptr, 0);
+            out.clear();
+        }
+        put(fs, "h/big", bench::pattern(4, 64 << 20));
+
+        std::atomic<bool> stop = {false};
+        std::atomic<uint64_t> writes = {};
+        std::vector<double> touch_ms;
+
+        std::thread writer([&] {
+            buffer sink;
+            buffer::scope bind(sink);
+
+            for(int i = 0; !stop; i++) {
+                auto start = bench::now();
+                std::vector<std::string> touch = {"h/w" + std::to_string(i % 50), "y"};
+                fs.touch(touch, nullptr, 0);
+                touch_ms.push_back(bench::ms_since(start));
+
+                rm(fs, "h/w" + std::to_string((i + 25) % 50));
+                writes += 2;
+                sink.clear();
+            }
+        });
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        std::map<std::string, std::vector<double>> reads;
+        auto start = bench::now();
+        uint64_t first = writes;
+
+        while(bench::ms_since(start) < secs * 1e3) {
+            auto at = bench::now();
+            std::vector<fat32::stat_t> listed;
+            fs.readdir("h", listed);
+            reads["ls"].push_back(bench::ms_since(at));
+
+            at = bench::now();
+            fs.cat("h/big", 1);
+            reads["cat"].push_back(bench::ms_since(at));
+            out.clear();
+        }
+
+        double elapsed = bench::ms_since(start);
+        uint64_t last = writes;
+        stop = true;
+        writer.join();
+
+        for(auto& it : reads)
+            bench::print_latency(it.first.c_str(), it.second);
+        bench::print_latency("touch", touch_ms);
+        printf("writer %.0f ops/s\n", (last - first) / elapsed * 1e3);
+    }
+}
+
+int main(int argc, char** argv) {
+    bench::scratch_disk("snapshot");
+    buffer out;
+    buffer::scope bind(out);
+    auto fs = std::make_unique<fat32>("snapshot");
+    out.clear();
+
+    if(argc > 3 && std::string(argv[1]) == "lat") {
+        latency(*fs, out, atoi(argv[2]), atof(argv[3]));
+        return 0;
+    }
+    return snap(fs, out);
+}
@@ -0,0 +1,185 @@
+// one fat32 shared by many threads: each writes, removes and lists files in a directory of its
+// own and touches files in the root, while another copies, moves and removes a tree over and over.
+// the result is checked live and again after the disk is loaded back. usage: stress [threads] [files]
+#include <set>
+#include <atomic>
+#include <thread>
+#include <memory>
+
+#include "bench.h"
+
+using namespace VFS;
+using namespace VFS::IFS;
+
+namespace {
+    size_t file_size(int t, int k) noexcept {
+        return 1000 + (t * 977 + k * 4099) % 60000;
+    }
+
+    // every third file is removed again by the thread that wrote it.
+    bool kept(int k) noexcept {
+        return k % 3 != 2;
+    }
+
+    int check(fat32& fs, int threads, int files) {
+        int bad = 0;
+
+        for(int t = 0; t < threads; t++) {
+            std::string dir = "d" + std::to_string(t);
+            std::vector<fat32::stat_t> entries;
+
+            if(fs.readdir(dir.c_str(), entries) != 0) {
+                printf("readdir %s failed\n", dir.c_str());
+                bad++;
+                continue;
+            }
+
+            std::set<std::string> names;
+            for(auto& it : entries)
+                names.insert(std::string(it.name, strnlen(it.name, sizeof(it.name))));
+
+            for(int k = 0; k < files; k++) {
+                std::string name = "f" + std::to_string(k);
+                if(names.count(name) != (size_t)kept(k)) {
+                    printf("%s/%s present %zu, expected %d\n", dir.c_str(), name.c_str(), names.count(name), kept(k));
+                    bad++;
+                    continue;
+                }
+                if(!kept(k))
+                    continue;
+
+                std::string path = dir + "/" + name;
+                size_t n = file_size(t, k);
+                std::string got(n, 0);
+                int fd = fs.open(path.c_str(), O_RDONLY);
+
+                if(fd < 0 || fs.read(fd, got.data(), n) != (int64_t)n || got != bench::pattern(t * files + k, n)) {
+                    printf("%s has the wrong contents\n", path.c_str());
+                    bad++;
+                }
+                if(fd >= 0)
+                    fs.close(fd);
+            }
+        }
+
+        std::vector<fat32::stat_t> root;
+        fs.readdir("", root);
+
+        size_t touched = 0;
+        for(auto& it : root) {
+            touched += it.name[0] == 's';
+            if(it.name[0] == 'm' && it.name[1]) {
+                printf("%s left behind by the tree copies\n", it.name);
+                bad++;
+            }
+        }
+        if(touched != (size_t)threads * files) {
+            printf("%zu files touched in the root, expected %d\n", touched, threads * files);
+            bad++;
+        }
+        return bad;
+    }
+}
+
+int main(int argc, char** argv) {
+    int threads = argc > 1 ? atoi(argv[1]) : 4;
+    int files = argc > 2 ? atoi(argv[2]) : 300;
+
+    bench::scratch_disk("stress");
+    buffer out;
+    buffer::scope bind(out);
+    auto fs = std::make_unique<fat32>("stress");
+    out.clear();
+
+    uint32_t start_free = bench::free_clusters(*fs, out);
+    std::vector<std::thread> workers;
+    auto start = bench::now();
+
+    for(int t = 0; t < threads; t++) {
+        workers.emplace_back([&, t] {
+            buffer sink;
+            buffer::scope bind(sink);
+
+            std::string dir = "d" + std::to_string(t);
+            fs->mkdir(dir.c_str());
+
+            for(int k = 0; k < files; k++) {
+                std::string path = dir + "/f" + std::to_string(k);
+                std::string data = bench::pattern(t * files + k, file_size(t, k));
+
+                int fd = fs->open(path.c_str(), O_CREAT | O_TRUNC | O_WRONLY);
+                fs->write(fd, data.data(), data.size());
+                fs->close(fd);
+
+                std::vector<std::string> touch = {"s" + std::to_string(t) + "_" + std::to_string(k), "x"};
+                fs->touch(touch, nullptr, 0);
+
+                if(!kept(k)) {
+                    std::vector<std::string> rm = {path};
+                    fs->rm(rm);
+                }
+
+                std::vector<fat32::stat_t> entries;
+                fs->ls();
+                fs->readdir(dir.c_str(), entries);
+                sink.clear();
+            }
+        });
+    }
+
+    workers.emplace_back([&] {
+        buffer sink;
+        buffer::scope bind(sink);
+
+        fs->mkdir("m");
+        std::vector<std::string> touch = {"m/a", "hello"};
+        fs->touch(touch, nullptr, 0);
+
+        for(int k = 0; k < files; k++) {
+            std::string copy = "mc" + std::to_string(k), moved = "mv" + std::to_string(k);
+            std::vector<std::string> mv = {copy, moved}, rm = {moved};
+            std::vector<std::string> there = {"m/a", "m/b"}, back = {"m/b", "m/a"};
+
+            fs->cp("m", copy.c_str());
+            fs->mv(mv);
+            fs->rm(rm);
+            fs->mv(there);
+            fs->mv(back);
+            sink.clear();
+        }
+    });
+
+    for(auto& it : workers)
+        it.join();
+    double elapsed = bench::ms_since(start);
+
+    int bad = check(*fs, threads, files);
+    printf("%d threads x %d files in %.0fms, live check: %d bad\n", threads, files, elapsed, bad);
+
+    fs.reset();
+    fs = std::make_unique<fat32>("stress");
+    out.clear();
+
+    int reload_bad = check(*fs, threads, files);
+    printf("reload check: %d bad\n", reload_bad);
+
+    // everything is removed again, the disk has to end up as free as it started.
+    for(int t = 0; t < threads; t++) {
+        std::vector<std::string> rm = {"d" + std::to_string(t)};
+        fs->rm(rm);
+        for(int k = 0; k < files; k++) {
+            std::vector<std::string> rm = {"s" + std::to_string(t) + "_" + std::to_string(k)};
+            fs->rm(rm);
+        }
+    }
+    std::vector<std::string> rm = {"m"};
+    fs->rm(rm);
+    out.clear();
+
+    uint32_t end_free = bench::free_clusters(*fs, out);
+    if(end_free != start_free) {
+        printf("%u clusters free after removing everything, %u at the start\n", end_free, start_free);
+        bad++;
+    }
+    return bad || reload_bad;
+}
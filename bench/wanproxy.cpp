@@ -0,0 +1,150 @@
+// tcp proxy that holds every chunk back by a fixed one-way delay and lets at most <window> bytes
+// be in flight each way, so one connection tops out near window / delay like it would on a long
+// fat link. connections past <max> are closed as soon as they're accepted, with max 1 a client
+// can't open lanes and falls back to a single connection.
+// usage: wanproxy <listen port> <target port> <delay ms> <window bytes> [max connections]
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <condition_variable>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+namespace {
+    using clock = std::chrono::steady_clock;
+
+    int delay_ms = {};
+    size_t window = {};
+    std::atomic<int> open_n = {};
+
+    // one direction of a connection: a reader queues what arrives stamped with when it may leave,
+    // a writer sends it on at that time. the reader stops taking more once a window is queued.
+    void pump(int from, int to) {
+        std::mutex lock;
+        std::condition_variable cv;
+        std::deque<std::pair<clock::time_point, std::string>> queue;
+        size_t queued = {};
+        bool eof = {};
+        bool broken = {};
+
+        std::thread writer([&] {
+            while(true) {
+                std::unique_lock<std::mutex> guard(lock);
+                cv.wait(guard, [&] { return !queue.empty() || eof; });
+                if(queue.empty())
+                    break;
+
+                auto chunk = std::move(queue.front());
+                queue.pop_front();
+                guard.unlock();
+
+                std::this_thread::sleep_until(chunk.first);
+                for(size_t off = 0; off < chunk.second.size();) {
+                    ssize_t sent = send(to, chunk.second.data() + off, chunk.second.size() - off, MSG_NOSIGNAL);
+                    if(sent <= 0) {
+                        std::lock_guard<std::mutex> failed(lock);
+                        broken = true;
+                        cv.notify_all();
+                        return;
+                    }
+                    off += sent;
+                }
+
+                guard.lock();
+                queued -= chunk.second.size();
+                cv.notify_all();
+            }
+            shutdown(to, SHUT_WR);
+        });
+
+        char data[1 << 16];
+        ssize_t got;
+        while((got = recv(from, data, sizeof(data), 0)) > 0) {
+            std::unique_lock<std::mutex> guard(lock);
+            queue.emplace_back(clock::now() + std::chrono::milliseconds(delay_ms), std::string(data, got));
+            queued += got;
+            cv.notify_all();
+            cv.wait(guard, [&] { return queued < window || broken; });
+            if(broken)
+                break;
+        }
+
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            eof = true;
+        }
+        cv.notify_all();
+        writer.join();
+    }
+
+    sockaddr_in loopback(int port) {
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        return addr;
+    }
+}
+
+int main(int argc, char** argv) {
+    if(argc < 5) {
+        fprintf(stderr, "usage: wanproxy <listen port> <target port> <delay ms> <window bytes> [max connections]\n");
+        return 1;
+    }
+
+    int listen_port = atoi(argv[1]), target_port = atoi(argv[2]);
+    int max_open = argc > 5 ? atoi(argv[5]) : 1 << 30;
+    delay_ms = atoi(argv[3]);
+    window = atol(argv[4]);
+
+    int one = 1;
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    sockaddr_in addr = loopback(listen_port);
+    if(bind(listener, (sockaddr*)&addr, sizeof(addr)) || listen(listener, 64)) {
+        perror("wanproxy");
+        return 1;
+    }
+
+    while(true) {
+        int client = accept(listener, nullptr, nullptr);
+        if(client < 0)
+            continue;
+
+        if(open_n >= max_open) {
+            close(client);
+            continue;
+        }
+
+        int server = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in target = loopback(target_port);
+        if(connect(server, (sockaddr*)&target, sizeof(target))) {
+            close(client);
+            close(server);
+            continue;
+        }
+
+        setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        setsockopt(server, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        open_n++;
+
+        std::thread([client, server] {
+            std::thread up(pump, client, server);
+            pump(server, client);
+            up.join();
+
+            close(client);
+            close(server);
+            open_n--;
+        }).detach();
+    }
+}
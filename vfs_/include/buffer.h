@@ -4,41 +4,66 @@
 #include <mutex>
 #include <stdio.h>
 #include <cstring>
+#include <string_view>
 
 #include "config.h"
 #include "lib.h"
 
-#define BUFFER     (*VFS::buffer::get_buffer().get())
+#define BUFFER     (*VFS::buffer::get_buffer())
 
 namespace VFS {
 
     class buffer {
-    private:
-        buffer();
-
     public:
-        ~buffer() = default;;
+        explicit buffer(bool echo = false, size_t retain = CFG_BUFFER_RETAIN_SIZE);
+        ~buffer() = default;
         buffer(buffer&&) = delete;
         buffer(const buffer&) = delete;
 
+        // binds a sink as BUFFER for the calling thread until the scope ends.
+        class scope {
+        public:
+            explicit scope(buffer& sink) noexcept;
+            ~scope() noexcept;
+            scope(const scope&) = delete;
+
+        private:
+            buffer* m_prev;
+        };
+
     public:
-        static std::shared_ptr<buffer> get_buffer() noexcept;
+        static buffer* get_buffer() noexcept;
+        static buffer* get_console() noexcept;
         buffer& operator<<(uint64_t) noexcept;
         buffer& operator<<(const char*) noexcept;
+        buffer& operator<<(std::string_view) noexcept;
 
         void hold_buffer() noexcept;
         void release_buffer() noexcept;
         void retain_buffer(char*& store) const noexcept;
         void retain_buffer(std::shared_ptr<std::byte[]>&) const noexcept;
         void print_stream() const noexcept;
-        void append(char*, size_t) const noexcept;
+        void append(const char*, size_t) noexcept;
+        char* grow(size_t) noexcept;
+        void truncate(size_t) noexcept;
+        void clear() noexcept;
+
+        [[nodiscard]] const char* data() const noexcept;
+        [[nodiscard]] size_t size() const noexcept;
+
+    private:
+        void reserve(size_t) noexcept;
 
     private:
+        bool m_echo;
         std::unique_ptr<std::mutex> mLock;
-        static std::shared_ptr<buffer> mBuf_p;
+        static thread_local buffer* m_current;
 
-    public:
-        std::unique_ptr<std::vector<char>> mStream;
+        // arena kept across commands, only shrunk back once it outgrows m_retain.
+        size_t m_retain;
+        std::unique_ptr<char[]> m_data;
+        size_t m_size = {};
+        size_t m_cap = {};
     };
 }
 
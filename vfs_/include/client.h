@@ -2,17 +2,24 @@
 #define _CLIENT_H_
 
 #include <unistd.h>
+#include <fcntl.h>
+#include <atomic>
 #include <thread>
+#include <random>
 
 #include "vfs.h"
 #include "rfs.h"
 #include "lib.h"
 #include "buffer.h"
+#include "timer.h"
+#include "transport.h"
 
 #ifndef _WIN32
     #include <arpa/inet.h>
     #include <netinet/in.h>
+    #include <netinet/tcp.h>
     #include <sys/socket.h>
+    #include <sys/un.h>
 #else
     #include <winsock2.h>
     #include <ws2tcpip.h>
@@ -33,10 +40,23 @@ class client : public rfs {
             const char* m_addr = {};
             int m_socket_fd = {};
             sockaddr_in hint = {};
+            sockaddr_un local = {};
+            transport::addr_t where = {};
         }conn;
 
+        typedef std::function<void(const message_t&)> reply_t;
+
+        // a request the server hasn't finished answering. an export replies with a stream of
+        // the file followed by an internal message, the request is done once both are in.
+        struct request_t {
+            reply_t on_reply = nullptr;
+            bool replied = {};
+            uint32_t streams = {};
+        };
+
     public:
-        client(const char* addr, const int32_t& port);
+        // a lane is an extra connection carrying part of a large transfer for the client that opened it.
+        client(const char* addr, const int32_t& port, uint64_t session = 0, uint64_t lane = 0);
 
         ~client();
         client(client&&) = delete;
@@ -44,11 +64,13 @@ class client : public rfs {
 
     public:
         void receive_from_server() noexcept;
-        uint8_t receive(char* buffer, size_t bytes) noexcept;
-        void send(const char*, size_t) noexcept;
-        uint64_t get_payload(const char*, std::vector<std::string>&, std::shared_ptr<std::byte[]>&) noexcept;
+        uint8_t send(iovec*, int, bool wait = true) noexcept;
+        uint8_t get_payload(const char*, std::vector<std::string>&, FILE*&, uint64_t&) noexcept;
         void handle_send(const char*, uint8_t, std::vector<std::string>&) noexcept;
-        void output_data(const pcontainer_t&, char*, int64_t) noexcept;
+        uint64_t request(const char*, uint8_t, std::vector<std::string>&, reply_t on_reply = nullptr) noexcept;
+        void wait(uint64_t id) noexcept;
+        [[nodiscard]] size_t in_flight() noexcept;
+        void output_data(const message_t&) noexcept;
 
     private:
         void add_hint() noexcept;
@@ -57,18 +79,48 @@ class client : public rfs {
         void define_fd() noexcept override;
 
     private:
-        void connect() noexcept;
-        void interpret_input(std::unique_ptr<pcontainer_t>) noexcept;
-        void ping() noexcept;
+        uint8_t connect() noexcept;
+        void say_hello() noexcept;
+        [[nodiscard]] bool wait_hello() noexcept;
+        [[nodiscard]] uint64_t offered_caps() const noexcept;
+        void interpret_input(std::shared_ptr<message_t>) noexcept;
+        uint64_t upload(uint8_t cmd, std::string args, std::shared_ptr<FILE> file, uint64_t offset, uint64_t size) noexcept;
+        void send_stream(uint64_t id, uint8_t cmd, std::string args, std::shared_ptr<FILE> file, uint64_t offset, uint64_t size) noexcept;
+        void send_split(uint64_t id, uint8_t cmd, std::vector<std::string> args, std::shared_ptr<FILE> file, uint64_t size) noexcept;
+        void stream_file(uint64_t id, uint8_t cmd, const std::string& args, FILE* file, uint64_t offset, uint64_t size) noexcept;
+        void recv_part(const message_t&, const std::vector<std::string>& part) noexcept;
+        std::vector<std::unique_ptr<client>> open_lanes(size_t amt) noexcept;
+        void finish(uint64_t id, bool stream) noexcept;
+        void heartbeat() noexcept;
         void ping_server() noexcept;
-        void set_recieved_ping(int8_t) noexcept;
+        void task_done() noexcept;
         void set_state(int8_t) noexcept;
 
     private:
         std::thread recv_;
-        std::thread ping_;
-        int8_t recieved_ping;
         int8_t disconnected = {};
+
+        // liveness is judged on any traffic, both stamps are plain stores on the data path.
+        std::atomic<uint64_t> last_rx = {};
+        std::atomic<uint64_t> last_tx = {};
+        uint64_t beat = {};
+
+        std::unique_ptr<transport> link = nullptr;
+        reader_t reader = {};
+        uint64_t next_id = {};
+
+        std::mutex m_inflight;
+        std::condition_variable inflight_cv;
+        std::unordered_map<uint64_t, request_t> inflight = {};
+        uint32_t tasks = {};
+        std::atomic<uint64_t> max_frame = {CFG_FRAME_MIN_SIZE};
+
+        // nothing is compressed until the server's hello says it can take it.
+        std::atomic<uint64_t> caps = {};
+        bool greeted = {};
+
+        uint64_t session = {};
+        uint64_t lane = {};
     };
 }
 
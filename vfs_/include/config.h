@@ -23,17 +23,55 @@
 #define CFG_CLUSTER_SIZE          (uint64_t)(KB(12))
 #define CFG_MAX_USER_SPACE_SIZE   (uint64_t)(GB(4))
 #define CFG_MIN_USER_SPACE_SIZE   (uint64_t)(MB(24))
+#define CFG_CHAIN_CACHE_SIZE      (size_t)1024
+#define CFG_DIR_CACHE_SIZE        (size_t)1024
+#define CFG_DIR_LOCK_STRIPES      (size_t)64
+#define CFG_ALLOC_MAGAZINES       (size_t)16
+#define CFG_ALLOC_BATCH           (uint32_t)64
+#define CFG_FAT_PAGE_SIZE         (size_t)(KB(4))
+#define CFG_CP_WORKERS            (size_t)4
+#define CFG_CP_BATCH              (uint32_t)32
+#define CFG_DEDUP                 (uint8_t)0
+#define CFG_COMPRESS              (uint8_t)0
+#define CFG_COMPRESS_CHUNK        (uint32_t)(KB(64))
 
 #define CFG_SOCK_OPEN             (int8_t)1
 #define CFG_SOCK_CLOSE            (int8_t)0
 #define CFG_DEFAULT_PORT          (uint32_t)52222
-#define CFG_SOCK_LISTEN_AMT       (uint32_t)5
+#define CFG_SOCK_LISTEN_AMT       (int)1024
+#define CFG_SOCK_RX_RETAIN_SIZE   (size_t)(KB(4))
+#define CFG_SOCK_SEND_TIMEOUT     (int)5000
+#define CFG_LOCAL_SOCK_DIR        (char*)"/tmp"
+#define CFG_SHM_RING_SIZE         (uint64_t)(MB(4))
+#define CFG_SHM_RING_MAX          (uint64_t)(MB(64))
+#define CFG_SERVER_WORKERS        (size_t)4
+#define CFG_SERVER_MAX_CLIENTS    (uint32_t)4096
+#define CFG_SERVER_SHARDS         (size_t)16
+#define CFG_SERVER_EVENTS         (int)256
+#define CFG_HEARTBEAT_INTERVAL    (int)1000
+#define CFG_HEARTBEAT_MISS_AMT    (uint8_t)10
+#define CFG_HELLO_TIMEOUT         (uint64_t)5000
+#define CFG_TIMER_TICK            (uint64_t)10
 
 #define CFG_PACKET_SIGNATURE      (char*)"[_VFS_]\0"
 #define CFG_PACKET_SIGNATURE_SIZE (strlen(CFG_PACKET_SIGNATURE))
 
-#define CFG_FLAGS_BUFFER_SIZE     (size_t)100
-#define CFG_PAYLOAD_SIZE          (KB(1))
-#define CFG_PACKET_HASH_SIZE      (size_t)10
+#define CFG_BUFFER_INIT_SIZE      (size_t)(KB(16))
+#define CFG_BUFFER_RETAIN_SIZE    (size_t)(MB(8))
+#define CFG_SESSION_RETAIN_SIZE   (size_t)0
+
+#define CFG_FRAME_VERSION         (uint64_t)2
+#define CFG_FRAME_MIN_SIZE        (uint64_t)(KB(256))
+#define CFG_FRAME_MAX_SIZE        (uint64_t)(MB(1))
+#define CFG_FRAME_ARGS_SIZE       (size_t)(KB(4))
+#define CFG_STREAM_WINDOW         (uint64_t)(MB(4))
+#define CFG_RFS_INFLIGHT_MAX      (size_t)256
+#define CFG_RFS_REQUEST_MAX_SIZE  (uint64_t)(KB(64))
+#define CFG_RFS_REPLY_MAX_SIZE    (uint64_t)(GB(1))
+#define CFG_RFS_CAPS              (uint64_t)0x7
+#define CFG_RFS_LANES             (size_t)4
+#define CFG_RFS_LANE_MIN_SIZE     (uint64_t)(MB(16))
+#define CFG_LZ_MIN_SIZE           (uint64_t)256
+#define CFG_LZ_MAX_BACKOFF        (uint64_t)32
 
 #endif // _CONFIG_H
@@ -0,0 +1,44 @@
+#ifndef _CRC32C_H_
+#define _CRC32C_H_
+
+#include <stdint.h>
+#include <string.h>
+#include <stddef.h>
+
+namespace VFS {
+
+    // crc32c (castagnoli), the polynomial sse4.2 and armv8 have instructions for. which one
+    // runs is picked on first use, cpus without either fall back to slicing-by-8 tables.
+    // update takes and returns a finished crc, so a crc can be carried on over several buffers.
+    class crc32c {
+
+    public:
+        constexpr static uint32_t POLY        = 0x82F63B78;
+        constexpr static size_t   LONG_BLOCK  = 8192;
+        constexpr static size_t   SHORT_BLOCK = 256;
+
+    public:
+        [[nodiscard]] static uint32_t update(uint32_t crc, const char* data, size_t n) noexcept;
+        [[nodiscard]] static uint32_t software(uint32_t crc, const char* data, size_t n) noexcept;
+        [[nodiscard]] static uint32_t hardware(uint32_t crc, const char* data, size_t n) noexcept;
+        [[nodiscard]] static bool has_hardware() noexcept;
+        [[nodiscard]] static const char* impl() noexcept;
+
+        // carries a raw crc register over a block of zeros, how blocks done side by side are joined up.
+        [[nodiscard]] static uint32_t fold(const uint32_t (*shift)[256], uint32_t crc) noexcept;
+
+    private:
+        struct tables_t {
+            uint32_t t[8][256];
+            uint32_t long_shift[4][256];
+            uint32_t short_shift[4][256];
+
+            tables_t() noexcept;
+            void zeros(uint32_t (*shift)[256], size_t len) const noexcept;
+        };
+
+        static const tables_t& tables() noexcept;
+    };
+}
+
+#endif // _CRC32C_H_
@@ -1,6 +1,8 @@
 #ifndef _DISK_H_
 #define _DISK_H_
 
+#include <mutex>
+#include <atomic>
 #include <string>
 #include <stdio.h>
 #include <unistd.h>
@@ -29,14 +31,21 @@ namespace VFS {
         ret_t truncate(const off_t& size) override;
         ret_t open(const char* pathname, const char* mode) override;
         ret_t read(void* ptr, const size_t& size, const uint32_t& amt) override;
+        ret_t read_at(void* ptr, const size_t& size, const uint32_t& amt, const long& offset) override;
         ret_t write(const void* ptr, const size_t& size, const uint32_t& amt) override;
+        ret_t write_at(const void* ptr, const size_t& size, const uint32_t& amt, const long& offset) override;
 
     public:
         [[nodiscard]] FILE* get_file() const noexcept;
         [[nodiscard]] size_t& get_addr() const noexcept;
 
+    private:
+        void flush_stream() noexcept;
+
     private:
         FILE* file;
+        std::mutex m_io;
+        std::atomic<bool> m_dirty = {};
         size_t addr;
         const char* disk_name;
         std::string cmpl_path_to_file;
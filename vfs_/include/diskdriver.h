@@ -25,7 +25,9 @@ namespace VFS {
         __attribute__((unused)) virtual ret_t truncate(const off_t& size) = 0;
         __attribute__((unused)) virtual ret_t open(const char* pathname, const char* mode) = 0;
         __attribute__((unused)) virtual ret_t read(void* ptr, const size_t& size, const uint32_t& amt) = 0;
+        __attribute__((unused)) virtual ret_t read_at(void* ptr, const size_t& size, const uint32_t& amt, const long& offset) = 0;
         __attribute__((unused)) virtual ret_t write(const void* ptr, const size_t& size, const uint32_t& amt) = 0;
+        __attribute__((unused)) virtual ret_t write_at(const void* ptr, const size_t& size, const uint32_t& amt, const long& offset) = 0;
 
     };
 }
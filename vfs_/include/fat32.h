@@ -1,23 +1,36 @@
 #ifndef _FAT32_H_
 #define _FAT32_H_
 
+#include <fcntl.h>
 #include <string.h>
+#include <map>
+#include <deque>
+#include <atomic>
+#include <mutex>
+#include <thread>
 #include <utility>
+#include <shared_mutex>
+#include <initializer_list>
 #include <vector>
 #include <unordered_set>
+#include <unordered_map>
 
 #include "ifs.h"
 #include "disk.h"
 #include "lib.h"
-#include "vfs.h"
+#include "pool.h"
+#include "xxh64.h"
+#include "lz.h"
 
 #define abs_(a,b)            ((a) < (b) ? (b) - (a) : (a) - (b))
 #define min_(a,b)            ((a) < (b) ? (a) : (b))
 #define DISK_NAME_LENGTH     (uint8_t)10
 #define DIR_NAME_LENGTH      (uint8_t)10
 #define UNDEF_START_CLUSTER  0
+#define ROOT_CLUSTER         0
 #define DIRECTORY            1
 #define NON_DIRECTORY        0
+#define ANY_ENTRY            2
 
 namespace VFS::IFS {
 
@@ -31,6 +44,11 @@ namespace VFS::IFS {
             ALLOCATED_CLUSTER   = 0x00000001
         } __attribute__((packed));
 
+        enum feature_t : uint32_t {
+            FEATURE_DEDUP       = 0x00000001,
+            FEATURE_LZ          = 0x00000002
+        };
+
     private:
 
         struct metadata_t {
@@ -50,6 +68,27 @@ namespace VFS::IFS {
             uint32_t root_dir_addr = {};
         } superblock_t;
 
+        // what the disk was formatted with, kept past the owner counts. a disk made before there
+        // were any reads as all zero.
+        typedef struct __attribute__((packed)) {
+            uint32_t flags = {};
+            uint32_t chunk_size = {};
+        } features_t;
+
+        // on a compressed disk a file's chain starts with one of these for every chunk of it, the
+        // chunks follow packed one after the other. a chunk that packs no smaller is kept as it is.
+        typedef struct __attribute__((packed)) {
+            uint64_t off = {};
+            uint32_t len = {};
+        } chunk_t;
+
+        // a packed file being read, where its chunks are and the last one unpacked.
+        struct unpacked_t {
+            std::vector<chunk_t> map = {};
+            std::vector<std::byte> data = {};
+            int64_t at = -1;
+        };
+
         typedef struct __attribute__((packed)) {
             char dir_name[DIR_NAME_LENGTH] = {};
             uint32_t dir_entry_amt = {};
@@ -80,6 +119,141 @@ namespace VFS::IFS {
             dir_entr_ret_t(std::shared_ptr<dir_t> dir, dir_entry_t* entry) : m_dir(std::move(dir)), m_entry(std::move(entry)) { };
         } __attribute__((packed));
 
+        // cached index of a cluster chain, runs of contiguous clusters stored as extents.
+        struct chain_t {
+            std::vector<uint32_t> ext_start = {}; // first cluster of each extent.
+            std::vector<uint32_t> ext_off = {};   // index of the extent's first cluster within the chain.
+            uint32_t clu_n = {};
+
+            [[nodiscard]] uint32_t clu_at(const uint32_t& n) const noexcept;
+            [[nodiscard]] uint32_t ext_at(const uint32_t& n) const noexcept;
+            [[nodiscard]] uint32_t ext_len(const uint32_t& ext) const noexcept;
+        };
+
+        // while one is alive, clusters freed after it was taken aren't handed out again. whatever a
+        // reader found through the directories it read stays on disk until it's done with it, it
+        // doesn't keep a file from being written over in place.
+        class snapshot {
+        public:
+            explicit snapshot(fat32& fs) noexcept;
+            ~snapshot() noexcept;
+            snapshot(const snapshot&) = delete;
+
+        private:
+            fat32& m_fs;
+            uint64_t m_epoch;
+        };
+
+        // per open file state, resolved once at open().
+        struct handle_t {
+            char name[DIR_NAME_LENGTH] = {};
+            uint32_t parent_clu = {};
+            uint32_t start_clu = {};
+            uint64_t size = {};
+            uint64_t pos = {};
+            int flags = {};
+            uint8_t dirty = {};
+            uint8_t replaced = {};
+            uint64_t cow_gen = {};
+            uint8_t unindexed = {};
+            std::shared_ptr<chain_t> chain = nullptr;
+            std::unique_ptr<unpacked_t> packed = nullptr;
+            std::vector<uint32_t> held = {};    // a share of the entry's chain, it's copied before it's written.
+            std::mutex lock;
+        };
+
+        // clusters freed while the tree was at epoch, a snapshot from then may still read them.
+        struct retired_t {
+            uint64_t epoch = {};
+            std::vector<uint32_t> clus = {};
+        };
+
+        // a page of the fat table, written back on its own once something in it changed. the
+        // owner counts and fingerprints of the same clusters sit under its lock as well.
+        struct fat_page_t {
+            std::mutex lock;
+            bool dirty = {};
+            bool refs_dirty = {};
+            bool fps_dirty = {};
+        };
+
+        // clusters taken off the free map ahead of time, a batch at a time. threads hash to one
+        // each, so most calls take a lock no one else wants and touch nothing shared. the others
+        // are only taken from once the map has run dry.
+        struct magazine_t {
+            std::mutex lock;
+            std::vector<uint32_t> clus = {};       // handed out from the back, lowest first.
+            std::atomic<uint32_t> cursor = {};     // word of the map the next batch is looked for from.
+        };
+
+        // one recursive copy. every directory under it is a job, split in parts that the pool's
+        // workers take. the last part of a job to finish writes the directory out once.
+        struct cp_tree_t {
+            pool::group grp;
+            buffer* out = nullptr;
+            std::mutex lock;
+        };
+
+        struct cp_job_t {
+            std::shared_ptr<dir_t> src = nullptr;
+            std::shared_ptr<dir_t> dst = nullptr;
+            std::vector<dir_entry_t> entries = {};  // start left at UNDEF_START_CLUSTER for what couldn't be copied.
+            std::atomic<uint32_t> left = {};
+        };
+
+        // directories are locked through a stripe picked by their start cluster. the stripes a
+        // call needs are taken together in order, and one the thread already holds is skipped,
+        // so a writer can read back the directory it has locked.
+        class dir_lock {
+        public:
+            dir_lock(fat32& fs, std::initializer_list<uint32_t> clus, bool excl) noexcept;
+            ~dir_lock() noexcept;
+            dir_lock(const dir_lock&) = delete;
+
+        private:
+            fat32& m_fs;
+            bool m_excl;
+            uint64_t m_taken = {};
+        };
+
+        // the tree as a whole. every command holds it shared, only rm, mv and cp of a directory
+        // hold it alone as they reach into everything below it. nested calls don't take it again.
+        class tree_lock {
+        public:
+            tree_lock(fat32& fs, bool excl) noexcept;
+            ~tree_lock() noexcept;
+            tree_lock(const tree_lock&) = delete;
+
+        private:
+            fat32& m_fs;
+            uint8_t m_taken = {};
+        };
+
+    public:
+        struct stat_t {
+            char name[DIR_NAME_LENGTH] = {};
+            uint64_t size = {};
+            uint32_t start_cluster = {};
+            uint8_t is_directory = {};
+        };
+
+        // a working directory kept apart from the console's, only its start cluster is held.
+        struct cwd_t {
+            std::atomic<uint32_t> clu = {ROOT_CLUSTER};
+        };
+
+        // binds a working directory for the calling thread until the scope ends. it's read
+        // again each time it's used, so what other sessions did to it is always seen.
+        class scope {
+        public:
+            explicit scope(cwd_t& cwd) noexcept;
+            ~scope() noexcept;
+            scope(const scope&) = delete;
+
+        private:
+            cwd_t* m_prev;
+        };
+
     public:
         explicit fat32(const char* disk_name);
         ~fat32() override = default;
@@ -99,6 +273,16 @@ namespace VFS::IFS {
         void cat(const char* path, int8_t export_ = 0) noexcept override;
         void touch(std::vector<std::string>& tokens, char* payload, uint64_t size) noexcept override;
 
+        int lookup(const char* path, stat_t& st) noexcept;
+        int readdir(const char* path, std::vector<stat_t>& entries) noexcept;
+        int open(const char* path, int flags) noexcept;
+        int64_t read(int fd, void* buf, uint64_t size) noexcept;
+        int64_t write(int fd, const void* buf, uint64_t size) noexcept;
+        int64_t pwrite(int fd, const void* buf, uint64_t size, uint64_t offset) noexcept;
+        int64_t lseek(int fd, int64_t offset, int whence) noexcept;
+        int fstat(int fd, stat_t& st) noexcept;
+        int close(int fd) noexcept;
+
     private:
         void set_up() noexcept;
         void init() noexcept;
@@ -107,6 +291,7 @@ namespace VFS::IFS {
         int8_t dir_equal(std::shared_ptr<dir_t>&, std::shared_ptr<dir_t>&) noexcept;
 
         void create_disk() noexcept;
+        int8_t link_entry(std::shared_ptr<dir_t>& dir, const char* name, const uint32_t& start_clu, const uint64_t& size, const uint8_t& is_dir) noexcept;
         void add_new_entry(std::shared_ptr<dir_t>& dir, const char* name, const uint32_t& start_clu, const uint64_t& size, const uint8_t& is_dir) noexcept;
 
         void define_superblock() noexcept;
@@ -115,29 +300,84 @@ namespace VFS::IFS {
 
         void store_superblock() noexcept;
         void store_fat_table() noexcept;
-        void store_dir(std::shared_ptr<dir_t>& directory) noexcept;
+        int8_t store_dir(std::shared_ptr<dir_t>& directory) noexcept;
         void save_dir(std::shared_ptr<dir_t>& directory) noexcept;
+        void write_dir(std::shared_ptr<dir_t>& directory, const std::vector<uint32_t>& clus) noexcept;
+        [[nodiscard]] static uint32_t dir_clu_n(const dir_t& directory) noexcept;
 
         void load_superblock() noexcept;
         void load_fat_table() noexcept;
+        void load_tables() noexcept;
+        void store_features() noexcept;
+        void fill_free_map() noexcept;
 
         int32_t store_file(std::shared_ptr<std::byte[]>& path, uint64_t data_size) noexcept;
+        int32_t store_data(std::shared_ptr<std::byte[]>& data, uint64_t data_size) noexcept;
+        bool dedup_file(std::shared_ptr<std::byte[]>& data, uint64_t data_size, const std::vector<uint64_t>& tails, int32_t& start_clu) noexcept;
+        static void fingerprint(const std::byte* data, uint64_t data_size, std::vector<uint64_t>& tails) noexcept;
+        bool same_tail(const uint32_t& clu, const uint32_t& clu_n, const std::byte* data, uint64_t data_size, std::vector<uint32_t>& clus) noexcept;
+        void index_clus(const std::vector<uint32_t>& clus, const std::vector<uint64_t>& tails) noexcept;
+        void unindex(const std::vector<uint32_t>& clus) noexcept;
+        [[nodiscard]] bool dedup() const noexcept;
+
+        [[nodiscard]] bool compressed() const noexcept;
+        void pack(const std::byte* data, uint64_t data_size, std::shared_ptr<std::byte[]>& out, uint64_t& out_size) noexcept;
+        bool load_map(const chain_t& chain, const uint64_t& size, unpacked_t& file) noexcept;
+        uint64_t read_packed(const chain_t& chain, unpacked_t& file, uint64_t size, uint64_t offset, uint64_t amt, std::byte* out) noexcept;
+        uint64_t read_entry(const uint32_t& start_clu, uint64_t size, std::byte* out) noexcept;
+        int8_t stage(handle_t& hdl) noexcept;
+        int8_t repack(handle_t& hdl) noexcept;
 
         uint32_t insert_dir(std::shared_ptr<dir_t>& curr_dir, const char* dir_name) noexcept;
         void insert_int_file(std::shared_ptr<dir_t>& dir, std::shared_ptr<std::byte[]>& buffer, const char* name, size_t size) noexcept;
         void insert_ext_file(std::shared_ptr<dir_t>& dir, const char* path, const char* name) noexcept;
 
         void delete_entry(std::unique_ptr<dir_entr_ret_t>& entry) noexcept;
-        void delete_dir(std::shared_ptr<dir_t>& dir) noexcept;
+        void delete_dir(std::shared_ptr<dir_t>& dir, std::vector<uint32_t>& clus) noexcept;
 
         void cp_dir(std::shared_ptr<dir_t>& src, std::shared_ptr<dir_t>& dst) noexcept;
+        void cp_dir_job(const std::shared_ptr<dir_t>& src, const std::shared_ptr<dir_t>& dst, cp_tree_t& tree) noexcept;
+        void cp_dir_part(const std::shared_ptr<cp_job_t>& job, uint32_t first, uint32_t last, cp_tree_t& tree) noexcept;
 
         std::shared_ptr<dir_t> read_dir(const uint32_t& start_clu) noexcept;
+        [[nodiscard]] static std::shared_ptr<dir_t> copy_dir(const dir_t& directory) noexcept;
+        void cache_dir(const std::shared_ptr<dir_t>& directory) noexcept;
+        void publish_dir(const std::shared_ptr<dir_t>& directory) noexcept;
+        void forget_dir(const uint32_t& start_clu) noexcept;
+        void forget_dirs(const std::vector<uint32_t>& clus) noexcept;
         size_t read_file(std::shared_ptr<dir_t>& dir, const char* entry_name, std::shared_ptr<std::byte[]>& buffer) noexcept;
 
-        [[nodiscard]] uint32_t attain_clu() const noexcept;
-        [[nodiscard]] uint32_t n_free_clusters(const uint32_t& req) const noexcept;
+        bool attain_clus(const uint32_t& amt, std::vector<uint32_t>& clus) noexcept;
+        void release_clus(const std::vector<uint32_t>& clus) noexcept;
+        void free_clus(const std::vector<uint32_t>& clus) noexcept;
+        uint32_t claim_free(std::atomic<uint32_t>& cursor, const uint32_t& amt, std::vector<uint32_t>& clus) noexcept;
+        void return_free(const std::vector<uint32_t>& clus, const size_t& first) noexcept;
+        [[nodiscard]] static size_t mag_slot() noexcept;
+        void retire_clus(std::vector<uint32_t>&& clus) noexcept;
+        void collect_retired(std::vector<uint32_t>& clus) noexcept;
+        uint64_t pin() noexcept;
+        void unpin(const uint64_t& epoch) noexcept;
+        [[nodiscard]] uint32_t fat_get(const uint32_t& clu) noexcept;
+        void fat_set(const uint32_t& clu, const uint32_t& val) noexcept;
+        void fat_fill(const std::vector<uint32_t>& clus, const size_t& first, const uint32_t& val) noexcept;
         std::unique_ptr<std::vector<uint32_t>> get_list_of_clu(const uint32_t& start_clu) noexcept;
+        std::shared_ptr<chain_t> get_chain(const uint32_t& start_clu) noexcept;
+        void invalidate_chain(const uint32_t& start_clu) noexcept;
+        void free_clu_chain(const uint32_t& start_clu) noexcept;
+        void collect_chain(const uint32_t& start_clu, std::vector<uint32_t>& clus) noexcept;
+        void share_chain(const uint32_t& start_clu) noexcept;
+        int8_t unshare(handle_t& hdl, const uint64_t& first, const uint64_t& last) noexcept;
+        [[nodiscard]] uint32_t ref_get(const uint32_t& clu) noexcept;
+        void ref_add(const std::vector<uint32_t>& clus) noexcept;
+        void drop_refs(const std::vector<uint32_t>& clus, std::vector<uint32_t>& unowned, std::vector<uint32_t>& single) noexcept;
+        uint64_t read_range(const uint32_t& start_clu, uint64_t offset, uint64_t size, std::byte* out) noexcept;
+        uint64_t read_range(const chain_t& chain, uint64_t offset, uint64_t size, std::byte* out) noexcept;
+        uint64_t write_range(const chain_t& chain, uint64_t offset, uint64_t size, const std::byte* in) noexcept;
+        int8_t grow_chain(handle_t& hdl, const uint64_t& size) noexcept;
+        std::shared_ptr<handle_t> get_handle(int fd) noexcept;
+        std::shared_ptr<dir_t> resolve_dir(const char* path) noexcept;
+        std::shared_ptr<dir_t> curr_dir() noexcept;
+        std::unique_ptr<dir_entr_ret_t> reread(const std::unique_ptr<dir_entr_ret_t>& entr, const char* name, uint8_t shd_exst) noexcept;
         void rm_entr_mem(std::shared_ptr<dir_t>& dir, const char* name) noexcept;
 
         fat32::dir_entry_t* find_entry(std::shared_ptr<dir_t>& dir, const char* path, uint8_t shd_exst) const noexcept;
@@ -156,20 +396,88 @@ namespace VFS::IFS {
         static constexpr uint32_t CLUSTER_SIZE = CFG_CLUSTER_SIZE;
         static constexpr uint64_t CLUSTER_AMT  = USER_SPACE / CLUSTER_SIZE;
 
-        static constexpr uint64_t STORAGE_SIZE           = (sizeof(superblock_t) + (sizeof(uint32_t) * CLUSTER_AMT)) + USER_SPACE;
         static constexpr uint32_t SUPERBLOCK_START_ADDR  = 0x00000000;
         static constexpr uint32_t FAT_TABLE_START_ADDR   = sizeof(superblock_t);
         static constexpr uint32_t FAT_TABLE_SIZE         = sizeof(uint32_t) * CLUSTER_AMT;
         static constexpr uint32_t ROOT_START_ADDR        = FAT_TABLE_START_ADDR + FAT_TABLE_SIZE;
         static constexpr uint32_t SUPERBLOCK_SIZE        = sizeof(superblock_t);
+        static constexpr uint64_t REFS_START_ADDR        = ROOT_START_ADDR + USER_SPACE;
+        static constexpr uint32_t REFS_SIZE              = sizeof(uint32_t) * CLUSTER_AMT;
+        static constexpr uint64_t FPS_START_ADDR         = REFS_START_ADDR + REFS_SIZE;
+        static constexpr uint32_t FPS_SIZE               = sizeof(uint64_t) * CLUSTER_AMT;
+        static constexpr uint64_t FEATURES_START_ADDR    = FPS_START_ADDR + FPS_SIZE;
+        static constexpr uint64_t STORAGE_SIZE           = FEATURES_START_ADDR + sizeof(features_t);
+
+        static constexpr uint32_t FAT_PAGE_ENTRIES = CFG_FAT_PAGE_SIZE / sizeof(uint32_t);
+        static constexpr uint32_t FAT_PAGE_AMT     = (CLUSTER_AMT + FAT_PAGE_ENTRIES - 1) / FAT_PAGE_ENTRIES;
+        static constexpr uint32_t FREE_MAP_WORDS   = (CLUSTER_AMT + 63) / 64;
+        static_assert(CFG_DIR_LOCK_STRIPES <= 64, "held stripes are kept in a 64 bit mask");
 
     private:
         superblock_t m_superblock;
         std::shared_ptr<dir_t> m_root;
-        std::shared_ptr<dir_t> m_curr_dir;
+        cwd_t m_home;
+        static thread_local cwd_t* m_cwd;
         std::unique_ptr<diskdriver> m_disk;
         std::unique_ptr<uint32_t[]> m_fat_table;
-        std::unique_ptr<std::unordered_set<uint32_t>> m_free_clusters;
+        std::unique_ptr<fat_page_t[]> m_fat_pages;
+
+        // owners each cluster has past its first, kept past the user space. a copy shares the
+        // chain it was made from and a write only moves what it touches off the shared part.
+        // a cluster's owners go on to the one after it, so along a chain the counts never drop.
+        std::unique_ptr<uint32_t[]> m_refs;
+        std::atomic<uint32_t> m_shared_n = {};
+        std::atomic<uint64_t> m_refs_n = {};
+        std::mutex m_cow_lock;
+        std::atomic<uint64_t> m_cow_gen = {};
+
+        // with dedup on, a stored file's clusters are indexed by a hash of everything from them to
+        // the end of the file, and a file whose tail is already on disk takes a share of that
+        // instead. the index is taken before any page lock. a cluster leaves it before it can be
+        // written in place or freed, whatever is found there can be shared as it is.
+        features_t m_features;
+        std::mutex m_index_lock;
+        std::unordered_map<uint64_t, uint32_t> m_index;
+        std::unique_ptr<uint64_t[]> m_fps;
+        std::atomic<size_t> m_index_n = {};
+
+        // bytes given to pack since the disk was mounted, and what they came to.
+        std::atomic<uint64_t> m_packed_in = {};
+        std::atomic<uint64_t> m_packed_out = {};
+
+        // a set bit for every free cluster that isn't sat in a magazine. m_free_n counts both and is
+        // taken from first, so whoever gets past it is sure to find enough somewhere.
+        std::unique_ptr<std::atomic<uint64_t>[]> m_free_map;
+        std::unique_ptr<magazine_t[]> m_mags;
+        std::atomic<uint32_t> m_free_n = {};
+
+        // commands run side by side, they only wait on each other over the directories they share.
+        std::shared_mutex m_tree_lock;
+        std::shared_mutex m_dir_locks[CFG_DIR_LOCK_STRIPES];
+        static thread_local uint8_t m_tree_held;
+        static thread_local uint64_t m_held;
+
+        std::mutex m_chain_lock;
+        std::unordered_map<uint32_t, std::shared_ptr<chain_t>> m_chains;
+
+        // the last version written of each directory. a writer puts out a new one and never
+        // changes one that's out, so readers take them without waiting on anyone.
+        std::mutex m_dir_cache_lock;
+        std::unordered_map<uint32_t, std::shared_ptr<const dir_t>> m_dirs;
+
+        // every new version moves the epoch on. clusters that are freed wait in m_retired until
+        // the epoch has passed them and no snapshot from before that is left.
+        std::mutex m_epoch_lock;
+        uint64_t m_epoch = 1;
+        std::map<uint64_t, uint32_t> m_readers;
+        std::deque<retired_t> m_retired;
+
+        std::mutex m_handle_lock;
+        std::vector<std::shared_ptr<handle_t>> m_handles;
+
+        // started by the first recursive copy.
+        std::once_flag m_pool_once;
+        std::unique_ptr<pool> m_pool;
     };
 }
 
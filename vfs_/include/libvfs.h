@@ -0,0 +1,51 @@
+#ifndef _LIBVFS_H_
+#define _LIBVFS_H_
+
+#include <string>
+#include <vector>
+
+#include "fat32.h"
+
+namespace VFS {
+
+    // typed entry point into a fat32 disk, for embedding the vfs without the terminal.
+    class libvfs {
+
+    public:
+        typedef IFS::fat32::stat_t stat_t;
+
+    public:
+        libvfs() = default;
+        ~libvfs() = default;
+        libvfs(const libvfs&) = delete;
+        libvfs(libvfs&&) = delete;
+
+    public:
+        int mount(const char* disk_name) noexcept;
+        int umount() noexcept;
+        [[nodiscard]] bool is_mnted() const noexcept;
+
+        int lookup(const char* path, stat_t& st) noexcept;
+        int stat(const char* path, stat_t& st) noexcept;
+        int readdir(const char* path, std::vector<stat_t>& entries) noexcept;
+
+        int open(const char* path, int flags) noexcept;
+        int64_t read(int fd, void* buf, uint64_t size) noexcept;
+        int64_t write(int fd, const void* buf, uint64_t size) noexcept;
+        int64_t lseek(int fd, int64_t offset, int whence) noexcept;
+        int fstat(int fd, stat_t& st) noexcept;
+        int close(int fd) noexcept;
+
+        [[nodiscard]] const buffer& output() const noexcept;
+
+    private:
+        buffer::scope bind() noexcept;
+
+    private:
+        buffer m_out;
+        std::string m_disk_name;
+        std::unique_ptr<IFS::fat32> m_fs;
+    };
+}
+
+#endif // _LIBVFS_H_
@@ -0,0 +1,41 @@
+#ifndef _LZ_H_
+#define _LZ_H_
+
+#include <stdint.h>
+#include <string.h>
+#include <stddef.h>
+#include <algorithm>
+
+namespace VFS {
+
+    // byte oriented LZ77 in the LZ4 block layout, every sequence is:
+    //   token (literal run << 4 | match length - 4) | [run extension] | literals | u16 offset | [match extension]
+    // a run or length of 15 carries on in bytes of 255 until one is smaller. the block ends
+    // on a sequence of literals only, so the last match leaves at least LAST_LITERALS behind it.
+    class lz {
+
+    public:
+        constexpr static size_t MIN_MATCH     = 4;
+        constexpr static size_t LAST_LITERALS = 5;
+        constexpr static size_t MATCH_LIMIT   = 12;
+        constexpr static size_t MAX_OFFSET    = 65535;
+        constexpr static size_t HASH_BITS     = 12;
+
+    public:
+        // worst case for n bytes that don't compress at all.
+        [[nodiscard]] static size_t bound(size_t n) noexcept;
+
+        // 0 when the block doesn't fit in cap, the caller sends the bytes as they are.
+        [[nodiscard]] static size_t compress(const char* src, size_t n, char* dst, size_t cap) noexcept;
+
+        // -1 on a block that is malformed or would write past cap, input comes off the wire.
+        [[nodiscard]] static int64_t decompress(const char* src, size_t n, char* dst, size_t cap) noexcept;
+
+    private:
+        static uint32_t read32(const uint8_t*) noexcept;
+        static uint32_t hash(uint32_t) noexcept;
+        static size_t put_run(uint8_t*, size_t) noexcept;
+    };
+}
+
+#endif // _LZ_H_
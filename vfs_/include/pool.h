@@ -0,0 +1,72 @@
+#ifndef _POOL_H_
+#define _POOL_H_
+
+#include <mutex>
+#include <deque>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <functional>
+#include <condition_variable>
+
+namespace VFS {
+
+    // fixed amount of worker threads. a task submitted from outside goes on the shared queue,
+    // one submitted by a worker goes on that worker's own deque and is taken back newest first.
+    // a worker with nothing of its own takes from the shared queue, then steals the oldest
+    // task another worker has queued.
+    class pool {
+
+    public:
+        // tasks that are waited on as a whole.
+        class group {
+        public:
+            group() = default;
+            group(const group&) = delete;
+
+        private:
+            friend class pool;
+            std::atomic<size_t> m_left = {};
+        };
+
+    public:
+        explicit pool(size_t amt);
+        ~pool();
+        pool(const pool&) = delete;
+        pool(pool&&) = delete;
+
+    public:
+        void submit(std::function<void()> task) noexcept;
+        void submit(group& grp, std::function<void()> task) noexcept;
+
+        // the caller runs queued tasks itself until every task of the group is done, so it
+        // can wait from inside a task of this pool.
+        void wait(group& grp) noexcept;
+        [[nodiscard]] size_t size() const noexcept;
+
+    private:
+        struct worker_t {
+            std::mutex lock;
+            std::deque<std::function<void()>> tasks;
+        };
+
+        void work(size_t id) noexcept;
+        bool run_one() noexcept;
+
+    private:
+        bool m_stop = {};
+        const size_t m_amt;
+        std::mutex m_lock;
+        std::condition_variable m_cv;
+        std::atomic<size_t> m_queued = {};
+        std::unique_ptr<worker_t[]> m_queues;
+        std::vector<std::thread> m_workers;
+        std::deque<std::function<void()>> m_tasks;
+
+        static thread_local pool* m_self;
+        static thread_local size_t m_id;
+    };
+}
+
+#endif // _POOL_H_
@@ -1,53 +1,129 @@
 #ifndef _RFS_H_
 #define _RFS_H_
 
+#include <deque>
+#include <atomic>
+#include <unordered_map>
 #include <thread>
+#include <functional>
+#include <condition_variable>
 #include <string.h>
 #include <stdlib.h>
 #include <vector>
+#include <algorithm>
+#include <sys/uio.h>
+#include <time.h>
 
 #include "buffer.h"
 #include "fs.h"
+#include "lz.h"
+#include "crc32c.h"
 
 namespace VFS::RFS {
 
     class rfs : public fs {
 
-    protected:
-        struct packet_t {
-            char signature[CFG_PACKET_SIGNATURE_SIZE]{};
-            uint64_t size = {};
-            uint64_t p_count = {};
-            int8_t cmd = {};
-            char hash[CFG_PACKET_HASH_SIZE]{};
-            char flags[CFG_FLAGS_BUFFER_SIZE]{};
-        } __attribute__((packed));
-
-        struct payload_header_t {
-            char hash[CFG_PACKET_HASH_SIZE]{};
-            uint64_t index{};
-            uint64_t size{};
-            uint8_t mf : 1{};
-        } __attribute__((packed));
-
-        struct payload_t {
-            payload_header_t header;
-            char payload[CFG_PAYLOAD_SIZE]{};
-        } __attribute__((packed));
+    public:
+        // v2 framing, every frame on the wire is:
+        //   varint len | u8 cmd | u8 flags | varint id | [HEAD: varint total | varint args_len | args] | [CRC: u32 crc] | body
+        // len counts everything after itself and never exceeds the negotiated max frame size.
+        // a FRAME_LZ body is varint raw size | lz block, it's only sent to peers that offered CAP_LZ.
+        // a FRAME_CRC crc32c covers the header before it and the body as sent, little endian.
+        enum frame_flag_t : uint8_t {
+            FRAME_HEAD   = 0x1,
+            FRAME_FIN    = 0x2,
+            FRAME_STREAM = 0x4,
+            FRAME_LZ     = 0x8,
+            FRAME_CRC    = 0x10
+        };
+
+        // capabilities offered in the hello, a connection uses those both ends offered.
+        enum cap_t : uint64_t {
+            CAP_LZ    = 0x1,
+            CAP_CRC   = 0x2,
+            CAP_LANES = 0x4
+        };
+
+        // the hello body is a run of varints in this order. fields past the frame size came later,
+        // a peer that stops early gets zeros for them. connections opened to carry part of a
+        // transfer share their session with the one the user opened and say which lane they are.
+        struct hello_t {
+            uint64_t version = {};
+            uint64_t max_frame = {};
+            uint64_t caps = {};
+            uint64_t session = {};
+            uint64_t lane = {};
+        };
 
         enum type_t {
             internal = -1,
             external = -2,
-            ping = -3
+            ping = -3,
+            hello = -4
         };
 
-        struct pcontainer_t {
-            packet_t info;
-            std::vector<payload_t>* payloads = new std::vector<payload_t>();
+        // chunks of a streamed message, handed from the thread reading the socket to the one
+        // consuming them. once more than CFG_STREAM_WINDOW is queued the reader has to back off,
+        // on_drain fires when the consumer has brought it back under half of that.
+        class stream_t {
+        public:
+            bool push(std::vector<char>&&) noexcept;
+            bool pop(std::vector<char>&) noexcept;
+            void finish() noexcept;
+            void abort() noexcept;
+            void wait_room() noexcept;
+            [[nodiscard]] bool full() noexcept;
+            [[nodiscard]] bool aborted() noexcept;
+
+            std::function<void()> on_drain = nullptr;
+
+        private:
+            std::mutex m_lock;
+            std::condition_variable m_cv;
+            std::deque<std::vector<char>> m_chunks;
+            uint64_t m_queued = {};
+            bool m_full = {};
+            bool m_fin = {};
+            bool m_abort = {};
+        };
+
+        // a whole request/reply, reassembled from one or more frames sharing an id. messages
+        // sent with FRAME_STREAM are handed out on their first frame and fill stream instead of data.
+        struct message_t {
+            int8_t cmd = {};
+            uint64_t id = {};
+            uint64_t total = {};
+            uint64_t received = {};
+            std::string args = {};
+            std::vector<char> data = {};
+            std::shared_ptr<stream_t> stream = nullptr;
+        };
+
+        // bytes read off a socket that don't form a whole frame yet, plus the messages being built.
+        // frames of different ids interleave on the wire, so more than one can be open at a time.
+        struct reader_t {
+            std::vector<char> rx = {};
+            std::unordered_map<uint64_t, std::shared_ptr<message_t>> pending = {};
+        };
 
-            ~pcontainer_t() { delete payloads; }
+        // body bytes before and after compression, both ways, summed over every connection.
+        struct stats_t {
+            std::atomic<uint64_t> raw_tx = {};
+            std::atomic<uint64_t> wire_tx = {};
+            std::atomic<uint64_t> raw_rx = {};
+            std::atomic<uint64_t> wire_rx = {};
+            std::atomic<uint64_t> packed = {};
+            std::atomic<uint64_t> unpacked = {};
+            std::atomic<uint64_t> pack_ns = {};
+            std::atomic<uint64_t> unpack_ns = {};
+            std::atomic<uint64_t> crc_fail = {};
         };
 
+        constexpr static size_t VARINT_SIZE = 10;
+        constexpr static size_t CRC_SIZE    = 4;
+        constexpr static size_t HELLO_SIZE  = VARINT_SIZE * 5;
+        constexpr static size_t HEADER_SIZE = VARINT_SIZE * 5 + 2 + CRC_SIZE + CFG_FRAME_ARGS_SIZE;
+
     public:
         rfs() = default;
         ~rfs() override = default;
@@ -61,29 +137,119 @@ namespace VFS::RFS {
 
 
     protected:
-        void serialize_packet(packet_t&, char*) noexcept;
-        void deserialize_packet(packet_t&, char*) noexcept;
-        [[nodiscard]] uint8_t process_packet(const packet_t&) const noexcept;
+        static size_t put_varint(char*, uint64_t) noexcept;
+        static size_t get_varint(const char*, size_t, uint64_t&) noexcept;
+        static void advance_iov(iovec*&, int&, size_t) noexcept;
+        static uint64_t cpu_ns() noexcept;
+
+        size_t write_header(char*, int8_t cmd, uint8_t flags, uint64_t id, uint64_t total, const std::string* args) const noexcept;
+        [[nodiscard]] uint8_t read_frames(reader_t&, std::vector<std::shared_ptr<message_t>>&, uint64_t max_frame, uint64_t max_message, uint64_t caps) const noexcept;
 
-        void serialize_payload(payload_t&, char*) noexcept;
-        void deserialize_payload(payload_t&, char*) noexcept;
-        [[nodiscard]] uint8_t process_payload(const packet_t&, const payload_t&) const noexcept;
+        void hello_body(char*, size_t&, uint64_t caps, uint64_t session, uint64_t lane) const noexcept;
+        [[nodiscard]] uint8_t process_hello(const message_t&, hello_t&) const noexcept;
+        void print_message(const message_t&) const noexcept;
 
-        void print_packet(const packet_t&) const noexcept;
-        void print_payload(const payload_t&) const noexcept;
-        std::shared_ptr<char[]> generate_hash() noexcept;
+    public:
+        void print_stats(const std::string& name) const noexcept;
 
     public:
-        uint64_t retain_payloads(std::shared_ptr<char[]>&, std::vector<payload_t>&) noexcept;
-        std::unique_ptr<pcontainer_t> generate_container(uint8_t cmd, std::vector<std::string>& args, std::shared_ptr<std::byte[]>& payload, uint64_t size) noexcept;
+        // splits a message into frames of at most max_frame bytes and hands each
+        // header/body pair to emit. the header lives in scratch space on the stack and
+        // the body points straight into data, so nothing is copied on the way out.
+        // with CAP_LZ in caps a body is compressed into a scratch block instead, unless it doesn't
+        // shrink. after a miss the next few frames aren't tried, incompressible files cost little.
+        // a source that hands back nullptr ends the stream there, the peer aborts it short of its total.
+        template<typename S, typename F>
+        void stream_frames(int8_t cmd, uint8_t head_flags, uint64_t id, const std::string& args, uint64_t size, uint64_t max_frame, uint64_t caps, S&& source, F&& emit) const noexcept {
+            char header[HEADER_SIZE];
+            char* rest = header + VARINT_SIZE;
+            uint64_t off = 0;
+            uint8_t flags = FRAME_HEAD | head_flags;
+            std::unique_ptr<char[]> scratch = nullptr;
+            uint64_t backoff = 0, skip = 0;
+            bool fin = false;
+
+            do {
+                const std::string* head_args = (flags & FRAME_HEAD) ? &args : nullptr;
+                size_t rest_size = write_header(rest, cmd, flags, id, size, head_args);
+                uint64_t body = std::min(size - off, max_frame - rest_size - ((caps & CAP_CRC) ? CRC_SIZE : 0));
+
+                if(off + body == size)
+                    flags |= FRAME_FIN;
+
+                const char* data = body ? source(off, body) : nullptr;
+                if(body && data == nullptr) {
+                    flags |= FRAME_FIN;
+                    body = 0;
+                }
+                uint64_t wire = body;
+
+                bool pack = (caps & CAP_LZ) && body >= CFG_LZ_MIN_SIZE;
+                if(pack && skip > 0) {
+                    skip--;
+                    pack = false;
+                }
+
+                if(pack) {
+                    // the first frame carries the args, later ones have more room for body.
+                    if(scratch == nullptr)
+                        scratch = std::unique_ptr<char[]>(new char[std::min(size, max_frame)]);
+
+                    uint64_t start = cpu_ns();
+                    size_t raw_size = put_varint(scratch.get(), body);
+                    size_t packed = lz::compress(data, body, scratch.get() + raw_size, body - raw_size - 1);
+                    stats.pack_ns += cpu_ns() - start;
+
+                    if(packed) {
+                        flags |= FRAME_LZ;
+                        data = scratch.get();
+                        wire = raw_size + packed;
+                        backoff = skip = 0;
+                        stats.packed++;
+                    } else {
+                        backoff = std::min<uint64_t>(backoff * 2 + 1, CFG_LZ_MAX_BACKOFF);
+                        skip = backoff;
+                    }
+                }
+                if(caps & CAP_CRC)
+                    flags |= FRAME_CRC;
+                rest_size = write_header(rest, cmd, flags, id, size, head_args);
+
+                if(flags & FRAME_CRC) {
+                    uint32_t crc = crc32c::update(crc32c::update(0, rest, rest_size), data, wire);
+                    for(size_t i = 0; i < CRC_SIZE; i++)
+                        rest[rest_size++] = (char)(crc >> (8 * i));
+                }
+
+                // the length prefix is written right in front of the rest of the header.
+                char len[VARINT_SIZE];
+                size_t len_size = put_varint(len, rest_size + wire);
+                memcpy(rest - len_size, len, len_size);
+
+                stats.raw_tx += body;
+                stats.wire_tx += wire;
+                emit((const char*)(rest - len_size), len_size + rest_size, data, wire);
+
+                off += body;
+                fin = flags & FRAME_FIN;
+                flags = 0;
+            } while(!fin);
+        }
+
+        // the source of a stream hands back body bytes for [off, off + size), a message already
+        // in memory just points into it.
+        template<typename F>
+        void for_each_frame(int8_t cmd, uint64_t id, const std::string& args, const char* data, uint64_t size, uint64_t max_frame, uint64_t caps, F&& emit) const noexcept {
+            stream_frames(cmd, 0, id, args, size, max_frame, caps, [data](uint64_t off, uint64_t) { return data + off; }, std::forward<F>(emit));
+        }
 
     public:
         std::mutex m_send;
         std::mutex m_recieve;
         std::mutex m_lock;
-        std::mutex m_ping;
 
-        constexpr static size_t BUFFER_SIZE = sizeof(packet_t) + sizeof(payload_t);
+    protected:
+        mutable stats_t stats;
     };
 }
 
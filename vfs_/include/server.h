@@ -1,17 +1,29 @@
 #ifndef _SERVER_H_
 #define _SERVER_H_
 
+#include <deque>
+#include <atomic>
+#include <memory>
 #include <vector>
 #include <thread>
 #include <utility>
+#include <unordered_map>
 
 #include "vfs.h"
 #include "rfs.h"
+#include "pool.h"
+#include "timer.h"
+#include "transport.h"
 
 #ifndef _WIN32
     #include <sys/time.h>
+    #include <sys/resource.h>
     #include <sys/types.h>
+    #include <sys/epoll.h>
+    #include <sys/eventfd.h>
     #include <netinet/in.h>
+    #include <netinet/tcp.h>
+    #include <sys/un.h>
     #include <unistd.h>
 #else
     #include <winsock2.h>
@@ -24,6 +36,15 @@
 #define EMPH_END              (uint32_t)65535
 #define PORT_RANGE(__port__)  (__port__ < EMPH_START || __port__ >  EMPH_END) ? 1 : 0
 
+// epoll tags for the non-client descriptors, connection ids start after them.
+#define LISTEN_ID             (uint64_t)0
+#define WAKE_ID               (uint64_t)1
+#define UNIX_ID               (uint64_t)2
+#define SHM_ID                (uint64_t)3
+
+namespace VFS::IFS { class fat32; }
+namespace VFS { struct session_t; }
+
 namespace VFS::RFS {
 
     class server : public rfs {
@@ -32,33 +53,85 @@ namespace VFS::RFS {
         struct connect_t {
             uint32_t m_port = {};
             int m_socket_fd = {};
+            int m_epoll_fd = {};
+            int m_event_fd = {};
+            int m_unix_fd = -1;
+            int m_shm_fd = -1;
             sockaddr_in hint = {};
             int opt = 1;
         };
 
         struct info_t {
             uint8_t state = {};
-            uint8_t users_c = {};
-            uint8_t max_usr_c = {};
+            std::atomic<uint32_t> users_c = {};
+            uint32_t max_usr_c = {};
+            std::atomic<uint64_t> next_id = {SHM_ID + 1};
         }info;
 
         struct client_t {
+            uint64_t id = {};
             uint8_t state = {};
-            int sock_fd = {};
-            sockaddr_in hint = {};
-            const char* ip = {};
-            int8_t recieved_ping = {};
+            std::unique_ptr<transport> link = nullptr;
+            std::string ip = {};
+
+            // liveness is judged on any traffic, both stamps are plain stores on the data path.
+            std::atomic<uint64_t> last_rx = {};
+            std::atomic<uint64_t> last_tx = {};
+            uint64_t beat = {};
+            uint64_t hello_deadline = {};
+
+            // frames read by the reactor, max_frame and caps are settled once the client says hello.
+            reader_t reader = {};
+            uint64_t max_frame = CFG_FRAME_MIN_SIZE;
+            uint64_t caps = {};
+            uint64_t session = {};
+            uint64_t lane = {};
+            std::atomic<bool> said_hello = {};
+
+            // keys of the transfers it sent a range of, under m_transfers.
+            std::vector<std::string> joined = {};
+
+            // the user's own mount and working directory, lanes share it with the connection that opened them.
+            std::shared_ptr<session_t> view = nullptr;
+
+            // set while a stream's window is full, the reactor stops reading until it drains.
+            bool paused = {};
 
+            // requests of one client run in order, one at a time. transfers are left out of
+            // the queue and get a worker of their own, so they don't hold up the rest.
+            std::mutex m_queue;
+            std::deque<std::shared_ptr<message_t>> queue = {};
+            bool running = {};
 
-            std::thread thrd = {};
-            std::thread ping = {};
+            std::mutex m_send;
+            buffer out{false, CFG_SESSION_RETAIN_SIZE};
 
             ~client_t() {
                     state = CFG_SOCK_CLOSE;
-                    close(sock_fd);
                 }
         };
 
+        // a file uploaded over several lanes at once. each lane writes its own range
+        // through the one handle, the last to finish closes it. left counts the ranges
+        // still to come, active the lanes writing one right now.
+        struct transfer_t {
+            IFS::fat32* fs = nullptr;
+            int fd = -1;
+            std::string dst = {};
+            uint64_t size = {};
+            uint64_t parts = {};
+            uint64_t left = {};
+            uint64_t active = {};
+            bool failed = {};
+        };
+
+        // clients are spread over shards by connection id, so the reactor and
+        // workers only contend when they touch the same shard.
+        struct shard_t {
+            std::mutex m_lock;
+            std::unordered_map<uint64_t, std::shared_ptr<client_t>> clients;
+        };
+
     public:
         server();
         ~server();
@@ -71,32 +144,66 @@ namespace VFS::RFS {
 
     public:
         void run() noexcept override;
-        void receive(client_t&) noexcept;
-        void recv_(char* buffer, client_t&, size_t bytes) noexcept;
-        void send(const char* buffer, client_t&, size_t buffer_size) noexcept;
-        void interpret_input(const std::shared_ptr<pcontainer_t>&, client_t*) noexcept;
-        void send_to_client(client_t&, type_t cmd, const std::string& ext_filename = "") noexcept;
+        void send(client_t&, iovec*, int, bool wait = true) noexcept;
+        void interpret_input(const std::shared_ptr<message_t>&, client_t*) noexcept;
+        void send_to_client(client_t&, type_t cmd, uint64_t id, const std::string& ext_filename = "") noexcept;
 
     private:
         void bind_sock() noexcept;
         void set_sockopt() noexcept;
         void mark_listener() noexcept;
+        void bind_local() noexcept;
+        [[nodiscard]] int listen_local(transport::kind_t) noexcept;
+        void define_reactor() noexcept;
         void set_state(int8_t) noexcept;
         void ping_client(client_t*) noexcept;
         void set_state(client_t&, int8_t) noexcept;
-        void ping(std::shared_ptr<client_t>) noexcept;
-        void remove_client(client_t* client) noexcept;
-        void handle(const std::shared_ptr<client_t>&) noexcept;
-        void set_recieved_ping(client_t&, int8_t) noexcept;
+        void accept_clients(uint64_t listener) noexcept;
+        void read_client(const std::shared_ptr<client_t>&) noexcept;
+        void parse_input(const std::shared_ptr<client_t>&) noexcept;
+        void dispatch(const std::shared_ptr<client_t>&, std::shared_ptr<message_t>) noexcept;
+        void drain(const std::shared_ptr<client_t>&) noexcept;
+        void transfer(const std::shared_ptr<client_t>&, const std::shared_ptr<message_t>&) noexcept;
+        [[nodiscard]] bool is_transfer(const message_t&) const noexcept;
+        void greet(const std::shared_ptr<client_t>&) noexcept;
+        void send_hello(client_t&) noexcept;
+        void resume(uint64_t id) noexcept;
+        void stream_in(const std::shared_ptr<message_t>&, client_t*) noexcept;
+        void stream_out(const std::vector<std::string>& args, uint64_t id, client_t*) noexcept;
+        std::shared_ptr<transfer_t> join_transfer(client_t*, const std::vector<std::string>& args) noexcept;
+        void leave_transfer(client_t*, const std::shared_ptr<transfer_t>&, bool done) noexcept;
+        void end_transfer(const std::shared_ptr<transfer_t>&) noexcept;
+        void drop_transfers(client_t&) noexcept;
+        IFS::fat32* mnted_fs() noexcept;
+        void join_session(client_t&) noexcept;
+        void heartbeat(uint64_t id) noexcept;
+        void check_hello(uint64_t id) noexcept;
+        void remove_client(uint64_t id) noexcept;
+        void raise_fd_limit() noexcept;
+        shard_t& shard_of(uint64_t id) noexcept;
+        std::shared_ptr<client_t> find_client(uint64_t id) noexcept;
+        void snapshot_clients(std::vector<std::shared_ptr<client_t>>&) noexcept;
         std::string find_ip(const sockaddr_in& sock) const noexcept;
-        void add_client(const uint32_t& sock, const sockaddr_in& hint) noexcept;
+        void add_client(std::unique_ptr<transport> link, const std::string& ip) noexcept;
 
     private:
         std::thread run_;
+        std::unique_ptr<pool> workers;
         std::unique_ptr<server::connect_t> conn;
-        std::unique_ptr<std::vector<std::pair<uint32_t, client_t*>>> clients;
+        std::unique_ptr<shard_t[]> shards;
+
+        std::mutex m_resume;
+        std::vector<uint64_t> resumed;
+
+        // connections that said hello with the same session token see the vfs the same way.
+        std::mutex m_sessions;
+        std::unordered_map<uint64_t, std::weak_ptr<session_t>> sessions;
+
+        // keyed by session and destination, so lanes of one client find each other.
+        std::mutex m_transfers;
+        std::unordered_map<std::string, std::shared_ptr<transfer_t>> transfers;
     };
 
 }
 
-#endif // _SERVER_H_
\ No newline at end of file
+#endif // _SERVER_H_
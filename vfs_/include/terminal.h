@@ -2,6 +2,7 @@
 #define _TERMINAL_H_
 
 #include <vector>
+#include <shared_mutex>
 #include <unordered_map>
 #include <unordered_set>
 
@@ -36,6 +37,7 @@ namespace VFS {
         static terminal* get_instance() noexcept;
         void interpret_cmd(vfs::system_cmd& cmd, std::vector<std::string>& args, char*& payload = (char*&)"", uint64_t size = 0, int8_t options = 0) noexcept;
         void translate_remote_cmd(vfs::system_cmd& cmd, std::vector<std::string>& args) noexcept;
+        std::shared_mutex& get_sys_lock() noexcept;
 
     private:
         void input(const char* line) noexcept;
@@ -67,7 +69,7 @@ namespace VFS {
     private:
         std::string path;
         vfs::system_t** m_mnted_system;
-        std::unique_ptr<std::mutex> sys_lock;
+        std::unique_ptr<std::shared_mutex> sys_lock;
         std::shared_ptr<std::unordered_map<std::string, cmd_t>> m_syscmds;
     };
 }
@@ -0,0 +1,72 @@
+#ifndef _TIMER_H_
+#define _TIMER_H_
+
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <functional>
+#include <unordered_map>
+#include <condition_variable>
+
+#include "config.h"
+
+namespace VFS {
+
+    // hierarchical timer wheel, one thread drives the timers of every connection in the process.
+    // a slot on level n spans SLOTS^n ticks and is cascaded a level down once the wheel reaches
+    // it, so arming and cancelling a timer stays O(1) however many are armed.
+    class timer_wheel {
+
+    public:
+        typedef std::function<void()> task_t;
+
+        constexpr static size_t LEVELS    = 4;
+        constexpr static size_t SLOT_BITS = 6;
+        constexpr static size_t SLOTS     = (size_t)1 << SLOT_BITS;
+
+    public:
+        explicit timer_wheel(uint64_t tick_ms = CFG_TIMER_TICK);
+        ~timer_wheel();
+        timer_wheel(const timer_wheel&) = delete;
+        timer_wheel(timer_wheel&&) = delete;
+
+    public:
+        static timer_wheel& get_wheel() noexcept;
+        [[nodiscard]] static uint64_t now() noexcept;
+
+        uint64_t schedule(uint64_t delay_ms, task_t task) noexcept;
+        uint64_t schedule_every(uint64_t period_ms, task_t task) noexcept;
+        void cancel(uint64_t id) noexcept;
+        [[nodiscard]] size_t size() noexcept;
+
+    private:
+        struct timer_t {
+            uint64_t due = {};
+            uint64_t period = {};
+            task_t task = nullptr;
+        };
+
+        void run() noexcept;
+        uint64_t arm(uint64_t delay_ms, uint64_t period_ms, task_t task) noexcept;
+        void place(uint64_t id, uint64_t due) noexcept;
+        void cascade(size_t level) noexcept;
+        void advance(std::vector<std::pair<uint64_t, task_t>>& due) noexcept;
+        [[nodiscard]] uint64_t idle_ticks() const noexcept;
+
+    private:
+        uint64_t m_tick_ms;
+        uint64_t m_start;
+        uint64_t m_tick = {};
+        uint64_t m_next_id = {};
+        uint64_t m_firing = {};
+        bool m_stop = {};
+
+        std::mutex m_lock;
+        std::condition_variable m_cv;
+        std::vector<uint64_t> m_slots[LEVELS][SLOTS];
+        std::unordered_map<uint64_t, timer_t> m_timers;
+        std::thread m_thread;
+    };
+}
+
+#endif // _TIMER_H_
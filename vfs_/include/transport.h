@@ -0,0 +1,139 @@
+#ifndef _TRANSPORT_H_
+#define _TRANSPORT_H_
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <stdint.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <sys/types.h>
+
+namespace VFS::RFS {
+
+    // what a connection's bytes go over, picked by the scheme of the address a remote is added with:
+    //   <ip>           tcp
+    //   unix[:<path>]  a unix socket, the server listens on one next to its tcp port
+    //   shm[:<path>]   a ring each way in memory both ends map. the unix socket only hands
+    //                  the descriptors over and tells either end when the other has gone
+    // send and recv behave as they would on a non-blocking socket, -1 with EAGAIN when they'd block.
+    class transport {
+
+    public:
+        enum kind_t : uint8_t {
+            TCP  = 0,
+            UNIX = 1,
+            SHM  = 2
+        };
+
+        struct addr_t {
+            kind_t kind = TCP;
+            std::string host = {};
+        };
+
+    public:
+        virtual ~transport() = default;
+
+        virtual ssize_t send(const iovec*, int) noexcept = 0;
+        virtual ssize_t recv(char*, size_t) noexcept = 0;
+
+        // true once there's room or input, or the other end has hung up. false when the timeout runs out.
+        virtual bool wait_send(int timeout) noexcept = 0;
+        virtual bool wait_recv(int timeout) noexcept = 0;
+
+        // registers what a reactor has to watch, input and hang ups both come back tagged with id.
+        virtual void watch(int epoll_fd, uint64_t id) noexcept = 0;
+        virtual void unwatch(int epoll_fd) noexcept = 0;
+        virtual void shutdown() noexcept = 0;
+        [[nodiscard]] virtual kind_t kind() const noexcept = 0;
+
+        // a unix or shm address without a path goes to the server on the same port.
+        [[nodiscard]] static addr_t parse(const char* addr, uint32_t port) noexcept;
+        [[nodiscard]] static std::string path(kind_t kind, uint32_t port) noexcept;
+    };
+
+    class sock_transport : public transport {
+
+    public:
+        sock_transport(int fd, kind_t kind) noexcept;
+        ~sock_transport() override;
+
+        ssize_t send(const iovec*, int) noexcept override;
+        ssize_t recv(char*, size_t) noexcept override;
+        bool wait_send(int timeout) noexcept override;
+        bool wait_recv(int timeout) noexcept override;
+        void watch(int epoll_fd, uint64_t id) noexcept override;
+        void unwatch(int epoll_fd) noexcept override;
+        void shutdown() noexcept override;
+        [[nodiscard]] kind_t kind() const noexcept override;
+
+    private:
+        int fd = -1;
+        kind_t m_kind = TCP;
+    };
+
+    // the server makes the memory and eventfds and sends them down the freshly accepted
+    // socket, the client maps what it's given. each end writes one ring and reads the other:
+    //   [ring_t c2s | c2s bytes][ring_t s2c | s2c bytes]
+    // head and tail only ever grow and are taken modulo the ring size. an end that finds a
+    // ring empty or full says so in the ring before it sleeps on its eventfd, and the other
+    // end only pays for a write to the eventfd when someone is waiting.
+    class shm_transport : public transport {
+
+    public:
+        struct ring_t {
+            alignas(64) std::atomic<uint64_t> head;
+            alignas(64) std::atomic<uint64_t> tail;
+            alignas(64) std::atomic<uint32_t> reader_waiting;
+            std::atomic<uint32_t> writer_waiting;
+        };
+
+        enum efd_t {
+            C2S_DATA = 0,
+            C2S_ROOM = 1,
+            S2C_DATA = 2,
+            S2C_ROOM = 3,
+            EFD_AMT  = 4
+        };
+
+    public:
+        ~shm_transport() override;
+
+        // nullptr when the memory couldn't be made or the descriptors didn't arrive in time.
+        [[nodiscard]] static std::unique_ptr<shm_transport> offer(int sock_fd, uint64_t ring_size) noexcept;
+        [[nodiscard]] static std::unique_ptr<shm_transport> take(int sock_fd, int timeout) noexcept;
+
+        ssize_t send(const iovec*, int) noexcept override;
+        ssize_t recv(char*, size_t) noexcept override;
+        bool wait_send(int timeout) noexcept override;
+        bool wait_recv(int timeout) noexcept override;
+        void watch(int epoll_fd, uint64_t id) noexcept override;
+        void unwatch(int epoll_fd) noexcept override;
+        void shutdown() noexcept override;
+        [[nodiscard]] kind_t kind() const noexcept override;
+
+    private:
+        shm_transport(int sock_fd, int mem_fd, const int* efds, uint64_t ring_size, bool server) noexcept;
+
+        [[nodiscard]] bool mapped() const noexcept;
+        [[nodiscard]] bool peer_gone() const noexcept;
+        static void signal(int efd) noexcept;
+        static void clear(int efd) noexcept;
+
+    private:
+        int sock = -1;
+        int efd[EFD_AMT] = {-1, -1, -1, -1};
+        char* base = nullptr;
+        size_t map_size = {};
+        uint64_t size = {};
+
+        ring_t* tx = nullptr;
+        ring_t* rx = nullptr;
+        char* tx_data = nullptr;
+        char* rx_data = nullptr;
+        int tx_data_fd = -1, tx_room_fd = -1;
+        int rx_data_fd = -1, rx_room_fd = -1;
+    };
+}
+
+#endif // _TRANSPORT_H_
@@ -2,6 +2,7 @@
 #define _VFS_H_
 
 #include <set>
+#include <mutex>
 #include <string>
 #include <vector>
 #include <cstdio>
@@ -16,6 +17,8 @@
 
 namespace VFS {
 
+    struct session_t;
+
     struct vfs {
 
     public:
@@ -82,8 +85,10 @@ namespace VFS {
         void add_remote(std::vector <std::string> &);
         void rm_remote(std::vector <std::string> &);
         void lst_disks(std::vector <std::string> &);
+        void rfs_stats(std::vector <std::string> &);
         void init_server(std::vector <std::string> &);
         void vfs_help() const noexcept;
+        void set_mnted_system(const system_t&) noexcept;
 
     public:
         void init_sys_cmds() noexcept;
@@ -98,14 +103,20 @@ namespace VFS {
     public:
         void load_disks() noexcept;
         static vfs *get_vfs() noexcept;
-        const bool is_mnted() const noexcept;
-        std::shared_ptr <vfs::system_t> &get_mnted_system() noexcept;
+        const bool is_mnted() noexcept;
+        std::shared_ptr <vfs::system_t> get_mnted_system() noexcept;
+        IFS::fat32::cwd_t& get_cwd() noexcept;
         std::shared_ptr <std::vector<vfs::cmd_t>> get_sys_cmds() noexcept;
 
     private:
+        friend struct session_t;
+
         static vfs* mp_vfs;
+        static thread_local session_t* m_session;
         std::unique_ptr <RFS::rfs> server;
+        std::mutex m_view_lock;
         std::shared_ptr <system_t> mnted_system;
+        IFS::fat32::cwd_t console_cwd;
         std::shared_ptr <std::vector<vfs::cmd_t>> sys_cmds;
         std::unique_ptr <std::unordered_map<std::string, system_t>> disks;
 
@@ -114,6 +125,25 @@ namespace VFS {
         static constexpr const char *DEFAULT_FS = "fat32";
         static constexpr const char *syscmd_str[] = {"/vfs", "ls", "mkdir", "cd", "rm", "touch", "cp", "mv", "cat","/help", "/clear", "/exit", "invalid"};
     };
+
+    // what one remote user sees of the vfs, the disk they have mounted and where they are on it.
+    // it starts out on whatever the console has mounted, and keeps that disk when the console
+    // moves on. bound to the thread running one of the user's commands, like a buffer::scope.
+    struct session_t {
+        std::shared_ptr<vfs::system_t> mnted_system = nullptr;
+        IFS::fat32::cwd_t cwd;
+
+        class scope {
+        public:
+            explicit scope(session_t& session) noexcept;
+            ~scope() noexcept;
+            scope(const scope&) = delete;
+
+        private:
+            session_t* m_prev;
+            IFS::fat32::scope m_cwd;
+        };
+    };
 }
 
 #endif //_VFS_H_
\ No newline at end of file
@@ -0,0 +1,34 @@
+#ifndef _XXH64_H_
+#define _XXH64_H_
+
+#include <stdint.h>
+#include <string.h>
+#include <stddef.h>
+
+namespace VFS {
+
+    // xxh64, a fast non cryptographic 64 bit hash. blocks of 32 bytes go through four lanes
+    // that don't depend on each other, so they run side by side, and are folded together at
+    // the end. the seed carries one hash on into the next.
+    class xxh64 {
+
+    public:
+        constexpr static uint64_t PRIME_1 = 0x9E3779B185EBCA87ULL;
+        constexpr static uint64_t PRIME_2 = 0xC2B2AE3D27D4EB4FULL;
+        constexpr static uint64_t PRIME_3 = 0x165667B19E3779F9ULL;
+        constexpr static uint64_t PRIME_4 = 0x85EBCA77C2B2AE63ULL;
+        constexpr static uint64_t PRIME_5 = 0x27D4EB2F165667C5ULL;
+
+    public:
+        [[nodiscard]] static uint64_t hash(const char* data, size_t n, uint64_t seed) noexcept;
+
+    private:
+        static uint64_t round(uint64_t acc, uint64_t input) noexcept;
+        static uint64_t merge(uint64_t acc, uint64_t val) noexcept;
+        static uint64_t rotl(uint64_t val, int bits) noexcept;
+        static uint64_t read64(const uint8_t*) noexcept;
+        static uint32_t read32(const uint8_t*) noexcept;
+    };
+}
+
+#endif // _XXH64_H_
@@ -1,79 +1,129 @@
 #include "../include/buffer.h"
 #include <memory>
+#include <charconv>
+#include <algorithm>
 
 using namespace VFS;
 
-std::shared_ptr<buffer> buffer::mBuf_p;
+thread_local buffer* buffer::m_current = nullptr;
 
-buffer::buffer() {
+buffer::buffer(bool echo, size_t retain) : m_echo(echo), m_retain(retain) {
     this->mLock = std::make_unique<std::mutex>();
-    this->mStream = std::make_unique<std::vector<char>>();
+
+    // sinks that don't retain anything only allocate once written to.
+    if(m_retain >= CFG_BUFFER_INIT_SIZE)
+        reserve(CFG_BUFFER_INIT_SIZE);
 }
 
-std::shared_ptr<buffer> buffer::get_buffer() noexcept {
-    if(!mBuf_p) {
-        mBuf_p = std::shared_ptr<buffer>(new buffer);
-    }
-    
-    return mBuf_p;
+buffer::scope::scope(buffer& sink) noexcept : m_prev(m_current) {
+    m_current = &sink;
+}
+
+buffer::scope::~scope() noexcept {
+    m_current = m_prev;
+}
+
+buffer* buffer::get_console() noexcept {
+    static buffer console(true);
+    return &console;
+}
+
+buffer* buffer::get_buffer() noexcept {
+    return m_current ? m_current : get_console();
 }
 
 void buffer::hold_buffer() noexcept {
-     if(!mStream->empty()) {
+     if(m_echo && m_size > 0) {
          printf("\r");
          print_stream();
-         mStream->clear();
+         m_size = 0;
      }
     mLock->lock();
 }
 
 void buffer::release_buffer() noexcept {
     mLock->unlock();
-    mStream->clear();
-    mStream.reset();
-    mStream = std::make_unique<std::vector<char>>();
+    clear();
 }
 
 void buffer::retain_buffer(char*& store) const noexcept {
-    store = (char*)malloc(sizeof(char) * mStream->size());
-    std::copy(mStream->begin(), mStream->end(), store);
+    store = (char*)malloc(sizeof(char) * m_size);
+    memcpy(store, m_data.get(), m_size);
 }
 
 void buffer::retain_buffer(std::shared_ptr<std::byte[]>& store) const noexcept {
-    store = std::shared_ptr<std::byte[]>(new std::byte[mStream->size()]);
-    std::copy(mStream->begin(), mStream->end(), (char*)store.get());
+    store = std::shared_ptr<std::byte[]>(new std::byte[m_size]);
+    memcpy(store.get(), m_data.get(), m_size);
 }
 
+void buffer::reserve(size_t cap) noexcept {
+    if(cap <= m_cap)
+        return;
+
+    cap = std::max({cap, m_cap * 2, CFG_BUFFER_INIT_SIZE});
+    std::unique_ptr<char[]> tmp = std::unique_ptr<char[]>(new char[cap]);
+
+    if(m_size > 0)
+        memcpy(tmp.get(), m_data.get(), m_size);
+
+    m_data = std::move(tmp);
+    m_cap = cap;
+}
+
+char* buffer::grow(size_t len) noexcept {
+    reserve(m_size + len);
+    char* tail = m_data.get() + m_size;
+    m_size += len;
+    return tail;
+}
+
+// what was written past size is dropped, the arena keeps its capacity.
+void buffer::truncate(size_t size) noexcept {
+    m_size = std::min(m_size, size);
+}
+
+void buffer::append(const char* str, size_t len) noexcept {
+    memcpy(grow(len), str, len);
+}
 
 buffer& buffer::operator<<(const char* str) noexcept {
-    for(int i = 0; i < strlen(str); i++) {
-        mStream->push_back(str[i]);
-    }
+    append(str, strlen(str));
+    return *(this);
+}
 
+buffer& buffer::operator<<(std::string_view str) noexcept {
+    append(str.data(), str.size());
     return *(this);
 }
 
 buffer& buffer::operator<<(uint64_t val) noexcept {
-    int amt = lib_::countDigit(val);
-    char buffer[amt];
-
-    lib_::itoa_(val, buffer, 10, amt);
-    buffer[amt] = '\0';
-
-    *this << buffer;
+    char buffer[20];
+    auto res = std::to_chars(buffer, buffer + sizeof(buffer), val);
 
+    append(buffer, res.ptr - buffer);
     return (*this);
 }
 
-void buffer::append(char* str, size_t len) const noexcept {
-    for(int i = 0; i < len; i++) {
-        mStream->push_back(str[i]);
+void buffer::clear() noexcept {
+    m_size = 0;
+
+    if(m_cap > m_retain) {
+        m_data.reset();
+        m_cap = 0;
+
+        if(m_retain >= CFG_BUFFER_INIT_SIZE)
+            reserve(CFG_BUFFER_INIT_SIZE);
     }
 }
 
-void buffer::print_stream() const noexcept {
-    for(int i = 0; i < mStream->size(); i++) {
-        printf("%c", (*mStream)[i]);
-    }
+const char* buffer::data() const noexcept {
+    return m_data.get();
 }
 
+size_t buffer::size() const noexcept {
+    return m_size;
+}
+
+void buffer::print_stream() const noexcept {
+    fwrite(m_data.get(), sizeof(char), m_size, stdout);
+}
@@ -3,323 +3,670 @@
 
 using namespace VFS::RFS;
 
-client::client(const char* addr, const int32_t& port) {
+client::client(const char* addr, const int32_t& port, uint64_t session, uint64_t lane) : session(session), lane(lane) {
     conn.m_addr = addr;
     conn.m_port = port;
+
+    // lanes share the session of the client that opened them, so the server can tell they belong together.
+    if(this->session == 0) {
+        std::random_device rd;
+        this->session = ((uint64_t)rd() << 32 | rd()) | 1;
+    }
     set_state(CFG_SOCK_OPEN);
-    set_recieved_ping(0);
     client::init();
 }
 
 client::~client() {
     set_state(CFG_SOCK_CLOSE);
+    timer_wheel::get_wheel().cancel(beat);
+
+    // the receiving thread wakes up on the shutdown and hangs up on its way out.
+    if(link)
+        link->shutdown();
+    if(recv_.joinable())
+        recv_.join();
+
+    // exports still being written out are let go, then every thread working for us is waited on.
+    for(auto& it : reader.pending) {
+        if(it.second->stream)
+            it.second->stream->abort();
+    }
+
+    std::unique_lock<std::mutex> lock(m_inflight);
+    inflight_cv.wait(lock, [this] { return tasks == 0; });
 }
 
 void client::init() noexcept {
     define_fd();
     add_hint();
-    connect();
+
+    if(connect() == 0) {
+        set_state(CFG_SOCK_CLOSE);
+        disconnected = 1;
+
+        // a lane that can't connect is dropped, the transfer goes over the ones that did.
+        if(lane)
+            return;
+    }
+    say_hello();
     std::string addr = conn.m_addr;
 
-    BUFFER << LOG_str(log::INFO, "You have successfully connected to the mp_vfs: [address : " + addr + "]");
+    if(lane == 0 && info.state == CFG_SOCK_OPEN)
+        BUFFER << LOG_str(log::INFO, "You have successfully connected to the mp_vfs: [address : " + addr + "]");
+    last_rx = last_tx = timer_wheel::now();
     recv_ = std::thread(&client::run, this);
-    recv_.detach();
 
-    #if !defined _DEBUG_
-    ping_ = std::thread(&client::ping, this);
-    ping_.detach();
+    #if !_DEBUG_
+    beat = timer_wheel::get_wheel().schedule_every(CFG_HEARTBEAT_INTERVAL, [this] { heartbeat(); });
     #endif
 }
 
 void client::define_fd() noexcept {
-    if((conn.m_socket_fd = socket(AF_INET, SOCK_STREAM, 0)) == -1) {
+    conn.where = transport::parse(conn.m_addr, conn.m_port);
+
+    if((conn.m_socket_fd = socket(conn.where.kind == transport::TCP ? AF_INET : AF_UNIX, SOCK_STREAM, 0)) == -1) {
         BUFFER << LOG_str(log::ERROR_, "Socket[SOCK_STREAM] could not be created");
         return;
     }
 }
 
 void client::add_hint() noexcept {
+    if(conn.where.kind != transport::TCP) {
+        conn.local.sun_family = AF_UNIX;
+        strncpy(conn.local.sun_path, conn.where.host.c_str(), sizeof(conn.local.sun_path) - 1);
+        return;
+    }
+
     conn.hint.sin_family = AF_INET;
     conn.hint.sin_port   = htons(conn.m_port);
 
-    unsigned long res = inet_addr(conn.m_addr);
+    unsigned long res = inet_addr(conn.where.host.c_str());
     if(res == INADDR_NONE) {
         BUFFER << LOG_str(log::ERROR_, "Address specified is not valid");
         return;
     } else conn.hint.sin_addr = in_addr{(in_addr_t)res};
 }
 
-void client::connect() noexcept {
-    if(::connect(conn.m_socket_fd, (sockaddr*)&conn.hint, sizeof(conn.hint)) == -1) {
+uint8_t client::connect() noexcept {
+    bool tcp = conn.where.kind == transport::TCP;
+    sockaddr* hint = tcp ? (sockaddr*)&conn.hint : (sockaddr*)&conn.local;
+    socklen_t hint_size = tcp ? sizeof(conn.hint) : sizeof(conn.local);
+
+    if(conn.m_socket_fd == -1 || ::connect(conn.m_socket_fd, hint, hint_size) == -1) {
         LOG(log::ERROR_, "Could not connect to mp_vfs, please try again or check IP/ Port specified. Make sure server, is initialised");
+        close(conn.m_socket_fd);
+        return 0;
     }
+
+    // a shm server answers the connect with the rings, everything after goes through those.
+    if(conn.where.kind == transport::SHM)
+        link = shm_transport::take(conn.m_socket_fd, CFG_HELLO_TIMEOUT);
+    else link = std::make_unique<sock_transport>(conn.m_socket_fd, conn.where.kind);
+
+    if(link == nullptr) {
+        LOG(log::ERROR_, "Could not map the shared memory offered by mp_vfs");
+        return 0;
+    }
+    return 1;
 }
 
 void client::run() noexcept {
     while(info.state == CFG_SOCK_OPEN) {
         receive_from_server();
     }
-    if(disconnected) {
+    if(disconnected && lane == 0) {
         std::vector<std::string> args;
         vfs::get_vfs()->umnt_disk(args);
     }
-    close(conn.m_socket_fd);
-    BUFFER << (LOG_str(log::SERVER, "Disconnected from server, either it has crashed or closed off it's connection"));
+
+    if(link)
+        link->shutdown();
+
+    // nothing more is coming back, anyone waiting on a reply is let go.
+    m_inflight.lock();
+    inflight.clear();
+    m_inflight.unlock();
+    inflight_cv.notify_all();
+
+    if(lane == 0)
+        BUFFER << (LOG_str(log::SERVER, "Disconnected from server, either it has crashed or closed off it's connection"));
+}
+
+void client::say_hello() noexcept {
+    char body[HELLO_SIZE];
+    size_t size = {};
+    hello_body(body, size, offered_caps(), session, lane);
+
+    std::lock_guard<std::mutex> lock(m_send);
+    for_each_frame((int8_t)type_t::hello, 0, std::string(CFG_PACKET_SIGNATURE, CFG_PACKET_SIGNATURE_SIZE), body, size, max_frame, 0,
+        [&](const char* header, size_t header_size, const char* data, uint64_t data_size) {
+            iovec iov[2] = {{(void*)header, header_size}, {(void*)data, data_size}};
+            send(iov, data_size ? 2 : 1);
+        });
+}
+
+uint64_t client::offered_caps() const noexcept {
+    // nothing on the same host is worth compressing or checking, and one connection isn't held back by a window.
+    return conn.where.kind == transport::TCP ? CFG_RFS_CAPS : 0;
+}
+
+bool client::wait_hello() noexcept {
+    std::unique_lock<std::mutex> lock(m_inflight);
+    inflight_cv.wait_for(lock, std::chrono::milliseconds(CFG_HELLO_TIMEOUT), [this] { return greeted || info.state != CFG_SOCK_OPEN; });
+    return greeted && info.state == CFG_SOCK_OPEN;
+}
+
+std::vector<std::unique_ptr<client>> client::open_lanes(size_t amt) noexcept {
+    std::vector<std::unique_ptr<client>> lanes(amt);
+    std::vector<std::thread> dial;
+
+    // lanes connect side by side, each takes a round trip or two before it can carry anything.
+    for(size_t i = 0; i < amt; i++) {
+        dial.emplace_back([this, &lanes, i] {
+            lanes[i] = std::make_unique<client>(conn.m_addr, conn.m_port, session, i + 1);
+            if(!lanes[i]->wait_hello())
+                lanes[i].reset();
+        });
+    }
+
+    for(auto& it : dial)
+        it.join();
+
+    lanes.erase(std::remove(lanes.begin(), lanes.end(), nullptr), lanes.end());
+    return lanes;
 }
 
 void client::handle_send(const char* str_cmd, uint8_t cmd, std::vector<std::string>& args) noexcept {
-    std::shared_ptr<std::byte[]> payload = nullptr;
-    uint64_t size = get_payload(str_cmd, args, payload);
-    std::unique_ptr<pcontainer_t> container = generate_container(cmd, args, payload, size);
-
-    // Serialize packet.
-    char buffer[BUFFER_SIZE];
-    memset(buffer, 0, BUFFER_SIZE);
-    serialize_packet(container->info, buffer);
-
-    // sending info packet towards server, with command info related to input. Formatted ispl.
-    send(buffer, sizeof(packet_t));
-
-    if(container->info.p_count > 0) {
-        double data_sent = 0;
-        double data_size = container->info.size;
-        data_size -= (sizeof(packet_t) * 8);
-        m_ping.lock();
-        #if _DEBUG_
-            LOG(log::INFO, "Ping stopped");
-        #endif
-        
-        for(int i = 0; i < container->info.p_count; i++) {
-            memset(buffer, 0, BUFFER_SIZE);
-            // Serialize payload
-            serialize_payload(container->payloads->at(i), buffer);
-            // send payload per fragment.
-            send(buffer, sizeof(payload_t));
-            data_sent += container->payloads->at(i).header.size;
-
-            lib_::printProgress((double)data_sent/data_size);
+    request(str_cmd, cmd, args);
+}
+
+uint64_t client::request(const char* str_cmd, uint8_t cmd, std::vector<std::string>& args, reply_t on_reply) noexcept {
+    uint64_t size = {};
+    uint64_t id = {};
+    FILE* file = nullptr;
+
+    if(get_payload(str_cmd, args, file, size) == 0)
+        return 0;
+
+    std::string flags = {};
+    for(const auto& a : args)
+        flags += (flags.empty() ? "" : " ") + a;
+
+    {
+        // pipelining is bounded, a burst of requests can't queue up without limit on the server. nothing
+        // goes out before the server's hello, the server expects frames sent with the caps it settles.
+        std::unique_lock<std::mutex> lock(m_inflight);
+        inflight_cv.wait(lock, [this] { return (greeted && inflight.size() < CFG_RFS_INFLIGHT_MAX) || info.state != CFG_SOCK_OPEN; });
+
+        if(info.state != CFG_SOCK_OPEN) {
+            if(file)
+                fclose(file);
+            return 0;
         }
-        if(data_sent != 0) {
-            lib_::printProgress((double)data_sent/data_size);
-            printf("\n");
+        id = ++next_id;
+        inflight[id].on_reply = std::move(on_reply);
+
+        if(file)
+            tasks++;
+    }
+
+    // a file goes out on a thread of its own, requests sent meanwhile go out between its frames.
+    // a large one is split over lanes when the server can take it that way.
+    if(file) {
+        std::shared_ptr<FILE> shared = std::shared_ptr<FILE>(file, fclose);
+        bool split = lane == 0 && (caps & CAP_LANES) && size >= CFG_RFS_LANE_MIN_SIZE && args.size() == 3;
+
+        std::thread transfer = split ? std::thread(&client::send_split, this, id, cmd, args, shared, size)
+                                     : std::thread(&client::send_stream, this, id, cmd, std::move(flags), shared, 0, size);
+        transfer.detach();
+        return id;
+    }
+
+    std::lock_guard<std::mutex> lock(m_send);
+    for_each_frame((int8_t)cmd, id, flags, nullptr, 0, max_frame, caps,
+        [&](const char* header, size_t header_size, const char*, uint64_t) {
+            iovec iov = {(void*)header, header_size};
+            send(&iov, 1);
+        });
+    return id;
+}
+
+uint64_t client::upload(uint8_t cmd, std::string args, std::shared_ptr<FILE> file, uint64_t offset, uint64_t size) noexcept {
+    uint64_t id = {};
+    {
+        std::lock_guard<std::mutex> lock(m_inflight);
+
+        if(info.state != CFG_SOCK_OPEN)
+            return 0;
+
+        // the client that split the transfer reports on it, replies to a range are only waited on.
+        id = ++next_id;
+        inflight[id].on_reply = [](const message_t&) {};
+        tasks++;
+    }
+
+    std::thread range = std::thread(&client::send_stream, this, id, cmd, std::move(args), std::move(file), offset, size);
+    range.detach();
+    return id;
+}
+
+void client::send_stream(uint64_t id, uint8_t cmd, std::string args, std::shared_ptr<FILE> file, uint64_t offset, uint64_t size) noexcept {
+    stream_file(id, cmd, args, file.get(), offset, size);
+    task_done();
+}
+
+void client::send_split(uint64_t id, uint8_t cmd, std::vector<std::string> args, std::shared_ptr<FILE> file, uint64_t size) noexcept {
+    // the request isn't done until every lane has been answered as well as this connection.
+    {
+        std::lock_guard<std::mutex> lock(m_inflight);
+        inflight[id].streams++;
+    }
+
+    std::vector<std::unique_ptr<client>> lanes = open_lanes(CFG_RFS_LANES - 1);
+    std::vector<std::pair<client*, uint64_t>> waits;
+    uint64_t parts = lanes.size() + 1;
+    uint64_t stripe = (size + parts - 1) / parts;
+
+    // imp <src> <dst> <offset> <size> <parts>, a range per lane and the first one goes over this connection.
+    auto range = [&](uint64_t part) {
+        return "imp " + args[1] + " " + args[2] + " " + std::to_string(std::min(size, part * stripe)) + " " + std::to_string(size) + " " + std::to_string(parts);
+    };
+    auto length = [&](uint64_t part) {
+        return std::min(size - std::min(size, part * stripe), stripe);
+    };
+
+    for(uint64_t part = 1; part < parts; part++) {
+        client* via = lanes[part - 1].get();
+        uint64_t range_id = via->upload(cmd, range(part), file, std::min(size, part * stripe), length(part));
+
+        // a lane that dropped since it said hello leaves its range to this connection.
+        if(range_id == 0) {
+            via = this;
+            range_id = upload(cmd, range(part), file, std::min(size, part * stripe), length(part));
         }
-        m_ping.unlock();
-        #if _DEBUG_
-            LOG(log::INFO, "Ping started");
-        #endif
+        waits.emplace_back(via, range_id);
     }
-    //packet has been sent.
+
+    stream_file(id, cmd, range(0), file.get(), 0, length(0));
+
+    for(auto& it : waits)
+        it.first->wait(it.second);
+    lanes.clear();
+
+    finish(id, true);
+    task_done();
+}
+
+void client::stream_file(uint64_t id, uint8_t cmd, const std::string& args, FILE* file, uint64_t offset, uint64_t size) noexcept {
+    // a local file is read one frame at a time, so only a frame of it is ever in memory. ranges
+    // of one file go out over several lanes at once, so reads say where they're from.
+    uint64_t frame_size = max_frame;
+    std::unique_ptr<char[]> window = std::unique_ptr<char[]>(new char[frame_size]);
+    double data_sent = 0;
+    bool cut = false;
+
+    // a read that comes up short ends the stream, the server empties the file rather than keep a hole.
+    // once the connection is gone there's no one to send the rest to either.
+    stream_frames((int8_t)cmd, FRAME_STREAM, id, args, size, frame_size, caps,
+        [&](uint64_t off, uint64_t want) {
+            if(info.state != CFG_SOCK_OPEN)
+                return (const char*)nullptr;
+
+            cut = pread(fileno(file), window.get(), want, offset + off) != (ssize_t)want;
+            return cut ? nullptr : (const char*)window.get();
+        },
+        [&](const char* header, size_t header_size, const char* data, uint64_t data_size) {
+            iovec iov[2] = {{(void*)header, header_size}, {(void*)data, data_size}};
+            m_send.lock();
+            send(iov, data_size ? 2 : 1);
+            m_send.unlock();
+
+            data_sent += data_size;
+            if(size > 0 && lane == 0)
+                lib_::printProgress(data_sent / size);
+        });
+
+    if(size > 0 && lane == 0) {
+        printf("\n");
+        fflush(stdout);
+    }
+
+    // imp <src> <dst> ..., the local file is named second.
+    if(cut)
+        BUFFER << LOG_str(log::WARNING, "file: [" + lib_::split(args.c_str(), ' ')[1] + "] could not be read whole, its copy was cut short");
+}
+
+void client::wait(uint64_t id) noexcept {
+    std::unique_lock<std::mutex> lock(m_inflight);
+    inflight_cv.wait(lock, [&] { return inflight.find(id) == inflight.end() || info.state != CFG_SOCK_OPEN; });
+}
+
+size_t client::in_flight() noexcept {
+    std::lock_guard<std::mutex> lock(m_inflight);
+    return inflight.size();
 }
 
 void client::receive_from_server() noexcept {
-    int master_sock = conn.m_socket_fd;
-    fd_set master_set;
-    struct timeval tv{};
-
-    FD_ZERO(&master_set);
-    FD_SET(conn.m_socket_fd, &master_set);
-    tv.tv_sec = SOCKET_ACCEPT_TIME;
-
-    select(master_sock + 1, &master_set, NULL, NULL, &tv);
-        
-    if(FD_ISSET(master_sock, &master_set)) {
-        char buffer[BUFFER_SIZE];
-        memset(buffer, 0, BUFFER_SIZE);
-
-        receive(buffer, sizeof(packet_t));
-            
-        std::unique_ptr<pcontainer_t> container = std::make_unique<pcontainer_t>();
-        deserialize_packet(container->info, buffer);
-
-        if(container->info.cmd == (int8_t)type_t::ping) {
-            set_recieved_ping(1);
-            return;
-        }
+    if(!link->wait_recv(SOCKET_ACCEPT_TIME * 1000))
+        return;
 
-        if(process_packet(container->info) == 0 && info.state == CFG_SOCK_OPEN) {
+    char buffer[KB(64)];
+    ssize_t bytes = link->recv(buffer, sizeof(buffer));
+
+    if(bytes == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        return;
+
+    if(bytes <= 0) {
+        if(info.state == CFG_SOCK_OPEN) {
             set_state(CFG_SOCK_CLOSE);
             disconnected = 1;
-            return;
         }
-           
-        if(container->info.p_count > 0) {
-            double data_sent = 0;
-            double data_size = container->info.size;
-            data_size -= (sizeof(packet_t) * 8);
-            bool ext = (container->info.cmd == (int8_t)type_t::external);
-            m_ping.lock();
-            #if _DEBUG_
-                LOG(log::INFO, "Ping stopped");
-            #endif
-            
-            payload_t tmp_payload;
-            for(int i = 0; i < container->info.p_count; i++) {
-                memset(buffer, 0, BUFFER_SIZE);
-                receive(buffer, sizeof(payload_t));
-                deserialize_payload(tmp_payload, buffer);
-                
-                if(process_payload(container->info, tmp_payload) == 0) {
-                    set_state(CFG_SOCK_CLOSE);
-                    disconnected = 1;
-                    return;
-                }
-                container->payloads->push_back(tmp_payload);
-                data_sent += container->payloads->at(i).header.size;
-
-                if(ext)
-                    lib_::printProgress((double)data_sent/data_size);
+        return;
+    }
+    reader.rx.insert(reader.rx.end(), buffer, buffer + bytes);
+
+    // any traffic counts as a heartbeat, the server only pings when it has nothing else to send.
+    last_rx = timer_wheel::now();
+
+    // the greeting can follow the hello in the same read, until then anything offered is taken.
+    std::vector<std::shared_ptr<message_t>> msgs;
+    if(read_frames(reader, msgs, CFG_FRAME_MAX_SIZE, CFG_RFS_REPLY_MAX_SIZE, greeted ? caps.load() : offered_caps() & ~CAP_CRC) == 0 && info.state == CFG_SOCK_OPEN) {
+        set_state(CFG_SOCK_CLOSE);
+        disconnected = 1;
+        return;
+    }
+
+    for(auto& it : reader.pending) {
+        const message_t& pending = *it.second;
+
+        if(lane == 0 && pending.cmd == (int8_t)type_t::external && pending.total > 0) {
+            lib_::printProgress((double)pending.received / pending.total);
+            break;
+        }
+    }
+
+    for(auto& msg : msgs) {
+        if(msg->cmd == (int8_t)type_t::ping)
+            continue;
+
+        if(msg->cmd == (int8_t)type_t::hello) {
+            hello_t hello = {};
+            if(process_hello(*msg, hello) == 0) {
+                set_state(CFG_SOCK_CLOSE);
+                disconnected = 1;
+                return;
             }
-            if(data_sent != 0 && ext) {
-                lib_::printProgress((double)data_sent/data_size);
-                printf("\n");
+            max_frame = hello.max_frame;
+            caps = hello.caps & offered_caps();
+            {
+                std::lock_guard<std::mutex> lock(m_inflight);
+                greeted = true;
             }
-            m_ping.unlock();
-            #if _DEBUG_
-                LOG(log::INFO, "Ping started");
-            #endif
+            inflight_cv.notify_all();
+            continue;
         }
 
-        std::thread handle_data = std::thread(&client::interpret_input, this, std::move(container));
+        {
+            // an export's file arrives as a stream ahead of its reply, its request waits on both.
+            std::lock_guard<std::mutex> lock(m_inflight);
+            auto it = inflight.find(msg->id);
+
+            if(msg->stream && it != inflight.end())
+                it->second.streams++;
+            tasks++;
+        }
+
+        std::thread handle_data = std::thread(&client::interpret_input, this, std::move(msg));
         handle_data.detach();
     }
+
+    // a file being written can't keep up, stop reading until its window drains.
+    for(auto& it : reader.pending) {
+        if(it.second->stream && it.second->stream->full())
+            it.second->stream->wait_room();
+    }
 }
 
-void client::interpret_input(std::unique_ptr<pcontainer_t> container) noexcept {
-    BUFFER.hold_buffer();
+void client::interpret_input(std::shared_ptr<message_t> msg) noexcept {
+    reply_t on_reply = nullptr;
 
-    uint64_t payload_size = 1;
+    if(!msg->stream) {
+        std::lock_guard<std::mutex> lock(m_inflight);
+        auto it = inflight.find(msg->id);
 
-    for(int i = 0; i < container->info.p_count; i++)
-        payload_size += container->payloads->at(i).header.size;
+        if(it != inflight.end())
+            on_reply = it->second.on_reply;
+    }
 
-    std::unique_ptr<char[]> buffer = std::unique_ptr<char[]>(new char[payload_size]);
-    memset(buffer.get(), 0, payload_size);
+    // the buffer is only held for what's printed into it. a lane's messages belong to a transfer its
+    // client already holds it for, as do ranges past the first that fell back to this connection.
+    std::vector<std::string> part = msg->stream ? lib_::split(msg->args.c_str(), ' ') : std::vector<std::string>();
+    bool hold = lane == 0 && !on_reply && !(part.size() == 5 && strtoull(part[2].c_str(), nullptr, 10) > 0);
 
-    uint64_t data_copied = 0;
-    for(int i = 0; i < container->info.p_count; i++) {
-        memcpy(&(buffer[data_copied]), container->payloads->at(i).payload, container->payloads->at(i).header.size);
-        data_copied += container->payloads->at(i).header.size;
-    }
+    if(hold)
+        BUFFER.hold_buffer();
+
+    if(on_reply)
+        on_reply(*msg);
+    else output_data(*msg);
+
+    if(hold)
+        BUFFER.release_buffer();
 
-    buffer[payload_size - 1] = '\n';
-    output_data(*container, buffer.get(), payload_size);
-    BUFFER.release_buffer();
+    finish(msg->id, msg->stream != nullptr);
+    task_done();
 }
 
-void client::output_data(const pcontainer_t& container, char* buffer, int64_t size) noexcept {
-    if(container.info.cmd == (int8_t)type_t::external) {
+void client::finish(uint64_t id, bool stream) noexcept {
+    std::lock_guard<std::mutex> lock(m_inflight);
+    auto it = inflight.find(id);
 
-        std::shared_ptr<std::byte[]> bytes = std::shared_ptr<std::byte[]>(new std::byte[size]);
-        memcpy(bytes.get(), buffer, size);
-        std::string filename = container.info.flags;
-        filename[filename.size() - 1] = '\0';
+    if(it == inflight.end())
+        return;
 
-        store_ext_file_buffer(filename.c_str(), bytes, (uint64_t)size);
-    } else if(container.info.cmd == (int8_t)type_t::internal) {
-        BUFFER.append(buffer, size);
-        memset(buffer, 0, size);
-        BUFFER.print_stream();
-    }
+    if(stream)
+        it->second.streams--;
+    else it->second.replied = true;
+
+    if(!it->second.replied || it->second.streams > 0)
+        return;
+
+    inflight.erase(it);
+    inflight_cv.notify_all();
 }
 
-void client::send(const char* buffer, size_t buffer_size) noexcept {
-    m_send.lock();
-    int number_of_bytes = {};
-    size_t bytes_sent = {};
+void client::task_done() noexcept {
+    std::lock_guard<std::mutex> lock(m_inflight);
+    tasks--;
+    inflight_cv.notify_all();
+}
 
-    while(number_of_bytes < buffer_size && (bytes_sent = ::send(conn.m_socket_fd, buffer, (buffer_size - number_of_bytes), MSG_NOSIGNAL))) {
-        number_of_bytes += bytes_sent;
-        buffer += bytes_sent;
+void client::output_data(const message_t& msg) noexcept {
+    if(msg.cmd == (int8_t)type_t::external && msg.stream) {
+        std::vector<std::string> part = lib_::split(msg.args.c_str(), ' ');
 
-        if(bytes_sent == -1) {
-            BUFFER << LOG_str(log::WARNING, "input could not be sent towards remote mp_vfs");
-            m_send.unlock();
+        if(part.size() == 5) {
+            recv_part(msg, part);
             return;
         }
-    }
-    m_send.unlock();
-}
 
-uint8_t client::receive(char* buffer, size_t bytes) noexcept {
-    m_recieve.lock();
-    int number_of_bytes = {};
-    size_t bytes_received = {};
+        FILE* file = get_file_handlr(msg.args.c_str(), (char*)"wb");
+        std::vector<char> chunk;
 
-    while(number_of_bytes < bytes && (bytes_received = recv(conn.m_socket_fd, buffer, (bytes - number_of_bytes), MSG_NOSIGNAL)) > 0) {
-        number_of_bytes += bytes_received;
-        buffer += bytes_received;
+        if(file == nullptr)
+            BUFFER << LOG_str(log::WARNING, "File specified could not be created");
 
-        if(bytes_received == -1) {
-            BUFFER << (LOG_str(log::WARNING, "client was unable to read incoming data from mounted server"));
-            m_recieve.unlock();
-            return -1;
+        // chunks are drained either way, the server keeps sending until it's done.
+        while(msg.stream->pop(chunk)) {
+            if(file)
+                fwrite(chunk.data(), 1, chunk.size(), file);
         }
+
+        if(file && msg.stream->aborted()) {
+            fflush(file);
+            ftruncate(fileno(file), 0);
+            BUFFER << LOG_str(log::WARNING, "file: [" + msg.args + "] did not arrive whole, it has been emptied");
+        }
+
+        if(file)
+            fclose(file);
+
+        lib_::printProgress(1.0);
+        printf("\n");
+        fflush(stdout);
+    } else if(msg.cmd == (int8_t)type_t::internal) {
+        BUFFER.append(msg.data.data(), msg.data.size());
+        BUFFER.print_stream();
     }
-    m_recieve.unlock();
-    return 1;
 }
 
-uint64_t client::get_payload(const char* cmd, std::vector<std::string>& args, std::shared_ptr<std::byte[]>& payload) noexcept {
-    uint64_t size = {};
-    if(strcmp(cmd, "cp") == 0) {
-        if(strcmp(args[0].c_str(), "imp") == 0)
-            size = fs::get_ext_file_buffer(args[1].c_str(), payload);
+void client::recv_part(const message_t& msg, const std::vector<std::string>& part) noexcept {
+    // <dst> <src> <offset> <size> <parts>, each range is written where it belongs. the first
+    // one sizes the file and asks for the rest over lanes while it's still coming in.
+    uint64_t offset = strtoull(part[2].c_str(), nullptr, 10);
+    uint64_t size = strtoull(part[3].c_str(), nullptr, 10);
+    uint64_t parts = strtoull(part[4].c_str(), nullptr, 10);
+    int fd = ::open(part[0].c_str(), O_WRONLY | O_CREAT, 0644);
+    std::vector<std::unique_ptr<client>> lanes;
+    std::vector<std::pair<client*, uint64_t>> waits;
+    std::vector<char> chunk;
+    uint64_t written = {};
+
+    if(fd == -1)
+        BUFFER << LOG_str(log::WARNING, "File specified could not be created");
+
+    // ranges that fall back to this connection come in here as well, only the first asks for the rest.
+    if(lane == 0 && offset == 0 && fd != -1 && parts > 1) {
+        ftruncate(fd, size);
+        lanes = open_lanes(std::min<uint64_t>(parts, CFG_RFS_LANES) - 1);
+
+        for(uint64_t i = 1; i < parts; i++) {
+            std::vector<std::string> args = {"exp", part[1], part[0], std::to_string(i), std::to_string(parts)};
+            client* via = lanes.empty() ? this : lanes[(i - 1) % lanes.size()].get();
+            uint64_t id = via->request("cp", (uint8_t)vfs::system_cmd::cp, args, [](const message_t&) {});
+
+            // a lane that dropped since it said hello leaves its range to this connection.
+            if(id == 0 && via != this) {
+                via = this;
+                id = request("cp", (uint8_t)vfs::system_cmd::cp, args, [](const message_t&) {});
+            }
+            waits.emplace_back(via, id);
+        }
     }
 
-    if(payload == nullptr) {
-        payload = std::shared_ptr<std::byte[]>(new std::byte);
+    // chunks are drained either way, the server keeps sending until it's done.
+    while(msg.stream->pop(chunk)) {
+        if(fd != -1)
+            pwrite(fd, chunk.data(), chunk.size(), offset + written);
+        written += chunk.size();
+    }
+
+    for(auto& it : waits)
+        it.first->wait(it.second);
+    lanes.clear();
+
+    // the other ranges may still be coming in on lanes of their own, only this one is known to be short.
+    if(fd != -1 && msg.stream->aborted())
+        BUFFER << LOG_str(log::WARNING, "file: [" + part[0] + "] did not arrive whole, a range of it is missing");
+
+    if(fd != -1)
+        close(fd);
+
+    if(lane == 0) {
+        lib_::printProgress(1.0);
+        printf("\n");
+        fflush(stdout);
     }
-    return size;
 }
 
-void client::ping() noexcept {
-    std::vector<std::string> args;
-    int8_t unrecievedAmt = 0;
+uint8_t client::send(iovec* iov, int iov_c, bool wait) noexcept {
+    bool started = false;
 
-    while(info.state == CFG_SOCK_OPEN) {
-        sleep(1);
-
-        if(recieved_ping == 1) {
-            m_ping.lock();
-            ping_server();
-            set_recieved_ping(0);
-
-            #if _DEBUG_
-                LOG(log::INFO, "Ping");
-            #endif
-            
-            unrecievedAmt ^= unrecievedAmt;
-        } else unrecievedAmt++;
-
-        if(unrecievedAmt == 10) {
-            BUFFER << LOG_str(log::WARNING, "Have not recieved ping from server, disconnecting..");
-            std::vector<std::string> args;
-            vfs::get_vfs()->umnt_disk(args);
-            set_state(CFG_SOCK_CLOSE);
+    if(info.state != CFG_SOCK_OPEN)
+        return 0;
+
+    // callers hold m_send, so a frame's header and body are never split by a ping.
+    while(iov_c > 0) {
+        ssize_t bytes_sent = link->send(iov, iov_c);
+
+        if(bytes_sent > 0) {
+            advance_iov(iov, iov_c, bytes_sent);
+            last_tx = timer_wheel::now();
+            started = true;
+            continue;
         }
-        m_ping.unlock();
+
+        // a frame that can't start without waiting is dropped, once started it has to go out whole.
+        // the server stops reading while one of our streams is backed up, that's waited out.
+        if(bytes_sent == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            if(!wait && !started)
+                return 0;
+
+            while(!link->wait_send(CFG_SOCK_SEND_TIMEOUT) && info.state == CFG_SOCK_OPEN);
+            if(info.state == CFG_SOCK_OPEN)
+                continue;
+        }
+
+        BUFFER << LOG_str(log::WARNING, "input could not be sent towards remote mp_vfs");
+        return 0;
     }
+    return 1;
 }
 
-void client::ping_server() noexcept {
-    std::string ping = "PING";
-    std::vector<std::string> flags;
+uint8_t client::get_payload(const char* cmd, std::vector<std::string>& args, FILE*& file, uint64_t& size) noexcept {
+    if(strcmp(cmd, "cp") != 0 || strcmp(args[0].c_str(), "imp") != 0)
+        return 1;
 
-    char buffer[BUFFER_SIZE];
-    memset(buffer, 0, BUFFER_SIZE);
+    if((file = get_file_handlr(args[1].c_str(), (char*)"rb")) == nullptr) {
+        BUFFER << LOG_str(log::WARNING, "File specified could not be opened");
+        return 0;
+    }
 
-    std::shared_ptr<std::byte[]> bytes = std::shared_ptr<std::byte[]>(new std::byte[ping.length()]);
-    std::memcpy(bytes.get(), ping.data(), ping.length());
+    fseek(file, 0, SEEK_END);
+    size = ftell(file);
+    rewind(file);
+    return 1;
+}
+
+void client::heartbeat() noexcept {
+    uint64_t now = timer_wheel::now();
+
+    if(info.state != CFG_SOCK_OPEN)
+        return;
+
+    // the receiving thread sees the socket go down and unmounts.
+    if(now - last_rx >= (uint64_t)CFG_HEARTBEAT_INTERVAL * CFG_HEARTBEAT_MISS_AMT) {
+        BUFFER << LOG_str(log::WARNING, "Have not heard from server, disconnecting..");
+        link->shutdown();
+        return;
+    }
+
+    {
+        // a ping before the server's hello would go out without the crc the server then expects.
+        std::lock_guard<std::mutex> lock(m_inflight);
+        if(!greeted)
+            return;
+    }
+
+    // a ping only fills a gap in the traffic. a frame going out right now does the same job.
+    if(now - last_tx < (uint64_t)CFG_HEARTBEAT_INTERVAL / 2 || !m_send.try_lock())
+        return;
+
+    ping_server();
+    m_send.unlock();
 
-    std::unique_ptr<pcontainer_t> container = generate_container((int8_t)type_t::ping, flags, bytes, ping.length());
-    serialize_packet(container->info, buffer);
-    send(buffer, sizeof(packet_t));
+    #if _DEBUG_
+        LOG(log::INFO, "Ping");
+    #endif
 }
 
-void client::set_recieved_ping(int8_t val) noexcept {
-    m_lock.lock();
-    this->recieved_ping = val;
-    m_lock.unlock();
+void client::ping_server() noexcept {
+    // callers hold m_send. the wheel never waits on a full socket, a server that stopped reading times out instead.
+    for_each_frame((int8_t)type_t::ping, 0, "", nullptr, 0, max_frame, caps,
+        [&](const char* header, size_t header_size, const char*, uint64_t) {
+            iovec iov = {(void*)header, header_size};
+            send(&iov, 1, false);
+        });
 }
 
 void client::set_state(int8_t val) noexcept {
@@ -0,0 +1,184 @@
+#include "../include/crc32c.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <nmmintrin.h>
+#elif defined(__aarch64__)
+#include <arm_acle.h>
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+
+using namespace VFS;
+
+crc32c::tables_t::tables_t() noexcept {
+    for(uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for(int j = 0; j < 8; j++)
+            crc = (crc >> 1) ^ (POLY & (0 - (crc & 1)));
+        t[0][i] = crc;
+    }
+
+    // t[k][i] is the crc of i followed by k zero bytes, eight of them fold a whole word at once.
+    for(uint32_t i = 0; i < 256; i++) {
+        for(int k = 1; k < 8; k++)
+            t[k][i] = (t[k - 1][i] >> 8) ^ t[0][t[k - 1][i] & 0xFF];
+    }
+
+    zeros(long_shift, LONG_BLOCK);
+    zeros(short_shift, SHORT_BLOCK);
+}
+
+void crc32c::tables_t::zeros(uint32_t (*shift)[256], size_t len) const noexcept {
+    uint32_t bits[32];
+
+    // running a crc over zeros is linear, it's worked out for each bit and the bytes are sums of those.
+    for(int b = 0; b < 32; b++) {
+        uint32_t crc = (uint32_t)1 << b;
+        for(size_t i = 0; i < len; i++)
+            crc = (crc >> 8) ^ t[0][crc & 0xFF];
+        bits[b] = crc;
+    }
+
+    for(int k = 0; k < 4; k++) {
+        for(uint32_t v = 0; v < 256; v++) {
+            uint32_t crc = 0;
+            for(int b = 0; b < 8; b++) {
+                if(v & (1 << b))
+                    crc ^= bits[k * 8 + b];
+            }
+            shift[k][v] = crc;
+        }
+    }
+}
+
+const crc32c::tables_t& crc32c::tables() noexcept {
+    static const tables_t tables;
+    return tables;
+}
+
+uint32_t crc32c::fold(const uint32_t (*shift)[256], uint32_t crc) noexcept {
+    return shift[0][crc & 0xFF] ^ shift[1][(crc >> 8) & 0xFF] ^ shift[2][(crc >> 16) & 0xFF] ^ shift[3][crc >> 24];
+}
+
+uint32_t crc32c::software(uint32_t crc, const char* data, size_t n) noexcept {
+    const uint32_t (*t)[256] = tables().t;
+    const uint8_t* p = (const uint8_t*)data;
+    uint32_t c = ~crc;
+
+    // the tables are laid out for little endian words.
+    #if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    while(n >= 8) {
+        uint32_t lo, hi;
+        memcpy(&lo, p, 4);
+        memcpy(&hi, p + 4, 4);
+        lo ^= c;
+
+        c = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24] ^
+            t[3][hi & 0xFF] ^ t[2][(hi >> 8) & 0xFF] ^ t[1][(hi >> 16) & 0xFF] ^ t[0][hi >> 24];
+        p += 8;
+        n -= 8;
+    }
+    #endif
+
+    while(n--)
+        c = (c >> 8) ^ t[0][(c ^ *p++) & 0xFF];
+    return ~c;
+}
+
+#if defined(__x86_64__)
+#define CRC_TARGET_NAME "sse4.2"
+#define CRC_TARGET __attribute__((target(CRC_TARGET_NAME), always_inline)) inline
+
+CRC_TARGET static uint64_t crc_word(uint64_t crc, uint64_t word) noexcept {
+    return _mm_crc32_u64(crc, word);
+}
+
+CRC_TARGET static uint64_t crc_byte(uint64_t crc, uint8_t byte) noexcept {
+    return _mm_crc32_u8((uint32_t)crc, byte);
+}
+
+bool crc32c::has_hardware() noexcept {
+    return __builtin_cpu_supports("sse4.2");
+}
+#elif defined(__aarch64__)
+#define CRC_TARGET_NAME "+crc"
+#define CRC_TARGET __attribute__((target(CRC_TARGET_NAME), always_inline)) inline
+
+CRC_TARGET static uint64_t crc_word(uint64_t crc, uint64_t word) noexcept {
+    return __crc32cd((uint32_t)crc, word);
+}
+
+CRC_TARGET static uint64_t crc_byte(uint64_t crc, uint8_t byte) noexcept {
+    return __crc32cb((uint32_t)crc, byte);
+}
+
+bool crc32c::has_hardware() noexcept {
+    return (getauxval(AT_HWCAP) & HWCAP_CRC32) != 0;
+}
+#else
+bool crc32c::has_hardware() noexcept {
+    return false;
+}
+#endif
+
+#if defined(CRC_TARGET)
+template<size_t LEN>
+CRC_TARGET static const uint8_t* crc_3way(uint64_t& crc, const uint8_t* p, size_t& n, const uint32_t (*shift)[256]) noexcept {
+    // one crc instruction has to wait on the last, three blocks run side by side and are folded after.
+    while(n >= LEN * 3) {
+        uint64_t c0 = crc, c1 = 0, c2 = 0;
+        const uint8_t* end = p + LEN;
+
+        do {
+            uint64_t w0, w1, w2;
+            memcpy(&w0, p, 8);
+            memcpy(&w1, p + LEN, 8);
+            memcpy(&w2, p + LEN * 2, 8);
+            c0 = crc_word(c0, w0);
+            c1 = crc_word(c1, w1);
+            c2 = crc_word(c2, w2);
+            p += 8;
+        } while(p < end);
+
+        crc = crc32c::fold(shift, (uint32_t)c0) ^ c1;
+        crc = crc32c::fold(shift, (uint32_t)crc) ^ c2;
+        p += LEN * 2;
+        n -= LEN * 3;
+    }
+    return p;
+}
+
+__attribute__((target(CRC_TARGET_NAME)))
+uint32_t crc32c::hardware(uint32_t crc, const char* data, size_t n) noexcept {
+    const uint8_t* p = (const uint8_t*)data;
+    uint64_t c = ~crc;
+
+    p = crc_3way<LONG_BLOCK>(c, p, n, tables().long_shift);
+    p = crc_3way<SHORT_BLOCK>(c, p, n, tables().short_shift);
+
+    while(n >= 8) {
+        uint64_t word;
+        memcpy(&word, p, 8);
+        c = crc_word(c, word);
+        p += 8;
+        n -= 8;
+    }
+
+    while(n--)
+        c = crc_byte(c, *p++);
+    return ~(uint32_t)c;
+}
+#else
+uint32_t crc32c::hardware(uint32_t crc, const char* data, size_t n) noexcept {
+    return software(crc, data, n);
+}
+#endif
+
+uint32_t crc32c::update(uint32_t crc, const char* data, size_t n) noexcept {
+    static const bool hw = has_hardware();
+    return hw ? hardware(crc, data, n) : software(crc, data, n);
+}
+
+const char* crc32c::impl() noexcept {
+    return has_hardware() ? "hardware" : "slicing-by-8";
+}
@@ -56,8 +56,38 @@ diskdriver::ret_t disk::read(void* ptr, const size_t& size, const uint32_t& amt)
     return ttl_amt == amt ? VALID : ERROR;
 }
 
+// pread and pwrite go around stdio, anything written that is still in its buffer goes to the file first.
+void disk::flush_stream() noexcept {
+    if(m_dirty) {
+        std::lock_guard<std::mutex> lock(m_io);
+        if(m_dirty) {
+            fflush(file);
+            m_dirty = false;
+        }
+    }
+}
+
+// reads at an offset without moving the stream, readers sharing the disk don't take turns.
+diskdriver::ret_t disk::read_at(void* ptr, const size_t& size, const uint32_t& amt, const long& offset) {
+    size_t want = size * amt, got = 0;
+    flush_stream();
+
+    while(got < want) {
+        ssize_t n = pread(fileno(file), (char*)ptr + got, want - got, offset + got);
+        if(n <= 0)
+            break;
+        got += n;
+    }
+
+    if(got != want)
+        LOG(log::ERROR_, "Error reading disk at '" + std::string(std::to_string(offset)) + "'.");
+
+    return got == want ? VALID : ERROR;
+}
+
 diskdriver::ret_t disk::write(const void *ptr, const size_t &size, const uint32_t &amt) {
     size_t ttl_amt = fwrite(ptr, size, amt, file);
+    m_dirty = true;
 
     if(ttl_amt != amt)
         LOG(log::ERROR_, "Error writing disk at '" + std::string(std::to_string(addr)) + "'.");
@@ -65,6 +95,24 @@ diskdriver::ret_t disk::write(const void *ptr, const size_t &size, const uint32_
     return ttl_amt == amt ? VALID : ERROR;
 }
 
+// the same for writes, writers to different parts of the disk don't share a stream position.
+diskdriver::ret_t disk::write_at(const void* ptr, const size_t& size, const uint32_t& amt, const long& offset) {
+    size_t want = size * amt, put = 0;
+    flush_stream();
+
+    while(put < want) {
+        ssize_t n = pwrite(fileno(file), (const char*)ptr + put, want - put, offset + put);
+        if(n <= 0)
+            break;
+        put += n;
+    }
+
+    if(put != want)
+        LOG(log::ERROR_, "Error writing disk at '" + std::string(std::to_string(offset)) + "'.");
+
+    return put == want ? VALID : ERROR;
+}
+
 diskdriver::ret_t disk::seek(const long &offset) {
     int8_t val = fseek(file, offset, SEEK_SET);
 
@@ -1,10 +1,81 @@
 #include "../include/fat32.h"
+#include <algorithm>
+#include <sys/stat.h>
 
 using namespace VFS::IFS;
 
 const uint32_t fat32::CLUSTER_SIZE;
 const uint64_t fat32::CLUSTER_AMT;
 
+thread_local fat32::cwd_t* fat32::m_cwd = nullptr;
+thread_local uint8_t fat32::m_tree_held = 0;
+thread_local uint64_t fat32::m_held = 0;
+
+fat32::scope::scope(cwd_t& cwd) noexcept : m_prev(m_cwd) {
+    m_cwd = &cwd;
+}
+
+fat32::scope::~scope() noexcept {
+    m_cwd = m_prev;
+}
+
+fat32::dir_lock::dir_lock(fat32& fs, std::initializer_list<uint32_t> clus, bool excl) noexcept : m_fs(fs), m_excl(excl) {
+    for (uint32_t clu : clus)
+        m_taken |= (uint64_t)1 << (clu % CFG_DIR_LOCK_STRIPES);
+    m_taken &= ~m_held;
+
+    // lowest stripe first, everyone takes them in the same order.
+    for (size_t i = 0; i < CFG_DIR_LOCK_STRIPES; i++) {
+        if (!(m_taken & ((uint64_t)1 << i)))
+            continue;
+
+        if (m_excl)
+            m_fs.m_dir_locks[i].lock();
+        else m_fs.m_dir_locks[i].lock_shared();
+    }
+    m_held |= m_taken;
+}
+
+fat32::dir_lock::~dir_lock() noexcept {
+    for (size_t i = 0; i < CFG_DIR_LOCK_STRIPES; i++) {
+        if (!(m_taken & ((uint64_t)1 << i)))
+            continue;
+
+        if (m_excl)
+            m_fs.m_dir_locks[i].unlock();
+        else m_fs.m_dir_locks[i].unlock_shared();
+    }
+    m_held &= ~m_taken;
+}
+
+fat32::tree_lock::tree_lock(fat32& fs, bool excl) noexcept : m_fs(fs) {
+    if (m_tree_held)
+        return;
+
+    if (excl)
+        m_fs.m_tree_lock.lock();
+    else m_fs.m_tree_lock.lock_shared();
+
+    m_taken = m_tree_held = excl ? 2 : 1;
+}
+
+fat32::tree_lock::~tree_lock() noexcept {
+    if (m_taken == 2)
+        m_fs.m_tree_lock.unlock();
+    else if (m_taken == 1)
+        m_fs.m_tree_lock.unlock_shared();
+
+    if (m_taken)
+        m_tree_held = 0;
+}
+
+fat32::snapshot::snapshot(fat32& fs) noexcept : m_fs(fs), m_epoch(fs.pin()) {
+}
+
+fat32::snapshot::~snapshot() noexcept {
+    m_fs.unpin(m_epoch);
+}
+
 fat32::fat32(const char* disk_name) : DISK_NAME(disk_name), PATH_TO_DISK(std::string("disks/" + std::string(DISK_NAME)).c_str()) {
 
     if(check_config() == -1) {
@@ -40,16 +111,29 @@ void fat32::set_up() noexcept {
     define_superblock();
     define_fat_table();
 
-    for(int i = CLUSTER_AMT - 1; i >= 0; i--)
-        m_free_clusters->insert(i);
+    if (CFG_DEDUP) {
+        m_features.flags |= FEATURE_DEDUP;
+        m_fps = std::unique_ptr<uint64_t[]>(new uint64_t[CLUSTER_AMT]());
+    }
+
+    if (CFG_COMPRESS) {
+        m_features.flags |= FEATURE_LZ;
+        m_features.chunk_size = CFG_COMPRESS_CHUNK;
+    }
+
+    // the root sits in the first cluster, the whole table is written out.
+    m_fat_table[ROOT_CLUSTER] = ALLOCATED_CLUSTER;
+    for(uint32_t i = 0; i < FAT_PAGE_AMT; i++)
+        m_fat_pages[i].dirty = true;
+    fill_free_map();
 
-    m_root = init_dir(0, 0, "root");
-    m_curr_dir = m_root;
+    m_root = init_dir(ROOT_CLUSTER, ROOT_CLUSTER, "root");
 
     create_disk();
     store_superblock();
+    store_features();
+    write_dir(m_root, {ROOT_CLUSTER});
     store_fat_table();
-    store_dir(m_root);
     
     BUFFER << (LOG_str(log::INFO, "file system has been initialised."));
     
@@ -87,9 +171,18 @@ void fat32::define_superblock() noexcept {
 }
 
 void fat32::define_fat_table() noexcept {
-    m_free_clusters = std::make_unique<std::unordered_set<uint32_t>>();
-    m_fat_table = std::unique_ptr<uint32_t[]>(new uint32_t[CLUSTER_AMT]);
-    memset((void*)m_fat_table.get(), UNALLOCATED_CLUSTER, (size_t)CLUSTER_AMT);
+    m_fat_table = std::unique_ptr<uint32_t[]>(new uint32_t[CLUSTER_AMT]());
+    m_fat_pages = std::unique_ptr<fat_page_t[]>(new fat_page_t[FAT_PAGE_AMT]);
+    m_free_map = std::unique_ptr<std::atomic<uint64_t>[]>(new std::atomic<uint64_t>[FREE_MAP_WORDS]());
+    m_refs = std::unique_ptr<uint32_t[]>(new uint32_t[CLUSTER_AMT]());
+    m_shared_n = 0;
+    m_refs_n = 0;
+    m_mags = std::unique_ptr<magazine_t[]>(new magazine_t[CFG_ALLOC_MAGAZINES]);
+    m_free_n = 0;
+
+    // each magazine starts in its own part of the disk, so parallel writers don't interleave.
+    for(size_t i = 0; i < CFG_ALLOC_MAGAZINES; i++)
+        m_mags[i].cursor = (uint32_t)(i * FREE_MAP_WORDS / CFG_ALLOC_MAGAZINES);
 }
 
 std::shared_ptr<fat32::dir_t> fat32::init_dir(const uint32_t & start_cl, const uint32_t & parent_clu, const char* name) noexcept {
@@ -117,111 +210,119 @@ std::shared_ptr<fat32::dir_t> fat32::init_dir(const uint32_t & start_cl, const u
 }
 
 void fat32::store_superblock() noexcept {
-    m_disk->seek(m_superblock.superblock_addr);
-    m_disk->write((void*)&m_superblock, sizeof(m_superblock), 1);
+    m_disk->write_at((void*)&m_superblock, sizeof(m_superblock), 1, m_superblock.superblock_addr);
 }
 
-void fat32::store_fat_table() noexcept {
-    m_disk->seek(m_superblock.fat_table_addr);
-    m_disk->write(m_fat_table.get(), sizeof(uint32_t), (uint32_t)CLUSTER_AMT);
+void fat32::store_features() noexcept {
+    m_disk->write_at((void*)&m_features, sizeof(features_t), 1, FEATURES_START_ADDR);
 }
 
-void fat32::store_dir(std::shared_ptr<dir_t>& directory)  noexcept {
+void fat32::store_fat_table() noexcept {
+    // only changed pages are written, each under its lock.
+    for (uint32_t i = 0; i < FAT_PAGE_AMT; i++) {
+        std::lock_guard<std::mutex> lock(m_fat_pages[i].lock);
 
-    if (CLUSTER_SIZE < sizeof(directory->dir_header) || CLUSTER_SIZE < sizeof(dir_entry_t)) {
-        BUFFER << (LOG_str(log::ERROR_, "Insufficient memory to store header data/dir entry for directory"));
-        return;
-    }
+        if (!m_fat_pages[i].dirty && !m_fat_pages[i].refs_dirty && !m_fat_pages[i].fps_dirty)
+            continue;
 
-    uint32_t first_clu_entry_amt = (CLUSTER_SIZE - sizeof(directory->dir_header)) / sizeof(dir_entry_t);
-    uint32_t remain_entries = (first_clu_entry_amt >= directory->dir_header.dir_entry_amt) ? 0 : (directory->dir_header.dir_entry_amt - (uint32_t)first_clu_entry_amt);
-    uint32_t amt_of_entry_per_clu = 0;
-    uint32_t entries_written = 0;
+        uint32_t first = i * FAT_PAGE_ENTRIES;
+        uint32_t amt = min_(FAT_PAGE_ENTRIES, (uint32_t)CLUSTER_AMT - first);
 
-    if (!n_free_clusters(1)) {
-        BUFFER << (LOG_str(log::ERROR_, "amount of clusters needed is not valid"));
-        return;
-    }
+        if (m_fat_pages[i].dirty)
+            m_disk->write_at(&m_fat_table[first], sizeof(uint32_t), amt, m_superblock.fat_table_addr + (sizeof(uint32_t) * first));
 
-    uint32_t first_clu_index = attain_clu();
+        if (m_fat_pages[i].refs_dirty)
+            m_disk->write_at(&m_refs[first], sizeof(uint32_t), amt, REFS_START_ADDR + (sizeof(uint32_t) * first));
 
-    directory->dir_header.start_cluster_index = first_clu_index;
-    directory->dir_entries[0].start_cluster_index = first_clu_index;
+        if (m_fat_pages[i].fps_dirty)
+            m_disk->write_at(&m_fps[first], sizeof(uint64_t), amt, FPS_START_ADDR + (sizeof(uint64_t) * first));
 
-    if (remain_entries > 0)
-        amt_of_entry_per_clu = CLUSTER_SIZE / sizeof(dir_entry_t);
+        m_fat_pages[i].dirty = false;
+        m_fat_pages[i].refs_dirty = false;
+        m_fat_pages[i].fps_dirty = false;
+    }
+}
 
-    m_disk->seek(m_superblock.root_dir_addr + (first_clu_index * CLUSTER_SIZE));
-    m_disk->write((void*)&directory->dir_header, sizeof(dir_header_t), 1);
+int8_t fat32::store_dir(std::shared_ptr<dir_t>& directory)  noexcept {
 
-    uint16_t num_of_clu_needed;
-    if (remain_entries < amt_of_entry_per_clu)
-        num_of_clu_needed = 1;
-    else num_of_clu_needed = (uint16_t)((double)remain_entries / (double)amt_of_entry_per_clu);
+    if (CLUSTER_SIZE < sizeof(directory->dir_header) || CLUSTER_SIZE < sizeof(dir_entry_t)) {
+        BUFFER << (LOG_str(log::ERROR_, "Insufficient memory to store header data/dir entry for directory"));
+        return -1;
+    }
 
-    for (int i = 0; i < min_(directory->dir_header.dir_entry_amt, first_clu_entry_amt); i++) {
-        size_t addr_offset = (ROOT_START_ADDR + (first_clu_index * CLUSTER_SIZE) + sizeof(dir_header_t));
+    std::vector<uint32_t> clus;
 
-        m_disk->seek(addr_offset + (i * sizeof(dir_entry_t)));
-        m_disk->write((void*)&directory->dir_entries[i], sizeof(dir_entry_t), 1);
-        entries_written += 1;
+    if (!attain_clus(dir_clu_n(*directory), clus)) {
+        BUFFER << (LOG_str(log::WARNING, "'" + std::string(directory->dir_header.dir_name) + "' directory cannot be stored within: '" + std::string(DISK_NAME) + "'"));
+        return -1;
     }
 
-    if (remain_entries == 0) {
-        m_fat_table[first_clu_index] = EOF_CLUSTER;
-        store_fat_table();
-        return;
-    }
+    directory->dir_header.start_cluster_index = clus[0];
+    directory->dir_entries[0].start_cluster_index = clus[0];
 
-    if (remain_entries > amt_of_entry_per_clu) {
-        if (remain_entries % amt_of_entry_per_clu > 0)
-            num_of_clu_needed++;
-    }
+    write_dir(directory, clus);
+    publish_dir(directory);
+    store_fat_table();
+    return 0;
+}
+
+// rewritten in place, the first cluster never moves.
+void fat32::save_dir(std::shared_ptr<dir_t>& directory) noexcept {
+    uint32_t start_clu = directory->dir_header.start_cluster_index;
+    std::vector<uint32_t> clus = std::move(*get_list_of_clu(start_clu));
+    std::vector<uint32_t> spare;
+    uint32_t need = dir_clu_n(*directory);
 
-    if (!n_free_clusters(num_of_clu_needed)) {
+    if (need > clus.size() && !attain_clus(need - clus.size(), clus)) {
         BUFFER << (LOG_str(log::WARNING, "remaining entries cannot be stored due to insufficient cluster amount"));
-        BUFFER << (LOG_str(log::WARNING, "'" + std::string(directory->dir_header.dir_name) + "' directory cannot be stored within: '" + std::string(DISK_NAME) + "'"));
-        m_fat_table[first_clu_index] = UNALLOCATED_CLUSTER;
-        m_free_clusters->insert(first_clu_index);
         return;
     }
 
-    auto clu_list = std::unique_ptr<uint32_t[]>(new uint32_t[num_of_clu_needed]);
-    memset(clu_list.get(), 0, num_of_clu_needed);
+    if (need < clus.size()) {
+        spare.assign(clus.begin() + need, clus.end());
+        clus.resize(need);
+    }
 
-    for (int i = 0; i < num_of_clu_needed; i++)
-        clu_list[i] = attain_clu();
+    // readers use the cached copy, only a miss reads these under the lock.
+    invalidate_chain(start_clu);
+    write_dir(directory, clus);
+    release_clus(spare);
+    publish_dir(directory);
+    store_fat_table();
+}
 
-    for (int i = 0; i < num_of_clu_needed - 1; i++) {
-        size_t addr_offset = (ROOT_START_ADDR + (clu_list[i] * CLUSTER_SIZE));
+void fat32::write_dir(std::shared_ptr<dir_t>& directory, const std::vector<uint32_t>& clus) noexcept {
+    uint32_t first_clu_entry_amt = (CLUSTER_SIZE - sizeof(dir_header_t)) / sizeof(dir_entry_t);
+    uint32_t amt_of_entry_per_clu = CLUSTER_SIZE / sizeof(dir_entry_t);
+    uint32_t entries_written = 0;
+    std::vector<std::byte> clu(CLUSTER_SIZE);
 
-        m_disk->seek(addr_offset);
-        m_disk->write((void*)&directory->dir_entries[entries_written], sizeof(dir_entry_t), amt_of_entry_per_clu);
-        remain_entries -= amt_of_entry_per_clu;
-        entries_written += amt_of_entry_per_clu;
-    }
+    // one write per cluster.
+    for (size_t i = 0; i < clus.size(); i++) {
+        size_t used = 0;
+        uint32_t amt = min_((i == 0) ? first_clu_entry_amt : amt_of_entry_per_clu, directory->dir_header.dir_entry_amt - entries_written);
 
-    m_disk->seek(ROOT_START_ADDR + (CLUSTER_SIZE * clu_list[num_of_clu_needed - 1]));
-    m_disk->write((void*)&directory->dir_entries[entries_written], sizeof(dir_entry_t), remain_entries);
-    fflush(((disk*)m_disk.get())->get_file());
+        if (i == 0) {
+            memcpy(clu.data(), &directory->dir_header, sizeof(dir_header_t));
+            used = sizeof(dir_header_t);
+        }
 
-    m_fat_table[first_clu_index] = clu_list[0];
-    for (int i = 0; i < num_of_clu_needed; i++)
-        m_fat_table[clu_list[i]] = clu_list[i + 1];
-    m_fat_table[clu_list[num_of_clu_needed - 1]] = EOF_CLUSTER;
+        memcpy(clu.data() + used, &directory->dir_entries[entries_written], sizeof(dir_entry_t) * amt);
+        used += sizeof(dir_entry_t) * amt;
 
-    store_fat_table();
+        m_disk->write_at(clu.data(), sizeof(std::byte), used, ROOT_START_ADDR + ((uint64_t)CLUSTER_SIZE * clus[i]));
+        fat_set(clus[i], (i + 1 < clus.size()) ? clus[i + 1] : EOF_CLUSTER);
+        entries_written += amt;
+    }
 }
 
-void fat32::save_dir(std::shared_ptr<dir_t>& directory) noexcept {
-    std::unique_ptr<std::vector<uint32_t>> alloc_clu = get_list_of_clu(directory->dir_header.start_cluster_index);
-
-    for (int i = 0; i < alloc_clu->size(); i++) {
-        m_fat_table[(*alloc_clu)[i]] = UNALLOCATED_CLUSTER;
-        m_free_clusters->insert((*alloc_clu)[i]);
-    }
+uint32_t fat32::dir_clu_n(const dir_t& directory) noexcept {
+    uint32_t first_clu_entry_amt = (CLUSTER_SIZE - sizeof(dir_header_t)) / sizeof(dir_entry_t);
+    uint32_t amt_of_entry_per_clu = CLUSTER_SIZE / sizeof(dir_entry_t);
 
-    store_dir(directory);
+    if (directory.dir_header.dir_entry_amt <= first_clu_entry_amt)
+        return 1;
+    return 1 + (directory.dir_header.dir_entry_amt - first_clu_entry_amt + amt_of_entry_per_clu - 1) / amt_of_entry_per_clu;
 }
 
 void fat32::load() noexcept {
@@ -230,8 +331,8 @@ void fat32::load() noexcept {
     load_superblock();
     define_fat_table();
     load_fat_table();
-    m_root = read_dir(0);
-    m_curr_dir = m_root;
+    load_tables();
+    m_root = read_dir(ROOT_CLUSTER);
     BUFFER << (LOG_str(log::INFO, "disk '" + std::string(DISK_NAME) + "' has been loaded"));
     print_super_block();
     #if _DEBUG_
@@ -247,29 +348,84 @@ void fat32::load_superblock() noexcept {
 void fat32::load_fat_table() noexcept {
     m_disk->seek(m_superblock.fat_table_addr);
     m_disk->read(m_fat_table.get(), sizeof(uint32_t), CLUSTER_AMT);
+    fill_free_map();
+}
+
+// older disks end before the newer tables, they're grown and the missing part reads as zero.
+void fat32::load_tables() noexcept {
+    struct stat st = {};
+
+    if (::fstat(fileno(((disk*)m_disk.get())->get_file()), &st) == -1)
+        return;
+
+    if ((uint64_t)st.st_size < STORAGE_SIZE)
+        m_disk->truncate(STORAGE_SIZE);
+
+    m_disk->read_at(m_refs.get(), sizeof(uint32_t), CLUSTER_AMT, REFS_START_ADDR);
+    m_disk->read_at((void*)&m_features, sizeof(features_t), 1, FEATURES_START_ADDR);
+
+    for (uint32_t i = 0; i < CLUSTER_AMT; i++) {
+        if (m_refs[i] > 0)
+            m_shared_n++;
+        m_refs_n += m_refs[i];
+    }
+
+    if (!dedup())
+        return;
+
+    m_fps = std::unique_ptr<uint64_t[]>(new uint64_t[CLUSTER_AMT]());
+    m_disk->read_at(m_fps.get(), sizeof(uint64_t), CLUSTER_AMT, FPS_START_ADDR);
+
+    // the index is only in memory, it's rebuilt from the stored fingerprints.
+    for (uint32_t i = 0; i < CLUSTER_AMT; i++) {
+        if (m_fps[i] == 0)
+            continue;
 
-    for(int i = m_superblock.data.cluster_n - 1; i >= 0; i--) {
-        if(m_fat_table[i] == UNALLOCATED_CLUSTER)
-            m_free_clusters->insert(i);
+        if (m_fat_table[i] == UNALLOCATED_CLUSTER || !m_index.emplace(m_fps[i], i).second)
+            m_fps[i] = 0;
+    }
+    m_index_n = m_index.size();
+}
+
+void fat32::fill_free_map() noexcept {
+    for(uint32_t i = 0; i < CLUSTER_AMT; i++) {
+        if(m_fat_table[i] == UNALLOCATED_CLUSTER) {
+            m_free_map[i / 64] |= (uint64_t)1 << (i % 64);
+            m_free_n++;
+        }
     }
 }
 
 uint32_t fat32::insert_dir(std::shared_ptr<dir_t>& curr_dir, const char* dir_name) noexcept {
     std::shared_ptr<dir_t> tmp;
-    uint32_t ret;
 
     tmp = init_dir(UNDEF_START_CLUSTER, curr_dir->dir_header.start_cluster_index, dir_name);
-    store_dir(tmp);
+    if (store_dir(tmp) == -1)
+        return UNDEF_START_CLUSTER;
 
-    add_new_entry(curr_dir, dir_name, tmp->dir_header.start_cluster_index, sizeof(dir_entry_t), 0x1);
-    save_dir(curr_dir);
-
-    ret = tmp->dir_header.start_cluster_index;
-    return ret;
+    if (link_entry(curr_dir, dir_name, tmp->dir_header.start_cluster_index, sizeof(dir_entry_t), DIRECTORY) == -1) {
+        free_clu_chain(tmp->dir_header.start_cluster_index);
+        return UNDEF_START_CLUSTER;
+    }
+    return tmp->dir_header.start_cluster_index;
 }
 
 std::shared_ptr<fat32::dir_t> fat32::read_dir(const uint32_t & start_clu) noexcept {
-    if (m_fat_table[start_clu] == UNALLOCATED_CLUSTER) {
+    // served from the cache, each caller gets its own copy to change.
+    {
+        std::unique_lock<std::mutex> cache(m_dir_cache_lock);
+        auto it = m_dirs.find(start_clu);
+
+        if (it != m_dirs.end()) {
+            std::shared_ptr<const dir_t> ver = it->second;
+            cache.unlock();
+            return copy_dir(*ver);
+        }
+    }
+
+    dir_lock lock(*this, {start_clu}, false);
+
+    if (fat_get(start_clu) == UNALLOCATED_CLUSTER) {
         BUFFER << (LOG_str(log::WARNING, "specified cluster has not been allocated"));
         return nullptr;
     }
@@ -279,8 +435,13 @@ std::shared_ptr<fat32::dir_t> fat32::read_dir(const uint32_t & start_clu) noexce
     uint32_t dir_start_addr = ROOT_START_ADDR + (CLUSTER_SIZE * start_clu);
 
     //attain dir_header
-    m_disk->seek(dir_start_addr);
-    m_disk->read((void*)&ret->dir_header, sizeof(dir_header_t), 1);
+    m_disk->read_at((void*)&ret->dir_header, sizeof(dir_header_t), 1, dir_start_addr);
+
+    // a cluster that was handed on to a file since, its bytes aren't a header.
+    if (ret->dir_header.start_cluster_index != start_clu) {
+        BUFFER << (LOG_str(log::WARNING, "specified cluster does not hold a directory"));
+        return nullptr;
+    }
 
     uint32_t first_clu_entry_amt = (CLUSTER_SIZE - sizeof(ret->dir_header)) / sizeof(dir_entry_t);
     uint32_t remain_entries = (first_clu_entry_amt >= ret->dir_header.dir_entry_amt) ? 0 : (ret->dir_header.dir_entry_amt - (uint32_t)first_clu_entry_amt);
@@ -289,144 +450,439 @@ std::shared_ptr<fat32::dir_t> fat32::read_dir(const uint32_t & start_clu) noexce
     //allocate memory to ret(dir_t) entries due to dir header data.
     ret->dir_entries = std::shared_ptr<dir_entry_t[]>(new dir_entry_t[ret->dir_header.dir_entry_amt]);
 
-    for (int i = 0; i < min_(first_clu_entry_amt, ret->dir_header.dir_entry_amt); i++) {
-        size_t addr_offset = dir_start_addr + sizeof(dir_header_t);
-
-        m_disk->seek(addr_offset + (i * sizeof(dir_entry_t)));
-        m_disk->read((void*)&ret->dir_entries[i], sizeof(dir_entry_t), 1);
-        entries_read += 1;
-    }
+    // the entries in the header's cluster follow it, read in one go.
+    entries_read = min_(first_clu_entry_amt, ret->dir_header.dir_entry_amt);
+    m_disk->read_at((void*)&ret->dir_entries[0], sizeof(dir_entry_t), entries_read, dir_start_addr + sizeof(dir_header_t));
 
 
-    uint32_t amt_of_entries_per_clu;
     if (remain_entries > 0) {
-        amt_of_entries_per_clu = CLUSTER_SIZE / sizeof(dir_entry_t);
-    } else return ret;
+        uint32_t amt_of_entries_per_clu = CLUSTER_SIZE / sizeof(dir_entry_t);
+        uint32_t amt_of_clu_used = (remain_entries + amt_of_entries_per_clu - 1) / amt_of_entries_per_clu;
+        std::shared_ptr<chain_t> chain = get_chain(start_clu);
 
-    uint32_t amt_of_clu_used = remain_entries / amt_of_entries_per_clu;
+        //clusters following the header are looked up through the chain index.
+        for (uint32_t i = 1; i <= amt_of_clu_used && i < chain->clu_n; i++) {
+            uint32_t amt = min_(amt_of_entries_per_clu, ret->dir_header.dir_entry_amt - entries_read);
 
-    if (remain_entries > amt_of_entries_per_clu) {
-        if (remain_entries % amt_of_entries_per_clu > 0)
-            amt_of_clu_used++;
+            m_disk->read_at((void*)&ret->dir_entries[entries_read], sizeof(dir_entry_t), amt, ROOT_START_ADDR + ((uint64_t)CLUSTER_SIZE * chain->clu_at(i)));
+            entries_read += amt;
+        }
     }
 
-    //move towards next clu
-    uint32_t curr_clu = start_clu;
-    curr_clu = m_fat_table[curr_clu];
+    // still under the stripe, nothing newer can have been written.
+    cache_dir(ret);
+    return ret;
+}
+
+std::shared_ptr<fat32::dir_t> fat32::copy_dir(const dir_t& directory) noexcept {
+    auto ret = std::make_shared<dir_t>();
+
+    ret->dir_header = directory.dir_header;
+    ret->dir_entries = std::shared_ptr<dir_entry_t[]>(new dir_entry_t[directory.dir_header.dir_entry_amt]);
+    memcpy(ret->dir_entries.get(), directory.dir_entries.get(), sizeof(dir_entry_t) * directory.dir_header.dir_entry_amt);
+    return ret;
+}
+
+void fat32::cache_dir(const std::shared_ptr<dir_t>& directory) noexcept {
+    uint32_t start_clu = directory->dir_header.start_cluster_index;
+    std::shared_ptr<const dir_t> ver = copy_dir(*directory);
+    std::lock_guard<std::mutex> lock(m_dir_cache_lock);
+
+    // a directory whose clusters were freed meanwhile isn't cached.
+    if (fat_get(start_clu) == UNALLOCATED_CLUSTER)
+        return;
 
-    for (int i = 0; i < amt_of_clu_used - 1; i++) {
-        size_t addr_offset = ROOT_START_ADDR + (CLUSTER_SIZE * curr_clu);
+    if (m_dirs.size() >= CFG_DIR_CACHE_SIZE)
+        m_dirs.clear();
 
-        m_disk->seek(addr_offset);
-        m_disk->read((void*)&ret->dir_entries[entries_read], sizeof(dir_entry_t), amt_of_entries_per_clu);
-        entries_read += amt_of_entries_per_clu;
-        curr_clu = m_fat_table[curr_clu];
+    m_dirs[start_clu] = std::move(ver);
+}
+
+// what the old version freed goes once the snapshots taken before this are done.
+void fat32::publish_dir(const std::shared_ptr<dir_t>& directory) noexcept {
+    std::vector<uint32_t> clus;
+    cache_dir(directory);
+
+    {
+        std::lock_guard<std::mutex> lock(m_epoch_lock);
+        m_epoch++;
+        collect_retired(clus);
     }
+    forget_dirs(clus);
+    release_clus(clus);
+}
 
-    uint32_t remain_entries_in_lst_clu = abs_(ret->dir_header.dir_entry_amt, entries_read);
+void fat32::forget_dir(const uint32_t& start_clu) noexcept {
+    std::lock_guard<std::mutex> lock(m_dir_cache_lock);
+    m_dirs.erase(start_clu);
+}
 
-    m_disk->seek(ROOT_START_ADDR + (CLUSTER_SIZE * curr_clu));
-    m_disk->read((void*)&ret->dir_entries[entries_read], sizeof(dir_entry_t), remain_entries_in_lst_clu);
-    fflush(((disk*)m_disk.get())->get_file());
+// a removed directory cached again while retired is dropped before its clusters are reused.
+void fat32::forget_dirs(const std::vector<uint32_t>& clus) noexcept {
+    if (clus.empty())
+        return;
 
-    return ret;
+    std::lock_guard<std::mutex> lock(m_dir_cache_lock);
+    for (size_t i = 0; i < clus.size() && !m_dirs.empty(); i++)
+        m_dirs.erase(clus[i]);
 }
 
 size_t fat32::read_file(std::shared_ptr<dir_t>& dir, const char* entry_name, std::shared_ptr<std::byte[]>& buffer) noexcept {
     fat32::dir_entry_t* entry_ptr = find_entry(dir, entry_name, 1);
     uint64_t entry_size = entry_ptr->dir_entry_size;
 
-    buffer = std::shared_ptr<std::byte[]>(new std::byte[entry_size]);
-    memset(buffer.get(), 0, entry_size);
+    buffer = std::shared_ptr<std::byte[]>(new std::byte[entry_size + 1]);
 
-    if (m_fat_table[entry_ptr->start_cluster_index] == UNALLOCATED_CLUSTER) {
+    if (fat_get(entry_ptr->start_cluster_index) == UNALLOCATED_CLUSTER) {
         BUFFER << (LOG_str(log::WARNING, "cluster specified has not been allocated, file could not be read"));
     }
 
-    uint64_t curr_clu = entry_ptr->start_cluster_index;
-    uint64_t data_read = 0;
+    read_entry(entry_ptr->start_cluster_index, entry_size, buffer.get());
+    buffer[entry_size] = std::byte{0};
 
-    while(m_fat_table[curr_clu] != EOF_CLUSTER) {
-        uint64_t addr_offset = ROOT_START_ADDR + (CLUSTER_SIZE * curr_clu);
+    return (size_t)entry_size;
+}
+
+// on a compressed disk the chunk map goes out with the packed chunks after it.
+int32_t fat32::store_file(std::shared_ptr<std::byte[]>& data, uint64_t data_size) noexcept {
+    if (compressed()) {
+        std::shared_ptr<std::byte[]> packed;
+        uint64_t packed_size = {};
 
-        m_disk->seek(addr_offset);
-        m_disk->read(buffer.get() + data_read, sizeof(char), CLUSTER_SIZE);
-        curr_clu = m_fat_table[curr_clu];
-        data_read += CLUSTER_SIZE;
+        pack(data.get(), data_size, packed, packed_size);
+        return store_data(packed, packed_size);
     }
+    return store_data(data, data_size);
+}
 
-    uint32_t remaining_data = abs_(entry_size, data_read);
+int32_t fat32::store_data(std::shared_ptr<std::byte[]>& data, uint64_t data_size) noexcept {
+    uint32_t amt_of_clu_needed = (data_size <= CLUSTER_SIZE) ? 1 : (data_size + CLUSTER_SIZE - 1) / CLUSTER_SIZE;
+    std::vector<uint32_t> clus;
+    std::vector<uint64_t> tails;
+    int32_t start_clu = -1;
 
-    m_disk->seek(ROOT_START_ADDR + (CLUSTER_SIZE * curr_clu));
-    m_disk->read(buffer.get() + data_read, sizeof(std::byte), remaining_data);
-    fflush(((disk*)m_disk.get())->get_file());
-    buffer[data_read + remaining_data] = std::byte{0};
+    if (dedup() && data_size > 0) {
+        fingerprint(data.get(), data_size, tails);
 
-    return (size_t)entry_size;
+        if (dedup_file(data, data_size, tails, start_clu))
+            return start_clu;
+    }
+
+    if (!attain_clus(amt_of_clu_needed, clus)) {
+        BUFFER << (LOG_str(log::WARNING, "amount of cluster needed isn't available to store file"));
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < amt_of_clu_needed; i++)
+        fat_set(clus[i], (i + 1 < amt_of_clu_needed) ? clus[i + 1] : EOF_CLUSTER);
+
+    // nothing points at the chain yet, no lock is needed.
+    write_range(*get_chain(clus[0]), 0, data_size, data.get());
+
+    if (!tails.empty())
+        index_clus(clus, tails);
+    return clus[0];
 }
 
-int32_t fat32::store_file(std::shared_ptr<std::byte[]>& data, uint64_t data_size) noexcept {
-    uint32_t sdata = data_size;
-    uint32_t first_cluster = 0;
-    size_t data_read = 0;
-    
-    uint32_t amt_of_clu_needed = 0;
+bool fat32::compressed() const noexcept {
+    return (m_features.flags & FEATURE_LZ) != 0;
+}
+
+// chunks are packed on their own, a read only unpacks the ones it needs.
+void fat32::pack(const std::byte* data, uint64_t data_size, std::shared_ptr<std::byte[]>& out, uint64_t& out_size) noexcept {
+    uint64_t chunk = m_features.chunk_size;
+    uint32_t chunk_n = (data_size + chunk - 1) / chunk;
+
+    // sized for the worst case, every chunk kept as it is.
+    out = std::shared_ptr<std::byte[]>(new std::byte[sizeof(chunk_t) * chunk_n + data_size]);
+    out_size = sizeof(chunk_t) * chunk_n;
+
+    for (uint32_t i = 0; i < chunk_n; i++) {
+        uint64_t first = (uint64_t)i * chunk;
+        uint64_t len = min_(chunk, data_size - first);
+        char* dst = (char*)out.get() + out_size;
+        size_t amt = lz::compress((const char*)data + first, len, dst, len - 1);
+
+        if (amt == 0) {
+            memcpy(dst, data + first, len);
+            amt = len;
+        }
+
+        chunk_t entry;
+        entry.off = out_size;
+        entry.len = amt;
+        memcpy(out.get() + sizeof(chunk_t) * i, &entry, sizeof(chunk_t));
+        out_size += amt;
+    }
 
-    if (sdata < CLUSTER_SIZE)
-        amt_of_clu_needed = 1;
-    else amt_of_clu_needed = sdata / CLUSTER_SIZE;
+    m_packed_in += data_size;
+    m_packed_out += out_size;
+}
+
+bool fat32::load_map(const chain_t& chain, const uint64_t& size, unpacked_t& file) noexcept {
+    uint64_t chunk = m_features.chunk_size;
+    uint32_t chunk_n = (size + chunk - 1) / chunk;
+    uint64_t map_size = sizeof(chunk_t) * chunk_n;
+
+    file.map.resize(chunk_n);
+    file.at = -1;
+
+    if (read_range(chain, 0, map_size, (std::byte*)file.map.data()) != map_size)
+        return false;
 
-     if (sdata > CLUSTER_SIZE) {
-        if (sdata % CLUSTER_SIZE > 0)
-            amt_of_clu_needed++;
+    // a map entry pointing past the chain isn't followed.
+    for (const chunk_t& entry : file.map) {
+        if (entry.len > chunk || entry.off + entry.len > (uint64_t)chain.clu_n * CLUSTER_SIZE)
+            return false;
     }
+    return true;
+}
+
+uint64_t fat32::read_packed(const chain_t& chain, unpacked_t& file, uint64_t size, uint64_t offset, uint64_t amt, std::byte* out) noexcept {
+    uint64_t chunk = m_features.chunk_size;
+    uint64_t data_read = 0;
+    std::vector<std::byte> in;
+
+    amt = (offset < size) ? min_(amt, size - offset) : 0;
+
+    while (data_read < amt) {
+        uint32_t i = (offset + data_read) / chunk;
+        uint64_t first = (uint64_t)i * chunk;
+        uint64_t len = min_(chunk, size - first);
+        uint64_t from = offset + data_read - first;
+        uint64_t n = min_(len - from, amt - data_read);
+        const chunk_t& entry = file.map[i];
+
+        // a chunk stored as is is read directly, a whole one is unpacked in place.
+        if (entry.len == len) {
+            if (read_range(chain, entry.off + from, n, out + data_read) != n)
+                break;
+        } else if (file.at != i) {
+            std::byte* dst = (n == len) ? out + data_read : nullptr;
+
+            if (dst == nullptr) {
+                file.data.resize(chunk);
+                dst = file.data.data();
+            }
 
-    if (amt_of_clu_needed == 1) {
-        first_cluster = attain_clu();
+            in.resize(entry.len);
+            if (read_range(chain, entry.off, entry.len, in.data()) != entry.len
+                || lz::decompress((const char*)in.data(), entry.len, (char*)dst, len) != (int64_t)len) {
+                BUFFER << (LOG_str(log::WARNING, "a chunk of the file could not be unpacked"));
+                break;
+            }
 
-        m_disk->seek(ROOT_START_ADDR + (CLUSTER_SIZE * first_cluster));
-        m_disk->write(data.get(), sizeof(char), sdata);
-        data_read += sdata;
+            if (dst == file.data.data()) {
+                file.at = i;
+                memcpy(out + data_read, file.data.data() + from, n);
+            }
+        } else
+            memcpy(out + data_read, file.data.data() + from, n);
 
-        m_fat_table[first_cluster] = EOF_CLUSTER;
-        return first_cluster;
+        data_read += n;
     }
+    return data_read;
+}
 
-    if (!n_free_clusters(amt_of_clu_needed)) {
-        BUFFER << (LOG_str(log::WARNING, "amount of cluster needed isn't available to store file"));
+// a whole file's bytes, unpacked on a compressed disk.
+uint64_t fat32::read_entry(const uint32_t& start_clu, uint64_t size, std::byte* out) noexcept {
+    std::shared_ptr<chain_t> chain = get_chain(start_clu);
+    unpacked_t file;
+
+    if (!compressed())
+        return read_range(*chain, 0, size, out);
+
+    if (!load_map(*chain, size, file)) {
+        BUFFER << (LOG_str(log::WARNING, "the file's chunk map could not be read"));
+        return 0;
+    }
+    return read_packed(*chain, file, size, 0, size, out);
+}
+
+// a writer works on an unpacked copy in its own chain, close packs it again.
+int8_t fat32::stage(handle_t& hdl) noexcept {
+    uint64_t chunk = m_features.chunk_size;
+    uint32_t clu_n = (hdl.size <= CLUSTER_SIZE) ? 1 : (hdl.size + CLUSTER_SIZE - 1) / CLUSTER_SIZE;
+    std::vector<uint32_t> clus;
+
+    if (!attain_clus(clu_n, clus)) {
+        BUFFER << (LOG_str(log::WARNING, "amount of cluster needed isn't available to unpack file"));
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < clu_n; i++)
+        fat_set(clus[i], (i + 1 < clu_n) ? clus[i + 1] : EOF_CLUSTER);
+
+    std::shared_ptr<chain_t> raw = get_chain(clus[0]);
+    std::vector<std::byte> data(min_(chunk, hdl.size));
+
+    for (uint64_t at = 0; at < hdl.size; at += chunk) {
+        uint64_t amt = min_(chunk, hdl.size - at);
+
+        if (read_packed(*hdl.chain, *hdl.packed, hdl.size, at, amt, data.data()) != amt) {
+            free_clu_chain(clus[0]);
+            return -1;
+        }
+        write_range(*raw, at, amt, data.data());
+    }
+
+    hdl.start_clu = clus[0];
+    hdl.chain = raw;
+    hdl.packed = nullptr;
+    hdl.replaced = 1;
+    return 0;
+}
+
+// packs the writer's chain, the one the entry points at goes when close moves off it.
+int8_t fat32::repack(handle_t& hdl) noexcept {
+    std::shared_ptr<std::byte[]> data(new std::byte[hdl.size]);
+    int32_t start_clu = -1;
+
+    if (read_range(*hdl.chain, 0, hdl.size, data.get()) == hdl.size)
+        start_clu = store_file(data, hdl.size);
+
+    if (hdl.replaced)
+        free_clu_chain(hdl.start_clu);
+
+    if (start_clu == -1) {
+        BUFFER << (LOG_str(log::WARNING, "file could not be stored, it's left as it was"));
         return -1;
     }
 
-    auto clu_list = std::unique_ptr<uint32_t[]>(new uint32_t[amt_of_clu_needed]);
-    memset(clu_list.get(), 0, amt_of_clu_needed);
+    hdl.start_clu = start_clu;
+    hdl.chain = get_chain(start_clu);
+    hdl.replaced = 1;
+    return 0;
+}
+
+bool fat32::dedup() const noexcept {
+    return (m_features.flags & FEATURE_DEDUP) != 0;
+}
+
+// each hash is seeded with the next cluster's, so it covers the rest of the file.
+void fat32::fingerprint(const std::byte* data, uint64_t data_size, std::vector<uint64_t>& tails) noexcept {
+    uint32_t clu_n = (data_size + CLUSTER_SIZE - 1) / CLUSTER_SIZE;
+    uint64_t last = data_size - (uint64_t)(clu_n - 1) * CLUSTER_SIZE;
+
+    tails.resize(clu_n);
+    tails[clu_n - 1] = xxh64::hash((const char*)data + (uint64_t)(clu_n - 1) * CLUSTER_SIZE, last, last);
+
+    for (uint32_t i = clu_n - 1; i-- > 0;)
+        tails[i] = xxh64::hash((const char*)data + (uint64_t)i * CLUSTER_SIZE, CLUSTER_SIZE, tails[i + 1]);
+}
+
+// only a tail can be shared, the longest match is linked to and the rest written ahead of it.
+bool fat32::dedup_file(std::shared_ptr<std::byte[]>& data, uint64_t data_size, const std::vector<uint64_t>& tails, int32_t& start_clu) noexcept {
+    uint32_t clu_n = tails.size();
+    uint32_t at = clu_n;
+    uint32_t match = {};
+    std::vector<uint32_t> shared;
+    std::vector<uint32_t> clus;
+
+    {
+        std::lock_guard<std::mutex> lock(m_index_lock);
+
+        for (uint32_t i = 0; i < clu_n && at == clu_n; i++) {
+            auto it = m_index.find(tails[i]);
+            uint64_t off = (uint64_t)i * CLUSTER_SIZE;
+
+            if (it == m_index.end())
+                continue;
+
+            shared.clear();
+            if (same_tail(it->second, clu_n - i, data.get() + off, data_size - off, shared)) {
+                at = i;
+                match = it->second;
+            }
+        }
+
+        if (at == clu_n)
+            return false;
+
+        // the clusters ahead of the tail come first, a share of it is never taken to be given back.
+        if (at > 0 && !attain_clus(at, clus)) {
+            BUFFER << (LOG_str(log::WARNING, "amount of cluster needed isn't available to store file"));
+            start_clu = -1;
+            return true;
+        }
+
+        // taken under the index lock, the tail can't be freed meanwhile.
+        ref_add(shared);
+    }
+
+    start_clu = match;
+    if (at == 0)
+        return true;
+
+    for (uint32_t i = 0; i < at; i++)
+        fat_set(clus[i], (i + 1 < at) ? clus[i + 1] : match);
+
+    write_range(*get_chain(clus[0]), 0, (uint64_t)at * CLUSTER_SIZE, data.get());
+    index_clus(clus, tails);
+
+    start_clu = clus[0];
+    return true;
+}
+
+// under the index lock. the hash is only a hint, the bytes on disk are compared.
+bool fat32::same_tail(const uint32_t& clu, const uint32_t& clu_n, const std::byte* data, uint64_t data_size, std::vector<uint32_t>& clus) noexcept {
+    invalidate_chain(clu);
+    std::shared_ptr<chain_t> chain = get_chain(clu);
+    invalidate_chain(clu);
+
+    if (chain->clu_n != clu_n)
+        return false;
+
+    std::vector<std::byte> buf(min_(data_size, (uint64_t)CLUSTER_SIZE * CFG_ALLOC_BATCH));
 
-    for (int i = 0; i < amt_of_clu_needed; i++) {
-        clu_list[i] = attain_clu();
+    for (uint64_t at = 0; at < data_size; at += buf.size()) {
+        uint64_t amt = min_((uint64_t)buf.size(), data_size - at);
+
+        if (read_range(*chain, at, amt, buf.data()) != amt || memcmp(buf.data(), data + at, amt) != 0)
+            return false;
+    }
+
+    for (uint32_t ext = 0; ext < chain->ext_start.size(); ext++) {
+        for (uint32_t i = 0; i < chain->ext_len(ext); i++)
+            clus.push_back(chain->ext_start[ext] + i);
     }
+    return true;
+}
 
-    first_cluster = clu_list[0];
+// tails already in the index aren't added again.
+void fat32::index_clus(const std::vector<uint32_t>& clus, const std::vector<uint64_t>& tails) noexcept {
+    std::lock_guard<std::mutex> lock(m_index_lock);
 
-    for (int i = 0; i < amt_of_clu_needed - 1; i++) {
-        size_t off_adr = ROOT_START_ADDR + (CLUSTER_SIZE * clu_list[i]);
+    for (size_t i = 0; i < clus.size() && i < tails.size(); i++) {
+        if (!m_index.emplace(tails[i], clus[i]).second)
+            continue;
 
-        m_disk->seek(off_adr);
-        m_disk->write(data.get() + data_read, CLUSTER_SIZE, 1);
+        fat_page_t& curr = m_fat_pages[clus[i] / FAT_PAGE_ENTRIES];
+        std::lock_guard<std::mutex> page(curr.lock);
 
-        data_read += CLUSTER_SIZE;
+        m_fps[clus[i]] = tails[i];
+        curr.fps_dirty = true;
     }
+    m_index_n = m_index.size();
+}
 
-    size_t remaining_data = abs_(sdata, data_read);
+// under the index lock.
+void fat32::unindex(const std::vector<uint32_t>& clus) noexcept {
+    for (uint32_t clu : clus) {
+        fat_page_t& curr = m_fat_pages[clu / FAT_PAGE_ENTRIES];
+        std::lock_guard<std::mutex> page(curr.lock);
 
-    m_disk->seek(ROOT_START_ADDR + (CLUSTER_SIZE * clu_list[amt_of_clu_needed - 1]));
-    m_disk->write(data.get() + data_read, remaining_data, 1);
-    fflush(((disk*)m_disk.get())->get_file());
+        if (m_fps[clu] == 0)
+            continue;
 
-    m_fat_table[first_cluster] = clu_list[0];
-    for (int i = 0; i < amt_of_clu_needed; i++)
-        m_fat_table[clu_list[i]] = clu_list[i + 1];
-    m_fat_table[clu_list[amt_of_clu_needed - 1]] = EOF_CLUSTER;
+        auto it = m_index.find(m_fps[clu]);
+        if (it != m_index.end() && it->second == clu)
+            m_index.erase(it);
 
-    return first_cluster;
+        m_fps[clu] = 0;
+        curr.fps_dirty = true;
+    }
+    m_index_n = m_index.size();
 }
 
 void fat32::insert_int_file(std::shared_ptr<dir_t>& dir, std::shared_ptr<std::byte[]>& buffer, const char* name, size_t size) noexcept {
@@ -439,8 +895,8 @@ void fat32::insert_int_file(std::shared_ptr<dir_t>& dir, std::shared_ptr<std::by
         return;
     }
 
-    add_new_entry(dir, name, start_clu, size, 0);
-    save_dir(dir);
+    if (link_entry(dir, name, start_clu, size, NON_DIRECTORY) == -1)
+        free_clu_chain(start_clu);
 }
 
 void fat32::insert_ext_file(std::shared_ptr<dir_t>& curr_dir, const char* path, const char* name) noexcept {
@@ -460,53 +916,89 @@ void fat32::insert_ext_file(std::shared_ptr<dir_t>& curr_dir, const char* path,
         return;
     }
 
-    add_new_entry(curr_dir, name, start_clu, size, 0);
-    save_dir(curr_dir);
+    if (link_entry(curr_dir, name, start_clu, size, NON_DIRECTORY) == -1)
+        free_clu_chain(start_clu);
+}
+
+// the data is on disk already, the directory is read again under the lock.
+int8_t fat32::link_entry(std::shared_ptr<dir_t>& dir, const char* name, const uint32_t& start_clu, const uint64_t& size, const uint8_t& is_dir) noexcept {
+    uint32_t dir_clu = dir->dir_header.start_cluster_index;
+    dir_lock lock(*this, {dir_clu}, true);
+
+    std::shared_ptr<dir_t> fresh = read_dir(dir_clu);
+
+    if (!fresh || find_entry(fresh, name, 0x0))
+        return -1;
+
+    add_new_entry(fresh, name, start_clu, size, is_dir);
+    save_dir(fresh);
+    dir = fresh;
+    return 0;
+}
+
+std::unique_ptr<fat32::dir_entr_ret_t> fat32::reread(const std::unique_ptr<dir_entr_ret_t>& entr, const char* name, uint8_t shd_exst) noexcept {
+    std::shared_ptr<dir_t> dir = read_dir(entr->m_dir->dir_header.start_cluster_index);
+
+    if (!dir)
+        return nullptr;
+
+    dir_entry_t* entry = find_entry(dir, name, shd_exst);
+
+    if ((!entry && shd_exst == 1) || (entry && shd_exst == 0))
+        return nullptr;
+
+    return std::make_unique<dir_entr_ret_t>(dir, entry);
 }
 
+// a directory and everything below it are retired as one batch.
 void fat32::delete_entry(std::unique_ptr<dir_entr_ret_t>& entry) noexcept {
+    std::vector<uint32_t> clus;
 
-    std::unique_ptr<std::vector<uint32_t>> entry_alloc_clu = get_list_of_clu(entry->m_entry->start_cluster_index);
+    if (entry->m_entry->is_directory) {
+        std::shared_ptr<dir_t> dir = read_dir(entry->m_entry->start_cluster_index);
 
-    for (int i = 0; i < entry_alloc_clu->size(); i++) {
-        m_fat_table[(*entry_alloc_clu)[i]] = UNALLOCATED_CLUSTER;
-        m_free_clusters->insert((*entry_alloc_clu)[i]);
+        if (dir)
+            delete_dir(dir, clus);
     }
 
+    collect_chain(entry->m_entry->start_cluster_index, clus);
+    retire_clus(std::move(clus));
     rm_entr_mem(entry->m_dir, entry->m_entry->dir_entry_name);
 }
 
-void fat32::delete_dir(std::shared_ptr<dir_t>& dir) noexcept {
-    for(int i = dir->dir_header.dir_entry_amt - 1; i >= 2; i--) { // i >= 2, as 0 = '.' and 1 = '..'
-        auto tmp = std::shared_ptr<fat32::dir_t>();
-        if(dir->dir_entries[i].is_directory) {
-            tmp = read_dir(dir->dir_entries[i].start_cluster_index);
-            delete_dir(tmp);
+// nothing below is written back, its clusters are only collected.
+void fat32::delete_dir(std::shared_ptr<dir_t>& dir, std::vector<uint32_t>& clus) noexcept {
+    for (uint32_t i = 2; i < dir->dir_header.dir_entry_amt; i++) { // i = 2, as 0 = '.' and 1 = '..'
+        if (dir->dir_entries[i].is_directory) {
+            std::shared_ptr<dir_t> tmp = read_dir(dir->dir_entries[i].start_cluster_index);
+
+            if (tmp)
+                delete_dir(tmp, clus);
         }
-        dir_entry_t* entry = &dir->dir_entries[i];
-        std::unique_ptr<dir_entr_ret_t> entr = std::make_unique<dir_entr_ret_t>(dir, entry);
-        delete_entry(entr);
+        collect_chain(dir->dir_entries[i].start_cluster_index, clus);
     }
 }
 
 std::unique_ptr<fat32::dir_entr_ret_t> fat32::parsePath(std::vector<std::string>&path, uint8_t shd_exst) noexcept {
     std::unique_ptr<fat32::dir_entr_ret_t> ret = std::unique_ptr<dir_entr_ret_t>(new dir_entr_ret_t(nullptr, nullptr));
 
-    auto curr_dir = m_curr_dir;
+    auto dir = curr_dir();
     fat32::dir_entry_t* tmp_entr;
 
     for (int i = 0; i < path.size() - 1; i++) {
-         tmp_entr = find_entry(curr_dir, path[i].c_str(), 0x1);
+         tmp_entr = find_entry(dir, path[i].c_str(), (shd_exst == ANY_ENTRY) ? ANY_ENTRY : 0x1);
 
-        if (tmp_entr == nullptr && shd_exst) {
+        if (tmp_entr == nullptr || !tmp_entr->is_directory) {
             return nullptr;
         }
 
         std::shared_ptr<dir_t> tmp = read_dir(tmp_entr->start_cluster_index);
-        curr_dir = tmp;
+        if (tmp == nullptr)
+            return nullptr;
+        dir = tmp;
     }
 
-    tmp_entr = find_entry(curr_dir, path[path.size() - 1].c_str(), shd_exst);
+    tmp_entr = find_entry(dir, path[path.size() - 1].c_str(), shd_exst);
 
     if (!tmp_entr && shd_exst == 1) {
         return nullptr;
@@ -516,64 +1008,550 @@ std::unique_ptr<fat32::dir_entr_ret_t> fat32::parsePath(std::vector<std::string>
         return nullptr;
     }
 
-    ret->m_dir = curr_dir;
+    ret->m_dir = dir;
     ret->m_entry = tmp_entr;
     return ret;
 }
 
-uint32_t fat32::attain_clu() const noexcept {
-    uint32_t rs = *m_free_clusters->begin();
-    m_fat_table[rs] = ALLOCATED_CLUSTER;
-    m_free_clusters->erase(m_free_clusters->begin());
-    return rs;
-}
+bool fat32::attain_clus(const uint32_t& amt, std::vector<uint32_t>& clus) noexcept {
+    uint32_t free = m_free_n;
+
+    // reserved from the free count first, the map and magazines then hold enough.
+    do {
+        if (free < amt)
+            return false;
+    } while (!m_free_n.compare_exchange_weak(free, free - amt));
+
+    size_t first = clus.size();
+    size_t target = first + amt;
+    size_t slot = mag_slot();
+
+    // a batch or more comes straight off the map.
+    if (amt >= CFG_ALLOC_BATCH)
+        claim_free(m_mags[slot].cursor, amt, clus);
+
+    for (size_t i = 0; clus.size() < target; i++) {
+        magazine_t& mag = m_mags[(slot + i) % CFG_ALLOC_MAGAZINES];
+        std::lock_guard<std::mutex> lock(mag.lock);
+        uint32_t want = target - clus.size();
+
+        // only the thread's own magazine is refilled.
+        if (i % CFG_ALLOC_MAGAZINES == 0 && mag.clus.size() < want) {
+            std::vector<uint32_t> batch;
+            claim_free(mag.cursor, want - mag.clus.size() + CFG_ALLOC_BATCH, batch);
+            mag.clus.insert(mag.clus.end(), batch.rbegin(), batch.rend());
+        }
+
+        while (!mag.clus.empty() && clus.size() < target) {
+            clus.push_back(mag.clus.back());
+            mag.clus.pop_back();
+        }
+    }
 
-uint32_t fat32::n_free_clusters(const uint32_t& req) const noexcept {
-    return m_free_clusters->size() >= req ? 1 : 0;
+    fat_fill(clus, first, ALLOCATED_CLUSTER);
+    return true;
 }
 
-std::unique_ptr<std::vector<uint32_t>> fat32::get_list_of_clu(const uint32_t & start_clu) noexcept {
-    std::unique_ptr<std::vector<uint32_t>> alloc_clu = std::unique_ptr<std::vector<uint32_t>>(new std::vector<uint32_t>());
+void fat32::release_clus(const std::vector<uint32_t>& clus) noexcept {
+    std::vector<uint32_t> unowned;
+    std::vector<uint32_t> single;
 
-    uint32_t curr_clu = start_clu;
-    alloc_clu->push_back(curr_clu);
+    // a cluster down to one owner may be written in place, it leaves the index.
+    if (dedup()) {
+        {
+            std::lock_guard<std::mutex> lock(m_index_lock);
 
-    while (1) {
-        uint32_t next_clu = m_fat_table[curr_clu];
-        if (next_clu == EOF_CLUSTER)
-            break;
-        alloc_clu->push_back(next_clu);
-        curr_clu = next_clu;
+            drop_refs(clus, unowned, single);
+            unindex(unowned);
+            unindex(single);
+        }
+        free_clus(unowned);
+        return;
     }
-    return std::move(alloc_clu);
+
+    // a cluster another chain still holds only loses an owner.
+    if (m_shared_n > 0) {
+        drop_refs(clus, unowned, single);
+        free_clus(unowned);
+    } else
+        free_clus(clus);
 }
 
-void fat32::rm_entr_mem(std::shared_ptr<dir_t>& dir, const char* name) noexcept {
+void fat32::free_clus(const std::vector<uint32_t>& clus) noexcept {
+    size_t keep = 0;
 
-    std::shared_ptr<dir_entry_t[]> tmp = std::shared_ptr<dir_entry_t[]>(new dir_entry_t[dir->dir_header.dir_entry_amt - 1]);
+    // marked free in the fat before anyone can take them again.
+    fat_fill(clus, 0, UNALLOCATED_CLUSTER);
 
-    for (int i = 0; i < dir->dir_header.dir_entry_amt; i++) {
-        if (strcmp(dir->dir_entries[i].dir_entry_name, name) == 0) {
-            for (int j = i; j < dir->dir_header.dir_entry_amt - 1; j++) {
-                tmp[j] = dir->dir_entries[j + 1];
-            }
-            break;
-        }
-        tmp[i] = dir->dir_entries[i];
+    // the thread's magazine takes back what fits, its next write reuses them.
+    {
+        magazine_t& mag = m_mags[mag_slot()];
+        std::lock_guard<std::mutex> lock(mag.lock);
+
+        if (mag.clus.size() < CFG_ALLOC_BATCH * 2)
+            keep = min_(clus.size(), CFG_ALLOC_BATCH * 2 - mag.clus.size());
+        mag.clus.insert(mag.clus.end(), std::make_reverse_iterator(clus.begin() + keep), clus.rend());
     }
 
-    dir->dir_entries = tmp;
-    dir->dir_header.dir_entry_amt--;
+    return_free(clus, keep);
+    m_free_n += clus.size();
 }
 
-void fat32::add_new_entry(std::shared_ptr<dir_t>& curr_dir, const char* name, const uint32_t& start_clu, const uint64_t& size, const uint8_t& is_dir) noexcept {
+// takes the lowest free bits of a word with one compare and swap.
+uint32_t fat32::claim_free(std::atomic<uint32_t>& cursor, const uint32_t& amt, std::vector<uint32_t>& clus) noexcept {
+    uint32_t start = cursor.load(std::memory_order_relaxed);
+    uint32_t got = 0;
 
-    curr_dir->dir_header.dir_entry_amt += 1;
-    std::shared_ptr<dir_entry_t[]> tmp_entries = curr_dir->dir_entries;
-    curr_dir->dir_entries = std::shared_ptr<dir_entry_t[]>(new dir_entry_t[curr_dir->dir_header.dir_entry_amt]);
+    for (uint32_t n = 0; n < FREE_MAP_WORDS && got < amt; n++) {
+        uint32_t w = (start + n) % FREE_MAP_WORDS;
+        uint64_t bits = m_free_map[w].load(std::memory_order_relaxed);
 
-    for (int i = 0; i < curr_dir->dir_header.dir_entry_amt - 1; i++)
-        curr_dir->dir_entries[i] = tmp_entries[i];
+        while (bits && got < amt) {
+            uint64_t take = bits;
+
+            if ((uint32_t)__builtin_popcountll(bits) > amt - got) {
+                take = 0;
+                for (uint64_t rest = bits, k = amt - got; k > 0; k--, rest &= rest - 1)
+                    take |= rest & (~rest + 1);
+            }
+
+            if (!m_free_map[w].compare_exchange_weak(bits, bits & ~take, std::memory_order_acquire, std::memory_order_relaxed))
+                continue;
+
+            for (; take; take &= take - 1, got++)
+                clus.push_back(w * 64 + __builtin_ctzll(take));
+            bits = m_free_map[w].load(std::memory_order_relaxed);
+            cursor.store(w, std::memory_order_relaxed);
+        }
+    }
+    return got;
+}
+
+void fat32::return_free(const std::vector<uint32_t>& clus, const size_t& first) noexcept {
+    // one atomic or per word, neighbouring clusters mostly share one.
+    for (size_t i = first; i < clus.size();) {
+        uint32_t w = clus[i] / 64;
+        uint64_t bits = 0;
+
+        for (; i < clus.size() && clus[i] / 64 == w; i++)
+            bits |= (uint64_t)1 << (clus[i] % 64);
+        m_free_map[w].fetch_or(bits, std::memory_order_release);
+    }
+}
+
+size_t fat32::mag_slot() noexcept {
+    return std::hash<std::thread::id>{}(std::this_thread::get_id()) % CFG_ALLOC_MAGAZINES;
+}
+
+// still linked in the fat until released, a reader holding the chain can walk it.
+void fat32::retire_clus(std::vector<uint32_t>&& clus) noexcept {
+    std::lock_guard<std::mutex> lock(m_epoch_lock);
+    m_retired.push_back({m_epoch, std::move(clus)});
+}
+
+void fat32::collect_retired(std::vector<uint32_t>& clus) noexcept {
+    uint64_t oldest = m_readers.empty() ? m_epoch : min_(m_readers.begin()->first, m_epoch);
+
+    while (!m_retired.empty() && m_retired.front().epoch < oldest) {
+        clus.insert(clus.end(), m_retired.front().clus.begin(), m_retired.front().clus.end());
+        m_retired.pop_front();
+    }
+}
+
+uint64_t fat32::pin() noexcept {
+    std::lock_guard<std::mutex> lock(m_epoch_lock);
+    m_readers[m_epoch]++;
+    return m_epoch;
+}
+
+void fat32::unpin(const uint64_t& epoch) noexcept {
+    std::vector<uint32_t> clus;
+    {
+        std::lock_guard<std::mutex> lock(m_epoch_lock);
+        auto it = m_readers.find(epoch);
+
+        if (--it->second == 0)
+            m_readers.erase(it);
+        collect_retired(clus);
+    }
+
+    if (clus.empty())
+        return;
+
+    forget_dirs(clus);
+    release_clus(clus);
+    store_fat_table();
+}
+
+uint32_t fat32::fat_get(const uint32_t& clu) noexcept {
+    std::lock_guard<std::mutex> lock(m_fat_pages[clu / FAT_PAGE_ENTRIES].lock);
+    return m_fat_table[clu];
+}
+
+void fat32::fat_set(const uint32_t& clu, const uint32_t& val) noexcept {
+    fat_page_t& page = m_fat_pages[clu / FAT_PAGE_ENTRIES];
+    std::lock_guard<std::mutex> lock(page.lock);
+
+    m_fat_table[clu] = val;
+    page.dirty = true;
+}
+
+void fat32::fat_fill(const std::vector<uint32_t>& clus, const size_t& first, const uint32_t& val) noexcept {
+    std::unique_lock<std::mutex> page;
+
+    // a page is locked once for the run of clusters that fall in it.
+    for (size_t i = first; i < clus.size(); i++) {
+        fat_page_t& curr = m_fat_pages[clus[i] / FAT_PAGE_ENTRIES];
+
+        if (page.mutex() != &curr.lock) {
+            if (page)
+                page.unlock();
+            page = std::unique_lock<std::mutex>(curr.lock);
+        }
+
+        m_fat_table[clus[i]] = val;
+        curr.dirty = true;
+    }
+}
+
+uint32_t fat32::ref_get(const uint32_t& clu) noexcept {
+    std::lock_guard<std::mutex> lock(m_fat_pages[clu / FAT_PAGE_ENTRIES].lock);
+    return m_refs[clu];
+}
+
+void fat32::ref_add(const std::vector<uint32_t>& clus) noexcept {
+    std::unique_lock<std::mutex> page;
+
+    for (uint32_t clu : clus) {
+        fat_page_t& curr = m_fat_pages[clu / FAT_PAGE_ENTRIES];
+
+        if (page.mutex() != &curr.lock) {
+            if (page)
+                page.unlock();
+            page = std::unique_lock<std::mutex>(curr.lock);
+        }
+
+        if (m_refs[clu]++ == 0)
+            m_shared_n++;
+        m_refs_n++;
+        curr.refs_dirty = true;
+    }
+}
+
+// taken in order, a cluster that comes up twice loses an owner and then goes.
+void fat32::drop_refs(const std::vector<uint32_t>& clus, std::vector<uint32_t>& unowned, std::vector<uint32_t>& single) noexcept {
+    std::unique_lock<std::mutex> page;
+
+    for (uint32_t clu : clus) {
+        fat_page_t& curr = m_fat_pages[clu / FAT_PAGE_ENTRIES];
+
+        if (page.mutex() != &curr.lock) {
+            if (page)
+                page.unlock();
+            page = std::unique_lock<std::mutex>(curr.lock);
+        }
+
+        if (m_refs[clu] == 0) {
+            unowned.push_back(clu);
+            continue;
+        }
+
+        if (--m_refs[clu] == 0) {
+            m_shared_n--;
+            single.push_back(clu);
+        }
+        m_refs_n--;
+        curr.refs_dirty = true;
+    }
+}
+
+std::unique_ptr<std::vector<uint32_t>> fat32::get_list_of_clu(const uint32_t & start_clu) noexcept {
+    std::unique_ptr<std::vector<uint32_t>> alloc_clu = std::unique_ptr<std::vector<uint32_t>>(new std::vector<uint32_t>());
+    std::shared_ptr<chain_t> chain = get_chain(start_clu);
+
+    alloc_clu->reserve(chain->clu_n);
+    for (uint32_t ext = 0; ext < chain->ext_start.size(); ext++) {
+        for (uint32_t i = 0; i < chain->ext_len(ext); i++)
+            alloc_clu->push_back(chain->ext_start[ext] + i);
+    }
+    return alloc_clu;
+}
+
+std::shared_ptr<fat32::chain_t> fat32::get_chain(const uint32_t& start_clu) noexcept {
+    std::lock_guard<std::mutex> lock(m_chain_lock);
+    auto it = m_chains.find(start_clu);
+    if (it != m_chains.end())
+        return it->second;
+
+    auto chain = std::make_shared<chain_t>();
+    uint32_t curr_clu = start_clu;
+    std::unique_lock<std::mutex> page;
+
+    // walk the fat table once, merging consecutive clusters into extents.
+    while (1) {
+        if (!page || page.mutex() != &m_fat_pages[curr_clu / FAT_PAGE_ENTRIES].lock) {
+            if (page)
+                page.unlock();
+            page = std::unique_lock<std::mutex>(m_fat_pages[curr_clu / FAT_PAGE_ENTRIES].lock);
+        }
+
+        if (chain->ext_start.empty() || curr_clu != chain->ext_start.back() + (chain->clu_n - chain->ext_off.back())) {
+            chain->ext_start.push_back(curr_clu);
+            chain->ext_off.push_back(chain->clu_n);
+        }
+        chain->clu_n++;
+
+        uint32_t next_clu = m_fat_table[curr_clu];
+        if (next_clu == EOF_CLUSTER || chain->clu_n >= CLUSTER_AMT)
+            break;
+        curr_clu = next_clu;
+    }
+    page.unlock();
+
+    if (m_chains.size() >= CFG_CHAIN_CACHE_SIZE)
+        m_chains.clear();
+
+    m_chains[start_clu] = chain;
+    return chain;
+}
+
+void fat32::invalidate_chain(const uint32_t& start_clu) noexcept {
+    std::lock_guard<std::mutex> lock(m_chain_lock);
+    m_chains.erase(start_clu);
+}
+
+void fat32::free_clu_chain(const uint32_t& start_clu) noexcept {
+    std::vector<uint32_t> clus;
+
+    collect_chain(start_clu, clus);
+    retire_clus(std::move(clus));
+}
+
+void fat32::collect_chain(const uint32_t& start_clu, std::vector<uint32_t>& clus) noexcept {
+    std::shared_ptr<chain_t> chain = get_chain(start_clu);
+
+    clus.reserve(clus.size() + chain->clu_n);
+    for (uint32_t ext = 0; ext < chain->ext_start.size(); ext++) {
+        for (uint32_t i = 0; i < chain->ext_len(ext); i++)
+            clus.push_back(chain->ext_start[ext] + i);
+    }
+
+    // dropped from the caches before the clusters are reused.
+    invalidate_chain(start_clu);
+    forget_dir(start_clu);
+}
+
+// the new entry shares the chain until one of them is written.
+void fat32::share_chain(const uint32_t& start_clu) noexcept {
+    ref_add(*get_list_of_clu(start_clu));
+}
+
+// copies the shared run up to the last cluster written, reading only what it won't cover.
+int8_t fat32::unshare(handle_t& hdl, const uint64_t& first, const uint64_t& last) noexcept {
+    // another handle may have relinked the chain since.
+    if (hdl.cow_gen != m_cow_gen) {
+        hdl.cow_gen = m_cow_gen;
+        hdl.chain = get_chain(hdl.start_clu);
+    }
+
+    // the handle's own clusters leave the index before they change.
+    if (dedup() && !hdl.unindexed) {
+        std::vector<uint32_t> own;
+        std::lock_guard<std::mutex> lock(m_index_lock);
+
+        for (uint32_t i = 0; i < hdl.chain->clu_n && ref_get(hdl.chain->clu_at(i)) == 0; i++)
+            own.push_back(hdl.chain->clu_at(i));
+
+        unindex(own);
+        hdl.unindexed = 1;
+    }
+
+    // a handle still on the chain it holds copies it regardless, the entry may have moved off it.
+    bool held = !hdl.replaced && !hdl.held.empty();
+
+    if ((m_shared_n == 0 && !held) || last <= first)
+        return 0;
+
+    // growing relinks the last cluster, it has to be owned too.
+    uint32_t clu_n = hdl.chain->clu_n;
+    uint32_t end = (last > (uint64_t)clu_n * CLUSTER_SIZE) ? clu_n - 1 : (uint32_t)((last - 1) / CLUSTER_SIZE);
+
+    if (!held && ref_get(hdl.chain->clu_at(end)) == 0)
+        return 0;
+
+    std::lock_guard<std::mutex> lock(m_cow_lock);
+    const chain_t& chain = *hdl.chain;
+    uint32_t lo = 0, hi = held ? 0 : end;
+
+    // counts only rise along the chain, the first shared cluster is bisected for.
+    while (lo < hi) {
+        uint32_t mid = (lo + hi) / 2;
+
+        if (ref_get(chain.clu_at(mid)) > 0)
+            hi = mid;
+        else lo = mid + 1;
+    }
+
+    std::vector<uint32_t> clus;
+    std::vector<uint32_t> old;
+
+    if (!attain_clus(end - lo + 1, clus)) {
+        BUFFER << (LOG_str(log::WARNING, "amount of cluster needed isn't available to write to a copied file"));
+        return -1;
+    }
+
+    for (uint32_t i = lo; i <= end; i++) {
+        old.push_back(chain.clu_at(i));
+        fat_set(clus[i - lo], (i < end) ? clus[i - lo + 1] : (end + 1 < clu_n) ? chain.clu_at(end + 1) : EOF_CLUSTER);
+    }
+
+    std::shared_ptr<chain_t> copy = get_chain(clus[0]);
+    uint64_t run_first = (uint64_t)lo * CLUSTER_SIZE;
+    uint64_t run_last = (uint64_t)(end + 1) * CLUSTER_SIZE;
+    std::pair<uint64_t, uint64_t> parts[] = {{run_first, min_(first, run_last)}, {std::max(last, run_first), run_last}};
+    std::vector<std::byte> data(min_(run_last - run_first, (uint64_t)CLUSTER_SIZE * CFG_ALLOC_BATCH));
+
+    for (auto& [from, to] : parts) {
+        for (uint64_t at = from; at < to; at += data.size()) {
+            uint64_t amt = min_((uint64_t)data.size(), to - at);
+
+            read_range(chain, at, amt, data.data());
+            write_range(*copy, at - run_first, amt, data.data());
+        }
+    }
+
+    if (lo == 0) {
+        // the entry keeps the old start until close, the new chain takes its own share of the rest.
+        std::vector<uint32_t> rest;
+
+        for (uint32_t i = end + 1; i < clu_n; i++)
+            rest.push_back(chain.clu_at(i));
+        ref_add(rest);
+
+        hdl.start_clu = clus[0];
+        hdl.replaced = 1;
+    } else {
+        // the owned cluster before the run is relinked to the copy.
+        fat_set(chain.clu_at(lo - 1), clus[0]);
+        invalidate_chain(clus[0]);
+        invalidate_chain(hdl.start_clu);
+        m_cow_gen++;
+        retire_clus(std::move(old));
+    }
+
+    hdl.cow_gen = m_cow_gen;
+    hdl.chain = get_chain(hdl.start_clu);
+    return 0;
+}
+
+uint64_t fat32::read_range(const uint32_t& start_clu, uint64_t offset, uint64_t size, std::byte* out) noexcept {
+    return read_range(*get_chain(start_clu), offset, size, out);
+}
+
+uint64_t fat32::read_range(const chain_t& chain, uint64_t offset, uint64_t size, std::byte* out) noexcept {
+    uint32_t n = offset / CLUSTER_SIZE;
+    uint64_t clu_off = offset % CLUSTER_SIZE;
+    uint64_t data_read = 0;
+
+    if (n >= chain.clu_n)
+        return 0;
+
+    // each extent is contiguous on disk, so it is read with a single seek.
+    for (uint32_t ext = chain.ext_at(n); ext < chain.ext_start.size() && data_read < size; ext++) {
+        uint64_t first_clu = chain.ext_start[ext] + (n - chain.ext_off[ext]);
+        uint64_t run = ((uint64_t)(chain.ext_off[ext] + chain.ext_len(ext) - n) * CLUSTER_SIZE) - clu_off;
+        uint64_t amt = min_(run, size - data_read);
+
+        m_disk->read_at(out + data_read, sizeof(std::byte), amt, ROOT_START_ADDR + (CLUSTER_SIZE * first_clu) + clu_off);
+
+        data_read += amt;
+        n = chain.ext_off[ext] + chain.ext_len(ext);
+        clu_off = 0;
+    }
+    return data_read;
+}
+
+uint64_t fat32::write_range(const chain_t& chain, uint64_t offset, uint64_t size, const std::byte* in) noexcept {
+    uint32_t n = offset / CLUSTER_SIZE;
+    uint64_t clu_off = offset % CLUSTER_SIZE;
+    uint64_t data_written = 0;
+
+    if (n >= chain.clu_n)
+        return 0;
+
+    for (uint32_t ext = chain.ext_at(n); ext < chain.ext_start.size() && data_written < size; ext++) {
+        uint64_t first_clu = chain.ext_start[ext] + (n - chain.ext_off[ext]);
+        uint64_t run = ((uint64_t)(chain.ext_off[ext] + chain.ext_len(ext) - n) * CLUSTER_SIZE) - clu_off;
+        uint64_t amt = min_(run, size - data_written);
+
+        m_disk->write_at(in + data_written, sizeof(std::byte), amt, ROOT_START_ADDR + (CLUSTER_SIZE * first_clu) + clu_off);
+
+        data_written += amt;
+        n = chain.ext_off[ext] + chain.ext_len(ext);
+        clu_off = 0;
+    }
+    return data_written;
+}
+
+int8_t fat32::grow_chain(handle_t& hdl, const uint64_t& size) noexcept {
+    uint32_t clu_needed = (size + CLUSTER_SIZE - 1) / CLUSTER_SIZE;
+
+    if (clu_needed <= hdl.chain->clu_n)
+        return 0;
+
+    std::vector<uint32_t> clus;
+
+    if (!attain_clus(clu_needed - hdl.chain->clu_n, clus)) {
+        BUFFER << (LOG_str(log::WARNING, "amount of cluster needed isn't available to extend file"));
+        return -1;
+    }
+
+    uint32_t last_clu = hdl.chain->clu_at(hdl.chain->clu_n - 1);
+    for (uint32_t clu : clus) {
+        fat_set(last_clu, clu);
+        last_clu = clu;
+    }
+    fat_set(last_clu, EOF_CLUSTER);
+
+    invalidate_chain(hdl.start_clu);
+    hdl.chain = get_chain(hdl.start_clu);
+    return 0;
+}
+
+uint32_t fat32::chain_t::ext_at(const uint32_t& n) const noexcept {
+    return (uint32_t)(std::upper_bound(ext_off.begin(), ext_off.end(), n) - ext_off.begin()) - 1;
+}
+
+uint32_t fat32::chain_t::ext_len(const uint32_t& ext) const noexcept {
+    return ((ext + 1 < ext_off.size()) ? ext_off[ext + 1] : clu_n) - ext_off[ext];
+}
+
+uint32_t fat32::chain_t::clu_at(const uint32_t& n) const noexcept {
+    uint32_t ext = ext_at(n);
+    return ext_start[ext] + (n - ext_off[ext]);
+}
+
+// shifted down in place, the entries are the caller's own copy.
+void fat32::rm_entr_mem(std::shared_ptr<dir_t>& dir, const char* name) noexcept {
+    dir_entry_t* entries = dir->dir_entries.get();
+    dir_entry_t* end = entries + dir->dir_header.dir_entry_amt;
+    dir_entry_t* it = std::find_if(entries, end, [name](const dir_entry_t& entry) { return strcmp(entry.dir_entry_name, name) == 0; });
+
+    if (it == end)
+        return;
+
+    std::copy(it + 1, end, it);
+    dir->dir_header.dir_entry_amt--;
+}
+
+void fat32::add_new_entry(std::shared_ptr<dir_t>& curr_dir, const char* name, const uint32_t& start_clu, const uint64_t& size, const uint8_t& is_dir) noexcept {
+
+    curr_dir->dir_header.dir_entry_amt += 1;
+    std::shared_ptr<dir_entry_t[]> tmp_entries = curr_dir->dir_entries;
+    curr_dir->dir_entries = std::shared_ptr<dir_entry_t[]>(new dir_entry_t[curr_dir->dir_header.dir_entry_amt]);
+
+    for (int i = 0; i < curr_dir->dir_header.dir_entry_amt - 1; i++)
+        curr_dir->dir_entries[i] = tmp_entries[i];
 
     strcpy(curr_dir->dir_entries[curr_dir->dir_header.dir_entry_amt - 1].dir_entry_name, name);
     curr_dir->dir_entries[curr_dir->dir_header.dir_entry_amt - 1].start_cluster_index = start_clu;
@@ -581,81 +1559,200 @@ void fat32::add_new_entry(std::shared_ptr<dir_t>& curr_dir, const char* name, co
     curr_dir->dir_entries[curr_dir->dir_header.dir_entry_amt - 1].dir_entry_size = size;
 }
 
+// spread over the pool, each new directory is saved once by its last part.
 void fat32::cp_dir(std::shared_ptr<dir_t>& src, std::shared_ptr<dir_t>& dst) noexcept {
-    for(int i = src->dir_header.dir_entry_amt - 1; i >= 2; i--) { // i >= 2, as 0 = '.' and 1 = '..'
-        std::shared_ptr<dir_t> tmp = nullptr;
-        if(src->dir_entries[i].is_directory) {
-            tmp = read_dir(src->dir_entries[i].start_cluster_index);
-            uint32_t cp_clu = insert_dir(dst, tmp->dir_header.dir_name);
-            std::shared_ptr<dir_t> dir_cp = read_dir(cp_clu);
-
-            cp_dir(tmp, dir_cp);
-            continue;
+    cp_tree_t tree;
+
+    std::call_once(m_pool_once, [this] { m_pool = std::make_unique<pool>(CFG_CP_WORKERS); });
+    tree.out = buffer::get_buffer();
+
+    cp_dir_job(src, dst, tree);
+    m_pool->wait(tree.grp);
+}
+
+void fat32::cp_dir_job(const std::shared_ptr<dir_t>& src, const std::shared_ptr<dir_t>& dst, cp_tree_t& tree) noexcept {
+    auto job = std::make_shared<cp_job_t>();
+    uint32_t amt = src->dir_header.dir_entry_amt - 2; // 0 = '.' and 1 = '..'
+
+    if (amt == 0)
+        return;
+
+    job->src = src;
+    job->dst = dst;
+    job->entries.resize(amt);
+    job->left = (amt + CFG_CP_BATCH - 1) / CFG_CP_BATCH;
+
+    for (uint32_t first = 0; first < amt; first += CFG_CP_BATCH) {
+        uint32_t last = min_(first + CFG_CP_BATCH, amt);
+        m_pool->submit(tree.grp, [this, job, first, last, &tree] { cp_dir_part(job, first, last, tree); });
+    }
+}
+
+void fat32::cp_dir_part(const std::shared_ptr<cp_job_t>& job, uint32_t first, uint32_t last, cp_tree_t& tree) noexcept {
+    buffer out;
+    {
+        buffer::scope scope(out);
+        uint32_t dst_clu = job->dst->dir_header.start_cluster_index;
+
+        for (uint32_t i = first; i < last; i++) {
+            dir_entry_t& entry = job->entries[i];
+            entry = job->src->dir_entries[i + 2];
+            entry.start_cluster_index = UNDEF_START_CLUSTER;
+
+            if (job->src->dir_entries[i + 2].is_directory) {
+                std::shared_ptr<dir_t> sub = read_dir(job->src->dir_entries[i + 2].start_cluster_index);
+
+                if (!sub)
+                    continue;
+
+                std::shared_ptr<dir_t> copy = init_dir(UNDEF_START_CLUSTER, dst_clu, entry.dir_entry_name);
+                if (store_dir(copy) == -1)
+                    continue;
+
+                // what goes in it is copied by parts of its own.
+                entry.start_cluster_index = copy->dir_header.start_cluster_index;
+                cp_dir_job(sub, copy, tree);
+                continue;
+            }
+
+            // a file shares the source's clusters, nothing is read or written for it.
+            share_chain(job->src->dir_entries[i + 2].start_cluster_index);
+            entry.start_cluster_index = job->src->dir_entries[i + 2].start_cluster_index;
+        }
+
+        if (--job->left == 0) {
+            std::shared_ptr<dir_t>& dst = job->dst;
+            std::vector<dir_entry_t> entries(dst->dir_entries.get(), dst->dir_entries.get() + 2);
+            dir_lock lock(*this, {dst_clu}, true);
+
+            for (const dir_entry_t& entry : job->entries) {
+                if (entry.start_cluster_index != UNDEF_START_CLUSTER)
+                    entries.push_back(entry);
+            }
+
+            dst->dir_entries = std::shared_ptr<dir_entry_t[]>(new dir_entry_t[entries.size()]);
+            std::copy(entries.begin(), entries.end(), dst->dir_entries.get());
+            dst->dir_header.dir_entry_amt = (uint32_t)entries.size();
+            save_dir(dst);
         }
-        std::shared_ptr<std::byte[]> buffer = nullptr;
-        size_t size = read_file(src, src->dir_entries[i].dir_entry_name, buffer);
-        insert_int_file(dst, buffer, src->dir_entries[i].dir_entry_name, size);
+    }
+
+    if (out.size()) {
+        std::lock_guard<std::mutex> lock(tree.lock);
+        tree.out->append(out.data(), out.size());
     }
 }
 
 void fat32::mv(std::vector<std::string>& tokens) noexcept {
-    std::vector<std::string> parts = lib_::split(tokens[0].c_str(), '/');
-    std::unique_ptr<dir_entr_ret_t> src = parsePath(parts, 0x1);
-
-    parts = lib_::split(tokens[1].c_str(), '/');
-    std::unique_ptr<dir_entr_ret_t> dst = parsePath(parts, 0x0);
+    std::vector<std::string> src_parts = lib_::split(tokens[0].c_str(), '/');
+    std::vector<std::string> parts = lib_::split(tokens[1].c_str(), '/');
     const char* entr_name = parts[parts.size() - 1].c_str();
+    bool whole = false;
 
-    if(!src || !dst) {
-        BUFFER << (LOG_str(log::WARNING, "Either src or dst specified is invalid"));
-        return;
-    }
+    // a directory's '..' changes too, moving one takes the whole tree.
+    while (1) {
+        tree_lock tree(*this, whole);
+        std::unique_ptr<dir_entr_ret_t> src = parsePath(src_parts, 0x1);
+        std::unique_ptr<dir_entr_ret_t> dst = parsePath(parts, 0x0);
 
-    if(src->m_entry->is_directory) {
-        add_new_entry(dst->m_dir, entr_name, src->m_entry->start_cluster_index, src->m_entry->dir_entry_size, DIRECTORY);
+        if(!src || !dst) {
+            BUFFER << (LOG_str(log::WARNING, "Either src or dst specified is invalid"));
+            return;
+        }
 
-        std::shared_ptr<dir_t> mv_dir = read_dir(dst->m_dir->dir_entries[dst->m_dir->dir_header.dir_entry_amt - 1].start_cluster_index);
-        mv_dir->dir_entries[1].start_cluster_index = dst->m_dir->dir_header.start_cluster_index;
-        save_dir(mv_dir);
-    } else
-        add_new_entry(dst->m_dir, entr_name, src->m_entry->start_cluster_index, src->m_entry->dir_entry_size, NON_DIRECTORY);
+        uint32_t src_clu = src->m_dir->dir_header.start_cluster_index;
+        uint32_t dst_clu = dst->m_dir->dir_header.start_cluster_index;
+        dir_lock lock(*this, {src_clu, dst_clu}, true);
 
-    rm_entr_mem(src->m_dir, src->m_entry->dir_entry_name);
+        if(!(src = reread(src, src_parts[src_parts.size() - 1].c_str(), 0x1)) || !(dst = reread(dst, entr_name, 0x0))) {
+            BUFFER << (LOG_str(log::WARNING, "Either src or dst specified is invalid"));
+            return;
+        }
 
-    save_dir(src->m_dir);
-    save_dir(dst->m_dir);
-}
+        if(src->m_entry->is_directory && !whole) {
+            whole = true;
+            continue;
+        }
 
-void fat32::cp(const char* src, const char* dst) noexcept {
-    std::vector<std::string> parts = lib_::split(src, '/');
-    std::unique_ptr<dir_entr_ret_t> dsrc = parsePath(parts, 0x1);
+        // within one directory both changes go to the one copy of it.
+        dir_entry_t moved = *src->m_entry;
+        if(src_clu == dst_clu)
+            dst->m_dir = src->m_dir;
 
-    parts = lib_::split(dst, '/');
-    std::unique_ptr<dir_entr_ret_t> ddst = parsePath(parts, 0x0);
-    const char* entr_name = parts[parts.size() - 1].c_str();
+        if(moved.is_directory) {
+            add_new_entry(dst->m_dir, entr_name, moved.start_cluster_index, moved.dir_entry_size, DIRECTORY);
+
+            std::shared_ptr<dir_t> mv_dir = read_dir(moved.start_cluster_index);
+            mv_dir->dir_entries[1].start_cluster_index = dst_clu;
+            save_dir(mv_dir);
+        } else
+            add_new_entry(dst->m_dir, entr_name, moved.start_cluster_index, moved.dir_entry_size, NON_DIRECTORY);
 
-    if(!dsrc || !ddst) {
-        BUFFER << (LOG_str(log::WARNING, "Either src or dst specified is invalid"));
+        rm_entr_mem(src->m_dir, moved.dir_entry_name);
+
+        if(src_clu != dst_clu)
+            save_dir(src->m_dir);
+        save_dir(dst->m_dir);
         return;
     }
+}
 
-    if(dsrc->m_entry->is_directory) {
-        std::shared_ptr<dir_t> src_dir = read_dir(dsrc->m_entry->start_cluster_index);
-        uint32_t dir_clu = insert_dir(ddst->m_dir, entr_name);
-        std::shared_ptr<dir_t> dst_dir = read_dir(dir_clu);
+void fat32::cp(const char* src, const char* dst) noexcept {
+    std::vector<std::string> src_parts = lib_::split(src, '/');
+    std::vector<std::string> parts = lib_::split(dst, '/');
+    const char* entr_name = parts[parts.size() - 1].c_str();
+    bool whole = false;
 
-        cp_dir(src_dir, dst_dir);
-    } else {
-        std::shared_ptr<std::byte[]> buffer;
-        size_t size = read_file(dsrc->m_dir, dsrc->m_entry->dir_entry_name, buffer);
-        insert_int_file(ddst->m_dir, buffer, entr_name, size);
-    }
+    // copying a directory takes the whole tree.
+    while (1) {
+        tree_lock tree(*this, whole);
+        std::unique_ptr<dir_entr_ret_t> dsrc = parsePath(src_parts, 0x1);
+        std::unique_ptr<dir_entr_ret_t> ddst = parsePath(parts, 0x0);
+
+        if(!dsrc || !ddst) {
+            BUFFER << (LOG_str(log::WARNING, "Either src or dst specified is invalid"));
+            return;
+        }
+
+        if(dsrc->m_entry->is_directory && !whole) {
+            whole = true;
+            continue;
+        }
+
+        if(dsrc->m_entry->is_directory) {
+            std::shared_ptr<dir_t> src_dir = read_dir(dsrc->m_entry->start_cluster_index);
+            uint32_t dir_clu = insert_dir(ddst->m_dir, entr_name);
 
-    save_dir(ddst->m_dir);
+            if(!src_dir || dir_clu == UNDEF_START_CLUSTER)
+                return;
+
+            std::shared_ptr<dir_t> dst_dir = read_dir(dir_clu);
+            cp_dir(src_dir, dst_dir);
+            return;
+        }
+
+        // the snapshot keeps the source's clusters until the copy has its share.
+        uint32_t start_clu = {};
+        uint64_t size = {};
+        {
+            snapshot snap(*this);
+
+            if(!(dsrc = reread(dsrc, src_parts[src_parts.size() - 1].c_str(), 0x1)))
+                return;
+            start_clu = dsrc->m_entry->start_cluster_index;
+            size = dsrc->m_entry->dir_entry_size;
+            share_chain(start_clu);
+        }
+
+        if (link_entry(ddst->m_dir, entr_name, start_clu, size, NON_DIRECTORY) == -1)
+            free_clu_chain(start_clu);
+        return;
+    }
 }
 
 void fat32::cp_imp(const char* src, const char* dst) noexcept {
     std::vector<std::string> parts = lib_::split(dst, '/');
+    tree_lock tree(*this, false);
 
     std::unique_ptr<dir_entr_ret_t> ddst = parsePath(parts, 0x0);
     const char* entr_name = parts[parts.size() - 1].c_str();
@@ -670,21 +1767,25 @@ void fat32::cp_imp(const char* src, const char* dst) noexcept {
 
 void fat32::cp_exp(const char* src, const char* dst) noexcept {
     std::vector<std::string> parts = lib_::split(src, '/');
-
-    std::unique_ptr<dir_entr_ret_t> ssrc = parsePath(parts, 0x1);
-    const char* entr_name = parts[parts.size() - 1].c_str();
-
-    if(!ssrc) {
-        BUFFER << (LOG_str(log::WARNING, "src specified is invalid"));
-        return;
-    }
     std::shared_ptr<std::byte[]> buffer;
-    size_t size = read_file(ssrc->m_dir, parts[parts.size() - 1].c_str(), buffer);
+    size_t size = {};
+    {
+        // taken before the path is read, the file found stays intact.
+        snapshot snap(*this);
+        std::unique_ptr<dir_entr_ret_t> ssrc = parsePath(parts, 0x1);
+
+        if(!ssrc) {
+            BUFFER << (LOG_str(log::WARNING, "src specified is invalid"));
+            return;
+        }
+        size = read_file(ssrc->m_dir, parts[parts.size() - 1].c_str(), buffer);
+    }
     store_ext_file_buffer(dst, buffer, size);
 }
 
 void fat32::mkdir(const char* dir) noexcept {
     std::vector<std::string> tokens = lib_::split(dir, '/');
+    tree_lock tree(*this, false);
     std::unique_ptr<fat32::dir_entr_ret_t> ret = parsePath(tokens, 0x0);
 
     if (!ret) {
@@ -696,6 +1797,7 @@ void fat32::mkdir(const char* dir) noexcept {
 
 void fat32::cd(const char* pth) noexcept {
     std::vector<std::string> tokens = lib_::split(pth, '/');
+    tree_lock tree(*this, false);
     std::unique_ptr<fat32::dir_entr_ret_t> ret = parsePath(tokens, 0x1);
 
     if (!ret) {
@@ -707,32 +1809,45 @@ void fat32::cd(const char* pth) noexcept {
         BUFFER << (LOG_str(log::WARNING, "entry '" + std::string(ret->m_entry->dir_entry_name) + "' is not a directory"));
         return;
     }
-    m_curr_dir = read_dir(ret->m_entry->start_cluster_index);
+
+    (m_cwd ? m_cwd : &m_home)->clu = ret->m_entry->start_cluster_index;
 }
 
 void fat32::rm(std::vector<std::string>&tokens) noexcept {
     for (int i = 0; i < tokens.size(); i++) {
         std::vector<std::string> parts = lib_::split(tokens[i].c_str(), '/');
-        std::unique_ptr<dir_entr_ret_t> entry = parsePath(parts, 0x1);
+        bool whole = false;
 
-        if (entry == nullptr) {
-            BUFFER << (LOG_str(log::WARNING, "Path is not valid, either directory/file's specified are non-existant"));
-            return;
-        }
+        // removing a directory takes the whole tree.
+        while (1) {
+            tree_lock tree(*this, whole);
+            std::unique_ptr<dir_entr_ret_t> entry = parsePath(parts, 0x1);
+
+            if (entry == nullptr) {
+                BUFFER << (LOG_str(log::WARNING, "Path is not valid, either directory/file's specified are non-existant"));
+                return;
+            }
+
+            dir_lock lock(*this, {entry->m_dir->dir_header.start_cluster_index}, true);
+
+            if ((entry = reread(entry, parts[parts.size() - 1].c_str(), 0x1)) == nullptr)
+                return;
+
+            if (entry->m_entry->is_directory && !whole) {
+                whole = true;
+                continue;
+            }
 
-        if(!entry->m_entry->is_directory) {
-            delete_entry(entry);
-        } else {
-            std::shared_ptr<dir_t> tmp = read_dir(entry->m_entry->start_cluster_index);
-            delete_dir(tmp);
             delete_entry(entry);
+            save_dir(entry->m_dir);
+            break;
         }
-        save_dir(entry->m_dir);
     }
 }
 
 void fat32::touch(std::vector<std::string>& parts, char* payload, uint64_t size) noexcept {
     std::vector<std::string> tokens = lib_::split(parts[0].c_str(), '/');
+    tree_lock tree(*this, false);
     std::unique_ptr<dir_entr_ret_t> entr = parsePath(tokens, 0x0);
     const char* init_file_name = tokens[tokens.size() - 1].c_str();
 
@@ -759,30 +1874,383 @@ void fat32::touch(std::vector<std::string>& parts, char* payload, uint64_t size)
 
 void fat32::cat(const char* path, int8_t export_) noexcept {
     std::vector<std::string> tokens = lib_::split(path, '/');
-    std::unique_ptr<dir_entr_ret_t> entr = parsePath(tokens, 0x1);
+
+    // no locks, the snapshot keeps the file as it was.
+    snapshot snap(*this);
+    std::unique_ptr<dir_entr_ret_t> entr = tokens.empty() ? nullptr : parsePath(tokens, 0x1);
 
     if(!entr) {
         BUFFER << (LOG_str(log::WARNING, "Path specified is invalid"));
         return;
     }
-    std::shared_ptr<std::byte[]> buffer;
-    size_t size = read_file(entr->m_dir, tokens[tokens.size() - 1].c_str(), buffer);
-    std::unique_ptr<char[]> data = std::unique_ptr<char[]>(new char[size]);
-    memcpy(data.get(), buffer.get(), size);
 
     std::string file_name = tokens[tokens.size() - 1];
 
-    if(export_ == 0) {
-        BUFFER << "\nFile: " << file_name.c_str() << "\nSize: " << size << "b\n------------\n";
-        BUFFER.append(data.get(), size);
-        BUFFER << "\n";
-    } else {
-        BUFFER.append(data.get(), size);
+    if(entr->m_entry->is_directory) {
+        BUFFER << (LOG_str(log::WARNING, "entry '" + file_name + "' is a directory"));
+        return;
+    }
+
+    uint64_t size = entr->m_entry->dir_entry_size;
+    size_t mark = BUFFER.size();
+
+    if(export_ == 0)
+        BUFFER << "\nFile: " << file_name << "\nSize: " << size << "b\n------------\n";
+
+    // file data is read straight into the output arena, a short read leaves none of it there.
+    if(read_entry(entr->m_entry->start_cluster_index, size, (std::byte*)BUFFER.grow(size)) != size) {
+        BUFFER.truncate(mark);
+        BUFFER << (LOG_str(log::WARNING, "file '" + file_name + "' could not be read whole"));
+        return;
     }
+
+    if(export_ == 0)
+        BUFFER << "\n";
 }
 
 void fat32::ls() noexcept {
-    print_dir(*m_curr_dir);
+    snapshot snap(*this);
+    std::shared_ptr<dir_t> dir = curr_dir();
+    print_dir(*dir);
+}
+
+std::shared_ptr<fat32::dir_t> fat32::curr_dir() noexcept {
+    cwd_t* cwd = m_cwd ? m_cwd : &m_home;
+
+    // a directory that was removed since sends the session back to the root.
+    std::shared_ptr<dir_t> dir = (fat_get(cwd->clu) == UNALLOCATED_CLUSTER) ? nullptr : read_dir(cwd->clu);
+
+    if (dir == nullptr) {
+        cwd->clu = ROOT_CLUSTER;
+        dir = read_dir(ROOT_CLUSTER);
+    }
+    return dir;
+}
+
+std::shared_ptr<fat32::dir_t> fat32::resolve_dir(const char* path) noexcept {
+    std::vector<std::string> tokens = lib_::split(path, '/');
+
+    if (tokens.empty())
+        return curr_dir();
+
+    std::unique_ptr<dir_entr_ret_t> entr = parsePath(tokens, ANY_ENTRY);
+
+    if (!entr || !entr->m_entry || !entr->m_entry->is_directory)
+        return nullptr;
+
+    return read_dir(entr->m_entry->start_cluster_index);
+}
+
+int fat32::lookup(const char* path, stat_t& st) noexcept {
+    std::vector<std::string> tokens = lib_::split(path, '/');
+    snapshot snap(*this);
+
+    if (tokens.empty())
+        tokens.emplace_back(".");
+
+    std::unique_ptr<dir_entr_ret_t> entr = parsePath(tokens, ANY_ENTRY);
+
+    if (!entr || !entr->m_entry)
+        return -1;
+
+    memcpy(st.name, entr->m_entry->dir_entry_name, DIR_NAME_LENGTH);
+    st.size = entr->m_entry->dir_entry_size;
+    st.start_cluster = entr->m_entry->start_cluster_index;
+    st.is_directory = entr->m_entry->is_directory;
+    return 0;
+}
+
+int fat32::readdir(const char* path, std::vector<stat_t>& entries) noexcept {
+    snapshot snap(*this);
+    std::shared_ptr<dir_t> dir = resolve_dir(path);
+
+    if (!dir)
+        return -1;
+
+    entries.resize(dir->dir_header.dir_entry_amt);
+    for (uint32_t i = 0; i < dir->dir_header.dir_entry_amt; i++) {
+        memcpy(entries[i].name, dir->dir_entries[i].dir_entry_name, DIR_NAME_LENGTH);
+        entries[i].size = dir->dir_entries[i].dir_entry_size;
+        entries[i].start_cluster = dir->dir_entries[i].start_cluster_index;
+        entries[i].is_directory = dir->dir_entries[i].is_directory;
+    }
+    return 0;
+}
+
+std::shared_ptr<fat32::handle_t> fat32::get_handle(int fd) noexcept {
+    std::lock_guard<std::mutex> lock(m_handle_lock);
+
+    if (fd < 0 || fd >= m_handles.size() || !m_handles[fd]) {
+        BUFFER << (LOG_str(log::WARNING, "file handle is not open"));
+        return nullptr;
+    }
+    return m_handles[fd];
+}
+
+int fat32::open(const char* path, int flags) noexcept {
+    std::vector<std::string> tokens = lib_::split(path, '/');
+
+    if (tokens.empty())
+        return -1;
+
+    // the chain found can't be freed before the handle has its share, the share is all it keeps.
+    snapshot snap(*this);
+    tree_lock tree(*this, false);
+    std::unique_ptr<dir_entr_ret_t> entr = parsePath(tokens, (flags & O_CREAT) ? ANY_ENTRY : 0x1);
+
+    if (!entr) {
+        BUFFER << (LOG_str(log::WARNING, "Path specified is invalid"));
+        return -1;
+    }
+
+    auto hdl = std::make_shared<handle_t>();
+    strncpy(hdl->name, tokens[tokens.size() - 1].c_str(), DIR_NAME_LENGTH - 1);
+    hdl->parent_clu = entr->m_dir->dir_header.start_cluster_index;
+    hdl->flags = flags;
+
+    std::vector<uint32_t> clus;
+    bool created = false;
+
+    if (entr->m_entry == nullptr) {
+        if (!attain_clus(1, clus)) {
+            BUFFER << (LOG_str(log::WARNING, "file could not be stored"));
+            return -1;
+        }
+        fat_set(clus[0], EOF_CLUSTER);
+
+        // if someone else made the file meanwhile, theirs is opened.
+        if (link_entry(entr->m_dir, hdl->name, clus[0], 0, NON_DIRECTORY) == 0) {
+            hdl->start_clu = clus[0];
+            created = true;
+        } else {
+            release_clus(clus);
+            if (!(entr = reread(entr, hdl->name, 0x1)))
+                return -1;
+        }
+        clus.clear();
+    }
+
+    if (!created && entr->m_entry->is_directory) {
+        BUFFER << (LOG_str(log::WARNING, "entry '" + std::string(entr->m_entry->dir_entry_name) + "' is a directory"));
+        return -1;
+    }
+
+    if (!created) {
+        hdl->start_clu = entr->m_entry->start_cluster_index;
+        hdl->size = entr->m_entry->dir_entry_size;
+    }
+
+    hdl->chain = get_chain(hdl->start_clu);
+
+    // the entry keeps the old chain until close.
+    if ((flags & O_TRUNC) && hdl->size > 0) {
+        if (!attain_clus(1, clus)) {
+            BUFFER << (LOG_str(log::WARNING, "file could not be stored"));
+            return -1;
+        }
+        hdl->start_clu = clus[0];
+        fat_set(hdl->start_clu, EOF_CLUSTER);
+        hdl->chain = get_chain(hdl->start_clu);
+        hdl->size = 0;
+        hdl->dirty = 1;
+        hdl->replaced = 1;
+    }
+
+    // the chunk map is read once, chunks are unpacked as they're read.
+    if (compressed() && !hdl->replaced && hdl->size > 0) {
+        hdl->packed = std::make_unique<unpacked_t>();
+
+        if (!load_map(*hdl->chain, hdl->size, *hdl->packed)) {
+            BUFFER << (LOG_str(log::WARNING, "the file's chunk map could not be read"));
+            return -1;
+        }
+    }
+
+    // anyone else writing copies, and the chain outlives an rm or a replace until the handle lets go.
+    if (!hdl->replaced) {
+        std::lock_guard<std::mutex> lock(m_cow_lock);
+
+        hdl->chain = get_chain(hdl->start_clu);
+        hdl->held = *get_list_of_clu(hdl->start_clu);
+        ref_add(hdl->held);
+    }
+
+    if (flags & O_APPEND)
+        hdl->pos = hdl->size;
+
+    std::lock_guard<std::mutex> lock(m_handle_lock);
+    for (int fd = 0; fd < m_handles.size(); fd++) {
+        if (!m_handles[fd]) {
+            m_handles[fd] = std::move(hdl);
+            return fd;
+        }
+    }
+    m_handles.push_back(std::move(hdl));
+    return (int)m_handles.size() - 1;
+}
+
+int64_t fat32::read(int fd, void* buf, uint64_t size) noexcept {
+    std::shared_ptr<handle_t> hdl = get_handle(fd);
+
+    if (!hdl || (hdl->flags & O_ACCMODE) == O_WRONLY)
+        return -1;
+
+    std::lock_guard<std::mutex> lock(hdl->lock);
+
+    if (hdl->pos >= hdl->size)
+        return 0;
+
+    uint64_t amt = hdl->packed ? read_packed(*hdl->chain, *hdl->packed, hdl->size, hdl->pos, size, (std::byte*)buf)
+                               : read_range(*hdl->chain, hdl->pos, min_(size, hdl->size - hdl->pos), (std::byte*)buf);
+    hdl->pos += amt;
+    return (int64_t)amt;
+}
+
+int64_t fat32::write(int fd, const void* buf, uint64_t size) noexcept {
+    std::shared_ptr<handle_t> hdl = get_handle(fd);
+
+    if (!hdl || (hdl->flags & O_ACCMODE) == O_RDONLY)
+        return -1;
+
+    std::lock_guard<std::mutex> lock(hdl->lock);
+
+    if (hdl->flags & O_APPEND)
+        hdl->pos = hdl->size;
+
+    if ((hdl->packed && stage(*hdl) == -1) || unshare(*hdl, min_(hdl->pos, hdl->size), hdl->pos + size) == -1 || grow_chain(*hdl, hdl->pos + size) == -1)
+        return -1;
+
+    // bytes between the old end of file and a seeked position are zero filled.
+    if (hdl->pos > hdl->size) {
+        std::vector<std::byte> zero(hdl->pos - hdl->size);
+        write_range(*hdl->chain, hdl->size, zero.size(), zero.data());
+    }
+
+    uint64_t amt = write_range(*hdl->chain, hdl->pos, size, (const std::byte*)buf);
+    hdl->pos += amt;
+    hdl->size = std::max(hdl->size, hdl->pos);
+    hdl->dirty = 1;
+    return (int64_t)amt;
+}
+
+int64_t fat32::pwrite(int fd, const void* buf, uint64_t size, uint64_t offset) noexcept {
+    std::shared_ptr<handle_t> hdl = get_handle(fd);
+    std::shared_ptr<chain_t> chain;
+
+    if (!hdl || (hdl->flags & O_ACCMODE) == O_RDONLY)
+        return -1;
+
+    // only growing the chain holds the handle, ranges are written side by side.
+    {
+        std::lock_guard<std::mutex> lock(hdl->lock);
+
+        if ((hdl->packed && stage(*hdl) == -1) || unshare(*hdl, offset, offset + size) == -1 || grow_chain(*hdl, offset + size) == -1)
+            return -1;
+        chain = hdl->chain;
+    }
+
+    // unlike write, a gap past the end isn't zero filled, other ranges fill it.
+    uint64_t amt = write_range(*chain, offset, size, (const std::byte*)buf);
+
+    std::lock_guard<std::mutex> lock(hdl->lock);
+    hdl->size = std::max(hdl->size, offset + amt);
+    hdl->dirty = 1;
+    return (int64_t)amt;
+}
+
+int64_t fat32::lseek(int fd, int64_t offset, int whence) noexcept {
+    std::shared_ptr<handle_t> hdl = get_handle(fd);
+    int64_t pos;
+
+    if (!hdl)
+        return -1;
+
+    std::lock_guard<std::mutex> lock(hdl->lock);
+
+    switch (whence) {
+        case SEEK_SET: pos = offset;                     break;
+        case SEEK_CUR: pos = (int64_t)hdl->pos + offset;  break;
+        case SEEK_END: pos = (int64_t)hdl->size + offset; break;
+        default: return -1;
+    }
+
+    if (pos < 0)
+        return -1;
+
+    hdl->pos = pos;
+    return pos;
+}
+
+int fat32::fstat(int fd, stat_t& st) noexcept {
+    std::shared_ptr<handle_t> hdl = get_handle(fd);
+
+    if (!hdl)
+        return -1;
+
+    std::lock_guard<std::mutex> lock(hdl->lock);
+
+    memcpy(st.name, hdl->name, DIR_NAME_LENGTH);
+    st.size = hdl->size;
+    st.start_cluster = hdl->start_clu;
+    st.is_directory = NON_DIRECTORY;
+    return 0;
+}
+
+int fat32::close(int fd) noexcept {
+    std::shared_ptr<handle_t> hdl;
+    int ret = 0;
+
+    // out of the table first, a call still using the handle keeps it alive until it's done.
+    {
+        std::lock_guard<std::mutex> lock(m_handle_lock);
+
+        if (fd < 0 || fd >= m_handles.size() || !m_handles[fd]) {
+            BUFFER << (LOG_str(log::WARNING, "file handle is not open"));
+            return -1;
+        }
+        hdl = std::move(m_handles[fd]);
+    }
+
+    std::lock_guard<std::mutex> io(hdl->lock);
+
+    // on a compressed disk the entry only ever points at a packed chain.
+    if (hdl->dirty && compressed() && repack(*hdl) == -1)
+        hdl->dirty = 0;
+
+    // the entry is only rewritten once, when the handle is closed.
+    if (hdl->dirty) {
+        tree_lock tree(*this, false);
+        dir_lock lock(*this, {hdl->parent_clu}, true);
+
+        std::shared_ptr<dir_t> dir = read_dir(hdl->parent_clu);
+        dir_entry_t* entry = dir ? find_entry(dir, hdl->name, 0x1) : nullptr;
+
+        // a handle on the old chain can't point the entry back at it once it has moved on.
+        if (entry && !hdl->replaced && entry->start_cluster_index != hdl->start_clu) {
+            BUFFER << (LOG_str(log::WARNING, "file: [" + std::string(hdl->name) + "] was replaced while open, its writes are dropped"));
+            entry = nullptr;
+            ret = -1;
+        }
+
+        // the old chain is retired for its readers, with a deduped repack's share of it.
+        if (entry) {
+            if (hdl->replaced)
+                free_clu_chain(entry->start_cluster_index);
+
+            entry->start_cluster_index = hdl->start_clu;
+            entry->dir_entry_size = hdl->size;
+            save_dir(dir);
+        } else if (hdl->replaced)
+            free_clu_chain(hdl->start_clu);
+    }
+
+    // whoever lets go of a cluster last frees it.
+    if (!hdl->held.empty()) {
+        release_clus(hdl->held);
+        store_fat_table();
+    }
+
+    return ret;
 }
 
 fat32::dir_entry_t* fat32::find_entry(std::shared_ptr<dir_t>& dir, const char* entry, uint8_t shd_exst) const noexcept {
@@ -815,7 +2283,26 @@ void fat32::print_super_block() const noexcept {
     BUFFER << " -> User space:      " << convert_size(m_superblock.data.user_size).c_str() << "\n";
     BUFFER << " -> Cluster size:    " << convert_size(m_superblock.data.cluster_size).c_str() << "\n";
     BUFFER << " -> Cluster amount:  " << m_superblock.data.cluster_n << "\n";
-    BUFFER << " -> Clusters free:   " << m_free_clusters->size() << "\n";
+    BUFFER << " -> Clusters free:   " << (uint32_t)m_free_n << "\n";
+    BUFFER << " -> Clusters shared: " << (uint32_t)m_shared_n << "\n";
+
+    // logical clusters, one per owner, over those in use.
+    if (dedup()) {
+        uint64_t used = CLUSTER_AMT - m_free_n;
+        size_t index_size = FPS_SIZE + m_index_n * (sizeof(std::pair<const uint64_t, uint32_t>) + 2 * sizeof(void*));
+
+        sprintf(buffer, "%.2f", used ? (double)(used + m_refs_n) / used : 1.0);
+        BUFFER << " -> Dedup:           on\n";
+        BUFFER << " -> Dedup ratio:     " << buffer << "\n";
+        BUFFER << " -> Dedup index:     " << (uint64_t)m_index_n << " (" << convert_size(index_size).c_str() << ")\n";
+    } else
+        BUFFER << " -> Dedup:           off\n";
+
+    if (compressed()) {
+        BUFFER << " -> Compression:     on, " << convert_size(m_features.chunk_size).c_str() << " chunks\n";
+        BUFFER << " -> Packed:          " << convert_size(m_packed_in).c_str() << " into " << convert_size(m_packed_out).c_str() << " since mount\n";
+    } else
+        BUFFER << " -> Compression:     off\n";
 
     BUFFER << "\n  Address space\n-----------------\n";
 
@@ -836,27 +2323,26 @@ void fat32::print_fat_table() const noexcept {
 }
 
 void fat32::print_dir(dir_t & dir) noexcept {
-    char buffer[1024 * 8];
+    char line[128];
     if ((dir_t*)&dir == NULL) {
         BUFFER << (LOG_str(log::WARNING, "specified directory to be printed is null"));
         return;
     }
 
-    sprintf(buffer, "\r\nDirectory:        %s\n", dir.dir_header.dir_name);
-    sprintf(buffer + strlen(buffer), "Start cluster:    %d\n", dir.dir_header.start_cluster_index);
-    sprintf(buffer + strlen(buffer), "Parent cluster:   %d\n", dir.dir_header.parent_cluster_index);
-    sprintf(buffer + strlen(buffer), "Entry amt:        %d\n", dir.dir_header.dir_entry_amt);
+    BUFFER << "\r\nDirectory:        " << dir.dir_header.dir_name;
+    BUFFER << "\nStart cluster:    " << dir.dir_header.start_cluster_index;
+    BUFFER << "\nParent cluster:   " << dir.dir_header.parent_cluster_index;
+    BUFFER << "\nEntry amt:        " << dir.dir_header.dir_entry_amt << "\n";
 
-    sprintf(buffer + strlen(buffer), "\n %s%4s%s%4s%s\n%s\n", "size", "", "start cluster", "", "name", "-------------------------------");
+    int len = snprintf(line, sizeof(line), "\n %s%4s%s%4s%s\n%s\n", "size", "", "start cluster", "", "name", "-------------------------------");
+    BUFFER << std::string_view(line, len);
 
     for (int i = 0; i < dir.dir_header.dir_entry_amt; i++) {
-        sprintf(buffer + strlen(buffer), "%s%8s%02d%10s%s\n", convert_size(dir.dir_entries[i].dir_entry_size).c_str(), "", dir.dir_entries[i].start_cluster_index, "", dir.dir_entries[i].dir_entry_name);
+        len = snprintf(line, sizeof(line), "%s%8s%02d%10s%.*s\n", convert_size(dir.dir_entries[i].dir_entry_size).c_str(), "", dir.dir_entries[i].start_cluster_index, "", DIR_NAME_LENGTH, dir.dir_entries[i].dir_entry_name);
+        BUFFER << std::string_view(line, min_(len, (int)sizeof(line) - 1));
     }
-    
-    sprintf(buffer + strlen(buffer), "-------------------------------");
-    sprintf(buffer + strlen(buffer), "\n");
 
-    BUFFER << (buffer);
+    BUFFER << "-------------------------------\n";
 }
 
 int8_t fat32::dir_equal(std::shared_ptr<fat32::dir_t>& d1, std::shared_ptr<fat32::dir_t>& d2) noexcept {
@@ -0,0 +1,82 @@
+#include "../include/libvfs.h"
+
+using namespace VFS;
+
+int libvfs::mount(const char* disk_name) noexcept {
+    auto out = bind();
+
+    if(m_fs)
+        return -1;
+
+    m_disk_name = disk_name;
+    m_fs = std::make_unique<IFS::fat32>(m_disk_name.c_str());
+    return 0;
+}
+
+int libvfs::umount() noexcept {
+    auto out = bind();
+
+    if(!m_fs)
+        return -1;
+
+    m_fs.reset();
+    return 0;
+}
+
+bool libvfs::is_mnted() const noexcept {
+    return m_fs != nullptr;
+}
+
+int libvfs::lookup(const char* path, stat_t& st) noexcept {
+    auto out = bind();
+    return m_fs ? m_fs->lookup(path, st) : -1;
+}
+
+int libvfs::stat(const char* path, stat_t& st) noexcept {
+    return lookup(path, st);
+}
+
+int libvfs::readdir(const char* path, std::vector<stat_t>& entries) noexcept {
+    auto out = bind();
+    return m_fs ? m_fs->readdir(path, entries) : -1;
+}
+
+int libvfs::open(const char* path, int flags) noexcept {
+    auto out = bind();
+    return m_fs ? m_fs->open(path, flags) : -1;
+}
+
+int64_t libvfs::read(int fd, void* buf, uint64_t size) noexcept {
+    auto out = bind();
+    return m_fs ? m_fs->read(fd, buf, size) : -1;
+}
+
+int64_t libvfs::write(int fd, const void* buf, uint64_t size) noexcept {
+    auto out = bind();
+    return m_fs ? m_fs->write(fd, buf, size) : -1;
+}
+
+int64_t libvfs::lseek(int fd, int64_t offset, int whence) noexcept {
+    auto out = bind();
+    return m_fs ? m_fs->lseek(fd, offset, whence) : -1;
+}
+
+int libvfs::fstat(int fd, stat_t& st) noexcept {
+    auto out = bind();
+    return m_fs ? m_fs->fstat(fd, st) : -1;
+}
+
+int libvfs::close(int fd) noexcept {
+    auto out = bind();
+    return m_fs ? m_fs->close(fd) : -1;
+}
+
+const buffer& libvfs::output() const noexcept {
+    return m_out;
+}
+
+buffer::scope libvfs::bind() noexcept {
+    // diagnostics of the last call only, they never reach the terminal's console.
+    m_out.clear();
+    return buffer::scope(m_out);
+}
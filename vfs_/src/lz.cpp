@@ -0,0 +1,165 @@
+#include "../include/lz.h"
+
+using namespace VFS;
+
+size_t lz::bound(size_t n) noexcept {
+    return n + n / 255 + 16;
+}
+
+uint32_t lz::read32(const uint8_t* p) noexcept {
+    uint32_t val;
+    memcpy(&val, p, sizeof(val));
+    return val;
+}
+
+uint32_t lz::hash(uint32_t seq) noexcept {
+    return (seq * 2654435761u) >> (32 - HASH_BITS);
+}
+
+size_t lz::put_run(uint8_t* p, size_t val) noexcept {
+    size_t n = 0;
+
+    while(val >= 255) {
+        p[n++] = 255;
+        val -= 255;
+    }
+    p[n++] = (uint8_t)val;
+    return n;
+}
+
+size_t lz::compress(const char* source, size_t n, char* dest, size_t cap) noexcept {
+    const uint8_t* src = (const uint8_t*)source;
+    uint8_t* dst = (uint8_t*)dest;
+    uint32_t table[(size_t)1 << HASH_BITS] = {};
+    size_t anchor = 0, op = 0;
+
+    // a match can't start in the last MATCH_LIMIT bytes, anything shorter is all literals.
+    if(n > MATCH_LIMIT) {
+        size_t limit = n - MATCH_LIMIT;
+        size_t misses = 0;
+        size_t ip = 1;
+
+        while(ip <= limit) {
+            uint32_t seq = read32(src + ip);
+            uint32_t h = hash(seq);
+            size_t ref = table[h];
+            table[h] = (uint32_t)ip;
+
+            // the longer nothing matches the further ahead it looks, data that won't compress is skimmed.
+            if(ip - ref > MAX_OFFSET || read32(src + ref) != seq) {
+                ip += 1 + (misses++ >> 6);
+                continue;
+            }
+            misses = 0;
+
+            while(ip > anchor && ref > 0 && src[ip - 1] == src[ref - 1]) {
+                ip--;
+                ref--;
+            }
+
+            size_t len = MIN_MATCH;
+            while(ip + len < n - LAST_LITERALS && src[ip + len] == src[ref + len])
+                len++;
+
+            size_t lit = ip - anchor;
+            if(op + 1 + lit + lit / 255 + 1 + 2 + (len - MIN_MATCH) / 255 + 1 > cap)
+                return 0;
+
+            uint8_t* token = dst + op++;
+            *token = (uint8_t)(std::min<size_t>(lit, 15) << 4 | std::min<size_t>(len - MIN_MATCH, 15));
+
+            if(lit >= 15)
+                op += put_run(dst + op, lit - 15);
+            memcpy(dst + op, src + anchor, lit);
+            op += lit;
+
+            dst[op++] = (uint8_t)(ip - ref);
+            dst[op++] = (uint8_t)((ip - ref) >> 8);
+
+            if(len - MIN_MATCH >= 15)
+                op += put_run(dst + op, len - MIN_MATCH - 15);
+
+            ip += len;
+            anchor = ip;
+
+            if(ip <= limit)
+                table[hash(read32(src + ip - 2))] = (uint32_t)(ip - 2);
+        }
+    }
+
+    size_t lit = n - anchor;
+    if(op + 1 + lit + lit / 255 + 1 > cap)
+        return 0;
+
+    dst[op++] = (uint8_t)(std::min<size_t>(lit, 15) << 4);
+    if(lit >= 15)
+        op += put_run(dst + op, lit - 15);
+    memcpy(dst + op, src + anchor, lit);
+    return op + lit;
+}
+
+int64_t lz::decompress(const char* source, size_t n, char* dest, size_t cap) noexcept {
+    const uint8_t* src = (const uint8_t*)source;
+    uint8_t* dst = (uint8_t*)dest;
+    size_t ip = 0, op = 0;
+
+    while(ip < n) {
+        uint8_t token = src[ip++];
+        size_t lit = token >> 4;
+
+        if(lit == 15) {
+            uint8_t b;
+            do {
+                if(ip >= n)
+                    return -1;
+                b = src[ip++];
+                lit += b;
+            } while(b == 255);
+        }
+
+        if(lit > n - ip || lit > cap - op)
+            return -1;
+
+        memcpy(dst + op, src + ip, lit);
+        ip += lit;
+        op += lit;
+
+        // the last sequence is literals only.
+        if(ip == n)
+            break;
+
+        if(n - ip < 2)
+            return -1;
+
+        size_t offset = src[ip] | (size_t)src[ip + 1] << 8;
+        ip += 2;
+
+        if(offset == 0 || offset > op)
+            return -1;
+
+        size_t len = token & 15;
+        if(len == 15) {
+            uint8_t b;
+            do {
+                if(ip >= n)
+                    return -1;
+                b = src[ip++];
+                len += b;
+            } while(b == 255);
+        }
+        len += MIN_MATCH;
+
+        if(len > cap - op)
+            return -1;
+
+        // a match closer than its length repeats itself, it has to be copied a byte at a time.
+        if(offset >= len) {
+            memcpy(dst + op, dst + op - offset, len);
+        } else {
+            for(size_t i = 0; i < len; i++)
+                dst[op + i] = dst[op + i - offset];
+        }
+        op += len;
+    }
+    return (int64_t)op;
+}
@@ -0,0 +1,124 @@
+#include "../include/pool.h"
+
+using namespace VFS;
+
+thread_local pool* pool::m_self = nullptr;
+thread_local size_t pool::m_id = 0;
+
+pool::pool(size_t amt) : m_amt(amt) {
+    m_queues = std::unique_ptr<worker_t[]>(new worker_t[amt]);
+
+    for(size_t i = 0; i < amt; i++)
+        m_workers.emplace_back(&pool::work, this, i);
+}
+
+pool::~pool() {
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_stop = true;
+    }
+    m_cv.notify_all();
+
+    for(auto& worker : m_workers)
+        worker.join();
+}
+
+void pool::submit(std::function<void()> task) noexcept {
+    if(m_self == this) {
+        std::lock_guard<std::mutex> lock(m_queues[m_id].lock);
+        m_queues[m_id].tasks.push_back(std::move(task));
+        m_queued++;
+    } else {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_tasks.push_back(std::move(task));
+        m_queued++;
+    }
+
+    // taken between the count going up and the notify, a worker can't miss it on its way to sleep.
+    { std::lock_guard<std::mutex> lock(m_lock); }
+    m_cv.notify_one();
+}
+
+void pool::submit(group& grp, std::function<void()> task) noexcept {
+    grp.m_left++;
+
+    submit([this, &grp, task = std::move(task)] {
+        task();
+
+        if(--grp.m_left == 0) {
+            std::lock_guard<std::mutex> lock(m_lock);
+            m_cv.notify_all();
+        }
+    });
+}
+
+void pool::wait(group& grp) noexcept {
+    while(grp.m_left > 0) {
+        if(run_one())
+            continue;
+
+        std::unique_lock<std::mutex> lock(m_lock);
+        m_cv.wait(lock, [this, &grp] { return grp.m_left == 0 || m_queued > 0; });
+    }
+}
+
+size_t pool::size() const noexcept {
+    return m_amt;
+}
+
+bool pool::run_one() noexcept {
+    std::function<void()> task;
+    size_t id = (m_self == this) ? m_id : 0;
+
+    if(m_self == this) {
+        std::lock_guard<std::mutex> lock(m_queues[id].lock);
+
+        if(!m_queues[id].tasks.empty()) {
+            task = std::move(m_queues[id].tasks.back());
+            m_queues[id].tasks.pop_back();
+        }
+    }
+
+    if(!task) {
+        std::lock_guard<std::mutex> lock(m_lock);
+
+        if(!m_tasks.empty()) {
+            task = std::move(m_tasks.front());
+            m_tasks.pop_front();
+        }
+    }
+
+    for(size_t i = 0; !task && i < m_amt; i++) {
+        worker_t& victim = m_queues[(id + i) % m_amt];
+        std::lock_guard<std::mutex> lock(victim.lock);
+
+        if(!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+        }
+    }
+
+    if(!task)
+        return false;
+
+    m_queued--;
+    task();
+    return true;
+}
+
+void pool::work(size_t id) noexcept {
+    m_self = this;
+    m_id = id;
+
+    while(1) {
+        if(run_one())
+            continue;
+
+        std::unique_lock<std::mutex> lock(m_lock);
+        m_cv.wait(lock, [this] { return m_stop || m_queued > 0; });
+
+        // queued tasks are drained before the workers exit.
+        if(m_stop && m_queued == 0)
+            return;
+    }
+}
@@ -3,248 +3,366 @@
 
 using namespace VFS::RFS;
 
-std::unique_ptr<rfs::pcontainer_t> rfs::generate_container(uint8_t cmd, std::vector<std::string>& args, std::shared_ptr<std::byte[]>& payload, uint64_t size) noexcept {
-        m_lock.lock();
-        std::unique_ptr<pcontainer_t> con = std::make_unique<pcontainer_t>();
-        std::shared_ptr<char[]> hash = generate_hash();
-        memcpy(con->info.hash, hash.get(), CFG_PACKET_HASH_SIZE);
-
-        std::string flags = {};
-
-        for(const auto& a : args)
-            flags += a + " ";
-
-        flags[flags.size() - 2] += '\0';
-        
-        uint64_t load_size = size;
-        uint64_t amount_of_payloads = 0;
-        size_t data_read = {};
-
-        if(load_size > 0) {
-    
-            amount_of_payloads = load_size / CFG_PAYLOAD_SIZE;
-
-            if(load_size > CFG_PAYLOAD_SIZE)
-                if(load_size % CFG_PAYLOAD_SIZE)
-                    amount_of_payloads++;
-
-            if(amount_of_payloads == 0)
-                amount_of_payloads += 1;
-
-            std::unique_ptr<payload_t> tmp = std::make_unique<payload_t>();
-            memcpy(tmp->header.hash, con->info.hash, CFG_PACKET_HASH_SIZE);
-            tmp->header.size = CFG_PAYLOAD_SIZE;
-            tmp->header.mf = 0x1;
-            for(uint64_t i = 0; i < (amount_of_payloads - 1); i++) {
-                tmp->header.index = i;
-                memcpy(tmp->payload, payload.get() + data_read, CFG_PAYLOAD_SIZE);
-
-                con->payloads->push_back(*tmp);
-                data_read += CFG_PAYLOAD_SIZE;
-            }
+size_t rfs::put_varint(char* buffer, uint64_t val) noexcept {
+    size_t n = 0;
 
-            uint64_t remaining_data = load_size - data_read;
+    while(val >= 0x80) {
+        buffer[n++] = (char)((val & 0x7F) | 0x80);
+        val >>= 7;
+    }
+    buffer[n++] = (char)val;
+    return n;
+}
 
-            tmp->header.mf = 0x0;
-            tmp->header.size = remaining_data;
-            tmp->header.index = amount_of_payloads - 1;
+size_t rfs::get_varint(const char* buffer, size_t avail, uint64_t& val) noexcept {
+    val = 0;
 
-            memcpy(tmp->payload, payload.get() + data_read, remaining_data);
-            con->payloads->push_back(*tmp);
+    // 0 while the varint is still incomplete, anything past VARINT_SIZE bytes is garbage.
+    for(size_t i = 0; i < avail && i < VARINT_SIZE; i++) {
+        val |= (uint64_t)(buffer[i] & 0x7F) << (7 * i);
 
-            data_read += load_size - data_read;
-        }
-        memcpy(con->info.signature, CFG_PACKET_SIGNATURE, CFG_PACKET_SIGNATURE_SIZE);
-        con->info.cmd = cmd;
+        if((buffer[i] & 0x80) == 0)
+            return i + 1;
+    }
+    return avail >= VARINT_SIZE ? VARINT_SIZE + 1 : 0;
+}
 
-        if(flags.size() < CFG_FLAGS_BUFFER_SIZE) {
-            memcpy(con->info.flags, flags.c_str(), flags.size());
-        } else memcpy(con->info.flags, flags.c_str(), CFG_FLAGS_BUFFER_SIZE);
-        
-        con->info.p_count = amount_of_payloads;
-        con->info.size = load_size + (sizeof(packet_t) * 8);
+void rfs::advance_iov(iovec*& iov, int& iov_c, size_t bytes) noexcept {
+    // skips what a partial writev/sendmsg already sent.
+    while(iov_c > 0 && bytes >= iov->iov_len) {
+        bytes -= iov->iov_len;
+        iov++;
+        iov_c--;
+    }
 
-        m_lock.unlock();
+    if(iov_c > 0) {
+        iov->iov_base = (char*)iov->iov_base + bytes;
+        iov->iov_len -= bytes;
+    }
+}
 
-        return std::move(con);
+uint64_t rfs::cpu_ns() noexcept {
+    timespec ts{};
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
 }
 
-uint64_t rfs::retain_payloads(std::shared_ptr<char[]>& buffer, std::vector<payload_t>& pylds) noexcept {
-    uint64_t size = 0;
-    for(int i = 0; i < pylds.size(); i++)
-        size += pylds[i].header.size;
+size_t rfs::write_header(char* buffer, int8_t cmd, uint8_t flags, uint64_t id, uint64_t total, const std::string* args) const noexcept {
+    size_t n = 0;
 
-    if(size == 0)
-        return 0;
+    buffer[n++] = (char)cmd;
+    buffer[n++] = (char)flags;
+    n += put_varint(buffer + n, id);
+
+    if(flags & FRAME_HEAD) {
+        size_t args_size = std::min(args->size(), CFG_FRAME_ARGS_SIZE);
 
-    buffer = std::shared_ptr<char[]>(new char[size]);
-    memset(buffer.get(), 0, size);
-    
-    uint64_t data_copied = 0;
-    for(int i = 0; i < pylds.size(); i++) {
-        memcpy(buffer.get() + data_copied, pylds[i].payload, pylds[i].header.size);
-        data_copied += pylds[i].header.size;
+        n += put_varint(buffer + n, total);
+        n += put_varint(buffer + n, args_size);
+        memcpy(buffer + n, args->data(), args_size);
+        n += args_size;
     }
-    buffer[data_copied] = '\0';
-    return size;
+    return n;
 }
 
+uint8_t rfs::read_frames(reader_t& reader, std::vector<std::shared_ptr<message_t>>& store, uint64_t max_frame, uint64_t max_message, uint64_t caps) const noexcept {
+    std::vector<char>& rx = reader.rx;
+    size_t off = 0;
+    uint8_t return_val = 1;
 
-void rfs::serialize_packet(packet_t& pckt, char* buffer) noexcept {
-    // Store signature.
-    char* sign_p = (char*)buffer;
-    int sign_c = 0;
+    while(off < rx.size()) {
+        const char* frame = rx.data() + off;
+        size_t avail = rx.size() - off;
+        uint64_t len = {};
+        size_t len_size = get_varint(frame, avail, len);
 
-    while(sign_c < CFG_PACKET_SIGNATURE_SIZE) {
-        *sign_p = pckt.signature[sign_c];
-        sign_p++;
-        sign_c++;
-    }
-    // Store size.
-    uint64_t* size_p = (uint64_t*)sign_p;
-    *size_p = pckt.size; size_p++;
-    // Store p count.
-    uint64_t* p_count_p = (uint64_t*)size_p;
-    *p_count_p = pckt.p_count; p_count_p++;
-    // Store cmd int.
-    uint8_t* int_p = (uint8_t*)p_count_p;
-    *int_p = pckt.cmd; int_p++;
-    // Store hash char.
-    char* hash_p = (char*)int_p;
-    int hash_c = 0;
-    while(hash_c < CFG_PACKET_HASH_SIZE) {
-        *hash_p = pckt.hash[hash_c]; 
-        hash_p++;
-        hash_c++;
-    }
-    // Store flags char.
-    char* char_p = (char*)hash_p;
-    int flag_c = 0;
-
-    while(flag_c < CFG_FLAGS_BUFFER_SIZE) {
-        *char_p = pckt.flags[flag_c];
-        char_p++;
-        flag_c++;
+        if(len_size == 0)
+            break;
+
+        if(len_size > VARINT_SIZE || len > max_frame || len < 2) {
+            return_val = 0;
+            break;
+        }
+
+        if(avail - len_size < len)
+            break;
+
+        const char* p = frame + len_size;
+        const char* end = p + len;
+        int8_t cmd = (int8_t)*p++;
+        uint8_t flags = (uint8_t)*p++;
+        uint64_t id = {};
+        size_t n = get_varint(p, end - p, id);
+
+        if(n == 0 || n > VARINT_SIZE) {
+            return_val = 0;
+            break;
+        }
+        p += n;
+
+        // once crc is agreed on every frame carries one, and lz only comes from a peer that was told it can.
+        if(((caps & CAP_CRC) && !(flags & FRAME_CRC)) || ((flags & FRAME_LZ) && !(caps & CAP_LZ))) {
+            return_val = 0;
+            break;
+        }
+
+        std::shared_ptr<message_t> msg = nullptr;
+        auto open = reader.pending.find(id);
+
+        if(flags & FRAME_HEAD) {
+            // an id can't be reused while its message is still open, and a peer only gets so many open at once.
+            if(open != reader.pending.end() || reader.pending.size() >= CFG_RFS_INFLIGHT_MAX) {
+                return_val = 0;
+                break;
+            }
+            msg = std::make_shared<message_t>();
+            uint64_t args_size = {};
+
+            // a message that isn't streamed is held whole, it can't claim more than the caller takes.
+            if((n = get_varint(p, end - p, msg->total)) == 0 || n > VARINT_SIZE || (!(flags & FRAME_STREAM) && msg->total > max_message)) {
+                return_val = 0;
+                break;
+            }
+            p += n;
+
+            if((n = get_varint(p, end - p, args_size)) == 0 || n > VARINT_SIZE || args_size > (uint64_t)(end - p - n)) {
+                return_val = 0;
+                break;
+            }
+            p += n;
+
+            msg->cmd = cmd;
+            msg->id = id;
+            msg->args.assign(p, args_size);
+            p += args_size;
+
+            // total is only a hint, a peer with many messages open can't make us reserve more than a frame each.
+            if(!(flags & FRAME_STREAM))
+                msg->data.reserve(std::min(msg->total, max_frame));
+
+            if(!(flags & FRAME_FIN))
+                reader.pending[id] = msg;
+
+            // a stream is handed out straight away, its body follows through msg->stream.
+            if(flags & FRAME_STREAM) {
+                msg->stream = std::make_shared<stream_t>();
+                store.push_back(msg);
+            }
+        } else if(open != reader.pending.end()) {
+            msg = open->second;
+        } else {
+            return_val = 0;
+            break;
+        }
+
+        // checked before the body is used, a frame that was damaged on the way drops the connection.
+        if(flags & FRAME_CRC) {
+            if((size_t)(end - p) < CRC_SIZE) {
+                return_val = 0;
+                break;
+            }
+
+            uint32_t sent = 0;
+            for(size_t i = 0; i < CRC_SIZE; i++)
+                sent |= (uint32_t)(uint8_t)p[i] << (8 * i);
+
+            uint32_t crc = crc32c::update(0, frame + len_size, p - (frame + len_size));
+            if(crc32c::update(crc, p + CRC_SIZE, end - p - CRC_SIZE) != sent) {
+                stats.crc_fail++;
+                return_val = 0;
+                break;
+            }
+            p += CRC_SIZE;
+        }
+
+        uint64_t raw = end - p;
+        stats.wire_rx += raw;
+
+        if(flags & FRAME_LZ) {
+            // a body never unpacks to more than a frame, it's decompressed straight into place.
+            if((n = get_varint(p, end - p, raw)) == 0 || n > VARINT_SIZE || raw > max_frame) {
+                return_val = 0;
+                break;
+            }
+            p += n;
+        }
+
+        // a message held whole never grows past the total it announced.
+        if(!msg->stream && msg->received + raw > msg->total) {
+            return_val = 0;
+            break;
+        }
+
+        if(flags & FRAME_LZ) {
+            std::vector<char> chunk;
+            char* dst = nullptr;
+
+            if(msg->stream) {
+                chunk.resize(raw);
+                dst = chunk.data();
+            } else {
+                msg->data.resize(msg->data.size() + raw);
+                dst = msg->data.data() + msg->data.size() - raw;
+            }
+
+            uint64_t start = cpu_ns();
+            int64_t got = lz::decompress(p, end - p, dst, raw);
+            stats.unpack_ns += cpu_ns() - start;
+
+            if(got != (int64_t)raw) {
+                return_val = 0;
+                break;
+            }
+            stats.unpacked++;
+
+            if(msg->stream && raw)
+                msg->stream->push(std::move(chunk));
+        } else if(msg->stream && p != end) {
+            msg->stream->push(std::vector<char>(p, end));
+        } else if(!msg->stream) {
+            msg->data.insert(msg->data.end(), p, end);
+        }
+
+        stats.raw_rx += raw;
+        msg->received += raw;
+        off += len_size + len;
+
+        if(flags & FRAME_FIN) {
+            reader.pending.erase(id);
+
+            // a sender that couldn't read everything it meant to send ends early, the rest isn't coming.
+            if(msg->stream && msg->received != msg->total)
+                msg->stream->abort();
+            else if(msg->stream)
+                msg->stream->finish();
+            else store.push_back(std::move(msg));
+        }
     }
+    rx.erase(rx.begin(), rx.begin() + off);
+    return return_val;
 }
 
-void rfs::deserialize_packet(packet_t& pckt, char* buffer) noexcept {
-    // Store signature.
-    char* sign_p = (char*)buffer;
-    int sign_c = 0;
+void rfs::hello_body(char* buffer, size_t& size, uint64_t caps, uint64_t session, uint64_t lane) const noexcept {
+    uint64_t fields[] = {CFG_FRAME_VERSION, CFG_FRAME_MAX_SIZE, caps & CFG_RFS_CAPS, session, lane};
+    size = 0;
 
-    while(sign_c < CFG_PACKET_SIGNATURE_SIZE) {
-        pckt.signature[sign_c] = *sign_p;
-        sign_p++;
-        sign_c++;
-    }
-    // Store size into struct.
-    uint64_t* size_p = (uint64_t*)sign_p;
-    pckt.size = *size_p; size_p++;
-    // Store p count.
-    uint64_t* p_count_p = (uint64_t*)size_p;
-    pckt.p_count = *p_count_p; p_count_p++;
-    // Store cmd into struct.
-    uint8_t* int_p = (uint8_t*)p_count_p;
-    pckt.cmd = *int_p; int_p++;
-    // Store hash char.
-    char* hash_p = (char*)int_p;
-    int hash_c = 0;
-    while(hash_c < CFG_PACKET_HASH_SIZE) {
-        pckt.hash[hash_c] = *hash_p; 
-        hash_p++;
-        hash_c++;
-    }
-    // Store flags into struct.
-    char* char_p = (char*)hash_p;
-    int flag_c = 0;
-
-    while(flag_c < CFG_FLAGS_BUFFER_SIZE) {
-        pckt.flags[flag_c] = *char_p;
-        char_p++;
-        flag_c++;
-    }
+    for(uint64_t field : fields)
+        size += put_varint(buffer + size, field);
 }
 
-void rfs::serialize_payload(payload_t& pyld, char* buffer) noexcept {
-    // Store payload header.
-    payload_header_t* header_p = (payload_header_t*)buffer;
-    *header_p = pyld.header; header_p++;
+uint8_t rfs::process_hello(const message_t& msg, hello_t& hello) const noexcept {
+    uint64_t* fields[] = {&hello.version, &hello.max_frame, &hello.caps, &hello.session, &hello.lane};
+    size_t off = 0;
 
-    //Store payload.
-    char* char_p = (char*)header_p;
-    int pyld_c = 0;
+    if(msg.cmd != (int8_t)type_t::hello || msg.args != std::string(CFG_PACKET_SIGNATURE, CFG_PACKET_SIGNATURE_SIZE))
+        return 0;
+
+    // only the version and frame size are required, the rest are left at zero by older peers.
+    for(size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) {
+        size_t n = {};
+
+        if(i >= 2 && off == msg.data.size())
+            break;
 
-    while(pyld_c < CFG_PAYLOAD_SIZE) {
-        *char_p = pyld.payload[pyld_c];
-        char_p++;
-        pyld_c++;
+        if((n = get_varint(msg.data.data() + off, msg.data.size() - off, *fields[i])) == 0 || n > VARINT_SIZE)
+            return 0;
+        off += n;
     }
+
+    if(hello.version != CFG_FRAME_VERSION)
+        return 0;
+
+    // both ends accept frames up to the smaller advertised size, never below the floor.
+    hello.max_frame = std::max(std::min(hello.max_frame, CFG_FRAME_MAX_SIZE), CFG_FRAME_MIN_SIZE);
+    hello.caps &= CFG_RFS_CAPS;
+    return 1;
 }
 
-void rfs::deserialize_payload(payload_t& pyld, char* buffer) noexcept {
-    // Store payload header.
-    payload_header_t* header_p = (payload_header_t*)buffer;
-    pyld.header = *header_p; header_p++;
-    //Store payload into struct.
-    char* char_p = (char*)header_p;
-    int pyld_c = 0;
+void rfs::print_message(const message_t& msg) const noexcept {
+    std::cout << "\n---- MESSAGE ----\n -> cmd: [" << (int)msg.cmd << "]\n -> id: [" << msg.id << "]\n -> args: [" << msg.args << "]\n -> size: [" << msg.data.size() << "]\n-----------------\n";
+}
 
-    while(pyld_c < CFG_PAYLOAD_SIZE) {
-        pyld.payload[pyld_c] = *char_p;
-        char_p++;
-        pyld_c++;
-    }
+void rfs::print_stats(const std::string& name) const noexcept {
+    auto line = [](const char* dir, uint64_t raw, uint64_t wire, uint64_t frames, uint64_t ns) {
+        char str[256];
+        snprintf(str, sizeof(str), "    %s %.2f MB as %.2f MB (ratio %.2f), %lu frames compressed, %.2f ms cpu\n",
+                 dir, raw / 1048576.0, wire / 1048576.0, wire ? (double)raw / wire : 1.0, (unsigned long)frames, ns / 1e6);
+        return std::string(str);
+    };
+
+    BUFFER << " -> (name)" << name.c_str() << "\n";
+    BUFFER << line("sent    ", stats.raw_tx, stats.wire_tx, stats.packed, stats.pack_ns);
+    BUFFER << line("received", stats.raw_rx, stats.wire_rx, stats.unpacked, stats.unpack_ns);
+    BUFFER << "    crc32c " << crc32c::impl() << ", " << (uint64_t)stats.crc_fail << " frames failed the check\n";
 }
 
-uint8_t rfs::process_payload(const packet_t& pckt, const payload_t& pyld) const noexcept {
-    uint8_t return_val = 1;
+bool rfs::stream_t::push(std::vector<char>&& chunk) noexcept {
+    std::lock_guard<std::mutex> lock(m_lock);
 
-    if(strncmp(pyld.header.hash, pckt.hash, CFG_PACKET_HASH_SIZE) != 0)
-        return_val = 0;
+    if(m_abort)
+        return m_full;
 
-    if(pyld.header.size > pckt.size)
-        return_val = 0;
+    m_queued += chunk.size();
+    m_chunks.push_back(std::move(chunk));
 
-    if(pyld.header.index > pckt.p_count)
-        return_val = 0;
+    if(m_queued > CFG_STREAM_WINDOW)
+        m_full = true;
 
-    
-    return return_val;
+    m_cv.notify_all();
+    return m_full;
 }
 
-uint8_t rfs::process_packet(const packet_t& pckt) const noexcept {
-    uint8_t return_val = 1;
+bool rfs::stream_t::pop(std::vector<char>& chunk) noexcept {
+    bool drained = false;
+    {
+        std::unique_lock<std::mutex> lock(m_lock);
+        m_cv.wait(lock, [this] { return !m_chunks.empty() || m_fin || m_abort; });
 
-    if(strncmp(pckt.signature, CFG_PACKET_SIGNATURE, CFG_PACKET_SIGNATURE_SIZE) != 0)
-        return_val = 0;
+        if(m_chunks.empty() || m_abort)
+            return false;
 
-    return return_val;
+        chunk = std::move(m_chunks.front());
+        m_chunks.pop_front();
+        m_queued -= chunk.size();
+
+        if(m_full && m_queued <= CFG_STREAM_WINDOW / 2) {
+            m_full = false;
+            drained = true;
+            m_cv.notify_all();
+        }
+    }
+
+    if(drained && on_drain)
+        on_drain();
+    return true;
 }
 
-void rfs::print_packet(const packet_t& pckt) const noexcept {
-    char buffer[2];
-    lib_::itoa_(pckt.cmd, buffer, 10, 2);
-    std::cout << "\n---- INFO ----\n -> cmd: [" << buffer << "]\n -> flags: [" << pckt.flags << "]\n -> Payload count: [" << pckt.p_count << "]\n--------------\n";
+void rfs::stream_t::finish() noexcept {
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_fin = true;
+    m_cv.notify_all();
 }
 
-void rfs::print_payload(const payload_t& pyld) const noexcept {
-    std::cout << "\n---- PAYLOAD ----\n -> index : [" << pyld.header.index << "]\n -> size : [" << pyld.header.size << "]\n -> payload : [";
-    std::string stream = "";
-    for(int i = 0; i < CFG_PAYLOAD_SIZE; i++) {
-        stream += pyld.payload[i];
-    }
-    std::cout << stream.c_str();
-    std::cout << "]\n-----------------\n";
+void rfs::stream_t::abort() noexcept {
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_abort = true;
+    m_chunks.clear();
+    m_queued = 0;
+    m_full = false;
+    m_cv.notify_all();
 }
 
-std::shared_ptr<char[]> rfs::generate_hash() noexcept {
-    std::shared_ptr<char[]> hash = std::shared_ptr<char[]>(new char[CFG_PACKET_HASH_SIZE]);
+void rfs::stream_t::wait_room() noexcept {
+    std::unique_lock<std::mutex> lock(m_lock);
+    m_cv.wait(lock, [this] { return !m_full || m_abort; });
+}
 
+bool rfs::stream_t::full() noexcept {
+    std::lock_guard<std::mutex> lock(m_lock);
+    return m_full;
+}
 
-    for(int i = 0; i < CFG_PACKET_HASH_SIZE; i++) {
-        int r = rand() % 122 + 36;
-        hash[i] = (char)r;
-    }
-    return hash;
+bool rfs::stream_t::aborted() noexcept {
+    std::lock_guard<std::mutex> lock(m_lock);
+    return m_abort;
 }
@@ -1,9 +1,12 @@
 #include"../include/server.h"
 #include <memory>
+#include <algorithm>
+#include <shared_mutex>
 
 using namespace VFS::RFS;
 
 extern void remote_interpret_cmd(VFS::vfs::system_cmd& cmd, std::vector<std::string>& args, char*& payload, uint64_t size, int8_t options = 0) noexcept;
+extern std::shared_lock<std::shared_mutex> remote_share_sys() noexcept;
 
 server::server() {
     if(PORT_RANGE(CFG_DEFAULT_PORT)) {
@@ -11,10 +14,11 @@ server::server() {
     }
 
     conn = std::make_unique<server::connect_t>();
-    clients = std::make_unique<std::vector<std::pair<uint32_t, client_t*>>>();
+    shards = std::make_unique<shard_t[]>(CFG_SERVER_SHARDS);
+    workers = std::make_unique<pool>(CFG_SERVER_WORKERS);
 
     conn->m_port     = CFG_DEFAULT_PORT;
-    info.max_usr_c  = CFG_SOCK_LISTEN_AMT;
+    info.max_usr_c  = CFG_SERVER_MAX_CLIENTS;
     this->set_state(CFG_SOCK_OPEN);
 
     init();
@@ -22,19 +26,27 @@ server::server() {
 
 server::~server() {
     this->set_state(CFG_SOCK_CLOSE);
-    BUFFER << LOG_str(log::INFO, "Socket has been closed off for conntection");
 
-    while(info.users_c) {
-        sleep(1);
-    }
+    // wakes the reactor straight away rather than waiting on its timeout.
+    uint64_t val = 1;
+    write(conn->m_event_fd, &val, sizeof(val));
+    run_.join();
+
+    workers.reset();
+    close(conn->m_event_fd);
+    close(conn->m_epoll_fd);
+    BUFFER << LOG_str(log::INFO, "Socket has been closed off for conntection");
 }
 
 void server::init() noexcept {
     BUFFER << "\n-------  server  ------\n";
+    raise_fd_limit();
     define_fd();
     set_sockopt();
     bind_sock();
     mark_listener();
+    bind_local();
+    define_reactor();
 
     char str[10];
     sprintf(str, "%d", conn->m_port);
@@ -42,11 +54,26 @@ void server::init() noexcept {
     BUFFER << LOG_str(log::SERVER, "server has been initialised: [Port : " + std::string(str) + "]");
     BUFFER << "---------  End  -------\n";
     this->run_ = std::thread(&server::run, this);
-    this->run_.detach();
+}
+
+void server::raise_fd_limit() noexcept {
+    rlimit lim{};
+    getrlimit(RLIMIT_NOFILE, &lim);
+
+    // every client holds a descriptor, leave headroom for disks and the reactor.
+    rlim_t want = (rlim_t)CFG_SERVER_MAX_CLIENTS + 64;
+    if(lim.rlim_cur >= want)
+        return;
+
+    lim.rlim_cur = std::min(want, lim.rlim_max);
+    setrlimit(RLIMIT_NOFILE, &lim);
+
+    if(lim.rlim_cur < want)
+        BUFFER << LOG_str(log::WARNING, "Descriptor limit is " + std::to_string(lim.rlim_cur) + ", server may not reach its client limit");
 }
 
 void server::define_fd() noexcept {
-    if((conn->m_socket_fd = socket(AF_INET, SOCK_STREAM, 0)) == -1) {
+    if((conn->m_socket_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0)) == -1) {
         LOG(log::ERROR_, "Socket couldnt be created");
     } else BUFFER << LOG_str(log::SERVER, "Socket[Socket Stream] has been created");
 }
@@ -80,211 +107,441 @@ void server::mark_listener() noexcept {
     } else BUFFER << LOG_str(log::SERVER, "Socket is set for listening");
 }
 
-void server::run() noexcept {
-    int master_sock = conn->m_socket_fd;
-    uint32_t socket;
-    sockaddr_in client{};
-    socklen_t clientSize = sizeof(client);
+void server::bind_local() noexcept {
+    // clients on the same host can skip tcp, over a unix socket or rings in memory handed out on one.
+    conn->m_unix_fd = listen_local(transport::UNIX);
+    conn->m_shm_fd = listen_local(transport::SHM);
+
+    if(conn->m_unix_fd != -1 && conn->m_shm_fd != -1)
+        BUFFER << LOG_str(log::SERVER, "Local sockets are listening at: " + transport::path(transport::UNIX, conn->m_port) + ", " + transport::path(transport::SHM, conn->m_port));
+}
+
+int server::listen_local(transport::kind_t kind) noexcept {
+    std::string path = transport::path(kind, conn->m_port);
+    sockaddr_un hint{};
+    int fd = -1;
+
+    hint.sun_family = AF_UNIX;
+    strncpy(hint.sun_path, path.c_str(), sizeof(hint.sun_path) - 1);
+
+    // a socket file left behind by a server that didn't shut down cleanly is taken over.
+    unlink(path.c_str());
+
+    if((fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0)) == -1 || bind(fd, (sockaddr*)&hint, sizeof(hint)) == -1 || listen(fd, CFG_SOCK_LISTEN_AMT) == -1) {
+        BUFFER << LOG_str(log::WARNING, "Local socket could not be set up at: " + path);
+        if(fd != -1)
+            close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+void server::define_reactor() noexcept {
+    epoll_event ev{};
+
+    if((conn->m_epoll_fd = epoll_create1(0)) == -1 || (conn->m_event_fd = eventfd(0, EFD_NONBLOCK)) == -1) {
+        LOG(log::ERROR_, "Reactor could not be created");
+    }
+
+    ev.events = EPOLLIN | EPOLLET;
+    ev.data.u64 = LISTEN_ID;
+    epoll_ctl(conn->m_epoll_fd, EPOLL_CTL_ADD, conn->m_socket_fd, &ev);
+
+    ev.events = EPOLLIN;
+    ev.data.u64 = WAKE_ID;
+    epoll_ctl(conn->m_epoll_fd, EPOLL_CTL_ADD, conn->m_event_fd, &ev);
 
-    fd_set master_set;
-    struct timeval tv{};
+    for(auto [fd, id] : {std::make_pair(conn->m_unix_fd, UNIX_ID), std::make_pair(conn->m_shm_fd, SHM_ID)}) {
+        if(fd == -1)
+            continue;
 
+        ev.events = EPOLLIN | EPOLLET;
+        ev.data.u64 = id;
+        epoll_ctl(conn->m_epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+    }
+
+    BUFFER << LOG_str(log::SERVER, "Reactor is set with " + std::to_string(workers->size()) + " workers");
+}
+
+void server::run() noexcept {
+    epoll_event events[CFG_SERVER_EVENTS];
+
+    // heartbeats and deadlines live on the timer wheel, the reactor only wakes up for io.
     while(info.state == CFG_SOCK_OPEN) {
-        FD_ZERO(&master_set);
-        FD_SET(conn->m_socket_fd, &master_set);
-        tv.tv_sec = SOCKET_ACCEPT_TIME;
-        
-        select(master_sock + 1, &master_set, nullptr, nullptr, &tv);
-        
-        if(FD_ISSET(master_sock, &master_set)) {
-            if((socket = accept(master_sock,(sockaddr *)&client,&clientSize)) == -1) {
-                BUFFER << LOG_str(log::WARNING, "client socket has failed to join");
+        int amt = epoll_wait(conn->m_epoll_fd, events, CFG_SERVER_EVENTS, -1);
+
+        for(int i = 0; i < amt; i++) {
+            uint64_t id = events[i].data.u64;
+
+            if(id == WAKE_ID) {
+                uint64_t val;
+                read(conn->m_event_fd, &val, sizeof(val));
+
+                if(info.state != CFG_SOCK_OPEN)
+                    break;
+
+                // streams that drained below their window, their clients are read again.
+                std::vector<uint64_t> ids;
+                m_resume.lock();
+                ids.swap(resumed);
+                m_resume.unlock();
+
+                for(uint64_t rid : ids) {
+                    std::shared_ptr<client_t> client = find_client(rid);
+                    if(!client || !client->paused)
+                        continue;
+
+                    client->paused = false;
+                    read_client(client);
+
+                    if(client->state == CFG_SOCK_CLOSE)
+                        remove_client(rid);
+                }
                 continue;
             }
 
-            if(info.users_c == info.max_usr_c) {
-                BUFFER << LOG_str(log::WARNING, "client: [" + find_ip(client) + "] has tried to join, server is full");
-                close(socket);
+            if(id == LISTEN_ID || id == UNIX_ID || id == SHM_ID) {
+                accept_clients(id);
                 continue;
             }
 
-            info.users_c++;
-            add_client(socket, client);
-            BUFFER << LOG_str(log::SERVER, "client: [" + find_ip(client) + "] has joined");
+            std::shared_ptr<client_t> client = find_client(id);
+            if(!client)
+                continue;
+
+            if(events[i].events & EPOLLIN)
+                read_client(client);
+
+            if(client->state == CFG_SOCK_CLOSE || (events[i].events & (EPOLLHUP | EPOLLERR | EPOLLRDHUP)))
+                remove_client(id);
         }
     }
-    close(master_sock);
+
+    std::vector<std::shared_ptr<client_t>> all;
+    snapshot_clients(all);
+
+    for(auto& client : all)
+        remove_client(client->id);
+
+    close(conn->m_socket_fd);
+    for(auto [fd, kind] : {std::make_pair(conn->m_unix_fd, transport::UNIX), std::make_pair(conn->m_shm_fd, transport::SHM)}) {
+        if(fd == -1)
+            continue;
+
+        close(fd);
+        unlink(transport::path(kind, conn->m_port).c_str());
+    }
 }
 
-void server::add_client(const uint32_t& sock, const sockaddr_in& hint) noexcept {
+void server::accept_clients(uint64_t listener) noexcept {
+    int fd = listener == LISTEN_ID ? conn->m_socket_fd : (listener == UNIX_ID ? conn->m_unix_fd : conn->m_shm_fd);
+    sockaddr_in client{};
+    socklen_t clientSize = sizeof(client);
+    int socket;
+
+    // edge triggered, so the backlog is drained until accept would block.
+    while((socket = accept4(fd, (sockaddr*)&client, &clientSize, SOCK_NONBLOCK)) != -1) {
+        std::string ip = listener == LISTEN_ID ? find_ip(client) : (listener == UNIX_ID ? "unix" : "shm");
+        std::unique_ptr<transport> link = nullptr;
+        clientSize = sizeof(client);
+
+        if(info.users_c >= info.max_usr_c) {
+            BUFFER << LOG_str(log::WARNING, "client: [" + ip + "] has tried to join, server is full");
+            close(socket);
+            continue;
+        }
+
+        if(listener == SHM_ID)
+            link = shm_transport::offer(socket, CFG_SHM_RING_SIZE);
+        else link = std::make_unique<sock_transport>(socket, listener == UNIX_ID ? transport::UNIX : transport::TCP);
+
+        if(link == nullptr) {
+            BUFFER << LOG_str(log::WARNING, "client: [" + ip + "] could not be given shared memory");
+            continue;
+        }
+
+        info.users_c++;
+        add_client(std::move(link), ip);
+        BUFFER << LOG_str(log::SERVER, "client: [" + ip + "] has joined");
+    }
+
+    if(errno == EMFILE || errno == ENFILE)
+        BUFFER << LOG_str(log::WARNING, "Out of descriptors, pending clients wait in the backlog");
+}
+
+void server::add_client(std::unique_ptr<transport> link, const std::string& ip) noexcept {
     std::shared_ptr<client_t> tmp = std::shared_ptr<client_t>(new client_t);
 
-    tmp->sock_fd = (int)sock;
-    tmp->hint = hint;
-    tmp->ip = find_ip(tmp->hint).c_str();
+    tmp->id = info.next_id++;
+    tmp->link = std::move(link);
+    tmp->ip = ip;
     tmp->state = CFG_SOCK_OPEN;
-    set_recieved_ping(*tmp, 1);
+    tmp->last_rx = tmp->last_tx = timer_wheel::now();
 
-    clients->push_back(std::make_pair(clients->size(), tmp.get()));
-    tmp->thrd = std::thread(&server::handle, this, tmp);
-    tmp->thrd.detach();
+    uint64_t id = tmp->id;
+    tmp->beat = timer_wheel::get_wheel().schedule_every(CFG_HEARTBEAT_INTERVAL, [this, id] { heartbeat(id); });
+    tmp->hello_deadline = timer_wheel::get_wheel().schedule(CFG_HELLO_TIMEOUT, [this, id] { check_hello(id); });
 
-    #if !defined _DEBUG_
-    tmp->ping = std::thread(&server::ping, this, (tmp));
-    tmp->ping.detach();
-    #endif
-    
+    shard_t& shard = shard_of(tmp->id);
+    shard.m_lock.lock();
+    shard.clients[tmp->id] = tmp;
+    shard.m_lock.unlock();
+
+    tmp->link->watch(conn->m_epoll_fd, tmp->id);
+}
+
+void server::greet(const std::shared_ptr<client_t>& client) noexcept {
+    session_t::scope view(*client->view);
+    buffer::scope out(client->out);
     BUFFER.hold_buffer();
 
     BUFFER << "\r";
     if(vfs::get_vfs()->is_mnted()) {
+        auto lock = remote_share_sys();
         BUFFER << LOG_str(log::INFO, "rfs has a mounted disk");
         ((VFS::IFS::fat32*)vfs::get_vfs()->get_mnted_system()->mp_fs.get())->print_super_block();
     } else BUFFER << LOG_str(log::INFO, "rfs has no mounted disk");
-    
+
     BUFFER << "\n";
 
-    send_to_client(*tmp, type_t::internal);
+    send_to_client(*client, type_t::internal, 0);
     BUFFER.release_buffer();
 }
 
-void server::handle(const std::shared_ptr<client_t>& client) noexcept {
-    while(info.state == CFG_SOCK_OPEN && client->state == CFG_SOCK_OPEN) {
-        receive(*client);
+void server::join_session(client_t& client) noexcept {
+    std::lock_guard<std::mutex> lock(m_sessions);
+
+    // a client from before session tokens gets a session to itself.
+    if(client.session == 0) {
+        client.view = std::make_shared<session_t>();
+        return;
+    }
+
+    // sessions are dropped with their last connection, what they leave in the map is swept now and then.
+    if(sessions.size() > 2 * (size_t)info.users_c + 16) {
+        for(auto it = sessions.begin(); it != sessions.end();)
+            it = it->second.expired() ? sessions.erase(it) : std::next(it);
+    }
+
+    std::weak_ptr<session_t>& slot = sessions[client.session];
+    if((client.view = slot.lock()) == nullptr) {
+        client.view = std::make_shared<session_t>();
+        slot = client.view;
     }
-    BUFFER << LOG_str(log::SERVER, "client [" + find_ip(client->hint) + "] disconnected");
-    remove_client(client.get());
 }
 
+void server::send_hello(client_t& client) noexcept {
+    char body[HELLO_SIZE];
+    size_t size = {};
+    hello_body(body, size, CFG_RFS_CAPS, 0, 0);
+
+    std::lock_guard<std::mutex> lock(client.m_send);
+    for_each_frame((int8_t)type_t::hello, 0, std::string(CFG_PACKET_SIGNATURE, CFG_PACKET_SIGNATURE_SIZE), body, size, client.max_frame, 0,
+        [&](const char* header, size_t header_size, const char* data, uint64_t data_size) {
+            iovec iov[2] = {{(void*)header, header_size}, {(void*)data, data_size}};
+            send(client, iov, data_size ? 2 : 1);
+        });
+}
 
-void server::remove_client(client_t* client) noexcept {
-    for(auto it = clients->begin(); it != clients->end(); it++) {
-        if(it->second->sock_fd == client->sock_fd) {
-            clients->erase(it);
-            break;
-        }
+server::shard_t& server::shard_of(uint64_t id) noexcept {
+    return shards[id % CFG_SERVER_SHARDS];
+}
+
+std::shared_ptr<server::client_t> server::find_client(uint64_t id) noexcept {
+    shard_t& shard = shard_of(id);
+    std::lock_guard<std::mutex> lock(shard.m_lock);
+
+    auto it = shard.clients.find(id);
+    return it == shard.clients.end() ? nullptr : it->second;
+}
+
+void server::snapshot_clients(std::vector<std::shared_ptr<client_t>>& store) noexcept {
+    store.reserve(info.users_c);
+
+    for(size_t i = 0; i < CFG_SERVER_SHARDS; i++) {
+        std::lock_guard<std::mutex> lock(shards[i].m_lock);
+
+        for(auto& it : shards[i].clients)
+            store.push_back(it.second);
+    }
+}
+
+void server::remove_client(uint64_t id) noexcept {
+    std::shared_ptr<client_t> client;
+    shard_t& shard = shard_of(id);
+    {
+        std::lock_guard<std::mutex> lock(shard.m_lock);
+        auto it = shard.clients.find(id);
+
+        if(it == shard.clients.end())
+            return;
+
+        client = std::move(it->second);
+        shard.clients.erase(it);
     }
+
+    timer_wheel::get_wheel().cancel(client->beat);
+    timer_wheel::get_wheel().cancel(client->hello_deadline);
+
+    // workers still feeding streams into the disk get let go.
+    for(auto& it : client->reader.pending) {
+        if(it.second->stream)
+            it.second->stream->abort();
+    }
+
+    // the socket itself is closed once the last worker holding the client lets go of it.
+    client->link->unwatch(conn->m_epoll_fd);
+    client->link->shutdown();
+    set_state(*client, CFG_SOCK_CLOSE);
+    drop_transfers(*client);
+
+    BUFFER << LOG_str(log::SERVER, "client [" + client->ip + "] disconnected");
     info.users_c--;
 }
 
-void server::receive(client_t& client) noexcept {
-    fd_set master_set;
-    struct timeval tv{};
-
-    FD_ZERO(&master_set);
-    FD_SET(client.sock_fd, &master_set);
-    tv.tv_sec = SOCKET_ACCEPT_TIME;
-
-    select(client.sock_fd + 1, &master_set, nullptr, nullptr, &tv);
-        
-    if(FD_ISSET(client.sock_fd, &master_set)) {
-        int val = 0;
-        char buffer[BUFFER_SIZE];
-        memset(buffer, 0, BUFFER_SIZE);
-        // declare container to store info and payload packets.
-        std::shared_ptr<pcontainer_t> container =  std::shared_ptr<pcontainer_t>(new pcontainer_t);
-        // recv info packet and store it within the container info address.
-        recv_(buffer, client, sizeof(packet_t));
-        // deserialize packet.
-        deserialize_packet(container->info, buffer);
-
-        if(container->info.cmd == (int8_t)type_t::ping) {
-            set_recieved_ping(client, 1);
+void server::read_client(const std::shared_ptr<client_t>& client) noexcept {
+    char buffer[KB(64)];
+
+    // input is parsed as it comes in, so a full stream window stops the reads straight away.
+    while(!client->paused && client->state == CFG_SOCK_OPEN) {
+        ssize_t bytes = client->link->recv(buffer, sizeof(buffer));
+
+        if(bytes == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
             return;
-        }
 
-        if(process_packet(container->info) == 0) {
-            set_state(client, CFG_SOCK_CLOSE);
+        if(bytes <= 0) {
+            set_state(*client, CFG_SOCK_CLOSE);
             return;
         }
+        client->reader.rx.insert(client->reader.rx.end(), buffer, buffer + bytes);
 
-        // check whether info has any payload.
-        if(container->info.p_count > 0) {
-            m_ping.lock();
-            #if _DEBUG_
-                LOG(log::INFO, "Ping stopped");
-            #endif
-            payload_t tmp;
-            // check whether first payload has any mf flag set to 0x1 and then the last 0x0.
-            for(int i = 0; i < container->info.p_count; i++) {
-                // reset buffer array.
-                memset(buffer, 0, BUFFER_SIZE);
-                memset(tmp.payload, 0, CFG_PAYLOAD_SIZE);
-                // recv a payload
-                recv_(buffer, client, sizeof(payload_t));
-
-                deserialize_payload(tmp, buffer);
-
-                if(process_payload(container->info, tmp) == 0) {
-                    set_state(client, CFG_SOCK_CLOSE);
-                    return;
-                }
+        // any traffic counts as a heartbeat, a long upload doesn't leave room for pings.
+        client->last_rx = timer_wheel::now();
+        parse_input(client);
+    }
+}
+
+void server::parse_input(const std::shared_ptr<client_t>& client) noexcept {
+    std::vector<std::shared_ptr<message_t>> msgs;
 
-                container->payloads->push_back(tmp);
+    if(read_frames(client->reader, msgs, CFG_FRAME_MAX_SIZE, CFG_RFS_REQUEST_MAX_SIZE, client->caps) == 0) {
+        BUFFER << LOG_str(log::WARNING, "client: [" + client->ip + "] sent a malformed frame");
+        set_state(*client, CFG_SOCK_CLOSE);
+        return;
+    }
+
+    for(auto& msg : msgs) {
+        if(msg->cmd == (int8_t)type_t::ping)
+            continue;
+
+        // the first message has to be a hello, it settles the frame size and capabilities for the connection.
+        if(!client->said_hello) {
+            hello_t hello;
+            if(process_hello(*msg, hello) == 0) {
+                BUFFER << LOG_str(log::WARNING, "client: [" + client->ip + "] did not say hello");
+                set_state(*client, CFG_SOCK_CLOSE);
+                return;
             }
-            m_ping.unlock();
-            #if _DEBUG_
-                LOG(log::INFO, "Ping started");
-            #endif
+            client->max_frame = hello.max_frame;
+            client->caps = hello.caps;
+            client->session = hello.session;
+            client->lane = hello.lane;
+            client->said_hello = true;
+            join_session(*client);
         }
 
-        std::thread handle_data = std::thread(&server::interpret_input, this, container, (client_t*)&client);
-        handle_data.detach();
+        if(msg->stream) {
+            uint64_t id = client->id;
+            msg->stream->on_drain = [this, id] { resume(id); };
+        }
+        dispatch(client, msg);
+    }
+
+    for(auto& it : client->reader.pending) {
+        if(it.second->stream && it.second->stream->full())
+            client->paused = true;
     }
+
+    // idle connections shouldn't keep the space a large upload needed.
+    std::vector<char>& rx = client->reader.rx;
+    if(rx.empty() && rx.capacity() > CFG_SOCK_RX_RETAIN_SIZE)
+        std::vector<char>().swap(rx);
 }
 
-void server::send_to_client(client_t& client, type_t cmd, const std::string& ext_filename) noexcept {
-    uint64_t buffer_size = BUFFER.mStream->size();
+void server::dispatch(const std::shared_ptr<client_t>& client, std::shared_ptr<message_t> msg) noexcept {
+    if(is_transfer(*msg)) {
+        workers->submit([this, client, msg] { transfer(client, msg); });
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(client->m_queue);
+    client->queue.push_back(std::move(msg));
 
-    if(buffer_size == 0)
+    if(client->running)
         return;
 
-    std::shared_ptr<std::byte[]> stream;
-    BUFFER.retain_buffer(stream);
-    stream[buffer_size - 1] = std::byte{0};
-
-    std::vector<std::string> flags;
-    std::unique_ptr<pcontainer_t> container = nullptr;
-
-    if(cmd == type_t::external)
-        flags.emplace_back(ext_filename);
-
-    char buffer[BUFFER_SIZE];
-    memset(buffer, 0, BUFFER_SIZE);
-    container = generate_container((int8_t)cmd, flags, stream, buffer_size);
-    serialize_packet(container->info, buffer);
-    send(buffer, client, sizeof(packet_t));
-
-    if(container->info.p_count > 0) {
-        m_ping.lock();
-        #if _DEBUG_
-        LOG(log::INFO, "Ping stopped");
-        #endif
-        for(int i = 0; i < container->info.p_count; i++) {
-            memset(buffer, 0, BUFFER_SIZE);
-            serialize_payload(container->payloads->at(i), buffer);
-            send(buffer, client, sizeof(payload_t));
+    client->running = true;
+    workers->submit([this, client] { drain(client); });
+}
+
+void server::drain(const std::shared_ptr<client_t>& client) noexcept {
+    while(1) {
+        std::shared_ptr<message_t> msg;
+        {
+            std::lock_guard<std::mutex> lock(client->m_queue);
+
+            if(client->queue.empty() || client->state == CFG_SOCK_CLOSE) {
+                client->queue.clear();
+                client->running = false;
+                return;
+            }
+            msg = client->queue.front();
+            client->queue.pop_front();
+        }
+
+        // lanes only carry part of a transfer, the user already got a greeting on their connection.
+        if(msg->cmd == (int8_t)type_t::hello) {
+            send_hello(*client);
+            if(client->lane == 0)
+                greet(client);
+            continue;
         }
-        m_ping.unlock();
-        #if _DEBUG_
-            LOG(log::INFO, "Ping started");
-        #endif
+        interpret_input(msg, client.get());
     }
+}
 
-    BUFFER.release_buffer();
+void server::send_to_client(client_t& client, type_t cmd, uint64_t id, const std::string& ext_filename) noexcept {
+    uint64_t buffer_size = BUFFER.size();
+
+    // every request gets a reply, even an empty one, so the client knows it's done.
+    if(buffer_size == 0 && id == 0)
+        return;
+
+    std::string args = (cmd == type_t::external) ? ext_filename : "";
+
+    // frames go out straight from the session's arena. the lock is held a frame at a
+    // time, so replies to other requests can go out in between.
+    for_each_frame((int8_t)cmd, id, args, BUFFER.data(), buffer_size, client.max_frame, client.caps,
+        [&](const char* header, size_t header_size, const char* data, uint64_t data_size) {
+            iovec iov[2] = {{(void*)header, header_size}, {(void*)data, data_size}};
+            std::lock_guard<std::mutex> lock(client.m_send);
+            send(client, iov, data_size ? 2 : 1);
+        });
+
+    BUFFER.clear();
 }
 
-void server::interpret_input(const std::shared_ptr<pcontainer_t>& container, client_t* client) noexcept {
+void server::interpret_input(const std::shared_ptr<message_t>& msg, client_t* client) noexcept {
+    // output is collected in the client's own sink, so sessions don't serialize on the console.
+    session_t::scope view(*client->view);
+    buffer::scope out(client->out);
     BUFFER.hold_buffer();
 
-    std::vector<std::string> args = lib_::split(container->info.flags, ' ');
-    auto cmd = (vfs::system_cmd)container->info.cmd;
+    std::vector<std::string> args = lib_::split(msg->args.c_str(), ' ');
+    auto cmd = (vfs::system_cmd)msg->cmd;
 
-    std::shared_ptr<char[]> payload = nullptr;
-    uint64_t size = {};
-    if(container->info.p_count != 0) {
-        size = retain_payloads(payload, *container->payloads);
-    }
+    char* payload = msg->data.empty() ? nullptr : msg->data.data();
+    uint64_t size = msg->data.size();
 
     type_t dest = internal;
     if(!args.empty())
@@ -292,52 +549,291 @@ void server::interpret_input(const std::shared_ptr<pcontainer_t>& container, cli
     int8_t exportData = (dest == type_t::external) ? 1 : 0;
 
     std::string ext_filename = (dest == external) ? args[args.size() - 1] : "";
-    remote_interpret_cmd(cmd, args, (char*&)payload, size, exportData);
-    send_to_client(*client, dest, ext_filename);
+    remote_interpret_cmd(cmd, args, payload, size, exportData);
+    send_to_client(*client, dest, msg->id, ext_filename);
 
     #if _DEBUG_
-        print_packet(container->info);
-        for(int i = 0; i < container->payloads->size(); i++) {
-            print_payload(container->payloads->at(i));
-        }
+        print_message(*msg);
     #endif // _DEBUG_
-    
+
+    BUFFER.release_buffer();
+}
+
+bool server::is_transfer(const message_t& msg) const noexcept {
+    if(msg.stream)
+        return true;
+
+    std::vector<std::string> args = lib_::split(msg.args.c_str(), ' ');
+    return (vfs::system_cmd)msg.cmd == vfs::system_cmd::cp && (args.size() == 3 || args.size() == 5) && args[0] == "exp";
+}
+
+void server::transfer(const std::shared_ptr<client_t>& client, const std::shared_ptr<message_t>& msg) noexcept {
+    // runs next to the client's queue, so it writes into a sink of its own.
+    session_t::scope view(*client->view);
+    buffer out(false, CFG_SESSION_RETAIN_SIZE);
+    buffer::scope scope(out);
+    BUFFER.hold_buffer();
+
+    // file transfers move through a bounded window rather than whole in memory.
+    if(msg->stream)
+        stream_in(msg, client.get());
+    else stream_out(lib_::split(msg->args.c_str(), ' '), msg->id, client.get());
+
+    send_to_client(*client, type_t::internal, msg->id);
     BUFFER.release_buffer();
 }
 
-void server::send(const char* buffer, client_t& client, size_t buffer_size) noexcept {
-    m_send.lock();
-    int number_of_bytes = {};
-    size_t bytes_sent = {};
+VFS::IFS::fat32* server::mnted_fs() noexcept {
+    if(!vfs::get_vfs()->is_mnted()) {
+        BUFFER << LOG_str(log::WARNING, "Please mount a system before carrying out a sys call");
+        return nullptr;
+    }
+    return dynamic_cast<IFS::fat32*>(vfs::get_vfs()->get_mnted_system()->mp_fs.get());
+}
+
+void server::resume(uint64_t id) noexcept {
+    m_resume.lock();
+    resumed.push_back(id);
+    m_resume.unlock();
+
+    uint64_t val = 1;
+    write(conn->m_event_fd, &val, sizeof(val));
+}
+
+void server::stream_in(const std::shared_ptr<message_t>& msg, client_t* client) noexcept {
+    // cp imp <src> <dst>, dst is written chunk by chunk as the frames come in. a file split over
+    // lanes comes as cp imp <src> <dst> <offset> <size> <parts>, a range of it on each lane.
+    std::vector<std::string> args = lib_::split(msg->args.c_str(), ' ');
+    std::shared_ptr<transfer_t> transfer = nullptr;
+    IFS::fat32* fs = nullptr;
+    uint64_t offset = {}, written = {};
+    int fd = -1;
+
+    if(args.size() == 6) {
+        if((transfer = join_transfer(client, args)) != nullptr) {
+            fs = transfer->fs;
+            fd = transfer->fd;
+            offset = strtoull(args[3].c_str(), nullptr, 10);
+        }
+    } else {
+        auto lock = remote_share_sys();
+        if(args.size() == 3 && (fs = mnted_fs()) != nullptr)
+            fd = fs->open(args[2].c_str(), O_CREAT | O_TRUNC | O_WRONLY);
+    }
+
+    // the chunks are still drained on failure, the client keeps sending until it's done.
+    std::vector<char> chunk;
+    while(msg->stream->pop(chunk)) {
+        if(fd == -1)
+            continue;
+
+        auto lock = remote_share_sys();
+        int64_t amt = transfer ? fs->pwrite(fd, chunk.data(), chunk.size(), offset + written) : fs->write(fd, chunk.data(), chunk.size());
+        written += std::max<int64_t>(amt, 0);
+    }
+
+    if(transfer) {
+        leave_transfer(client, transfer, fd != -1 && written == msg->total);
+        return;
+    }
+
+    if(fd == -1)
+        return;
+
+    auto lock = remote_share_sys();
+    fs->close(fd);
+
+    // a stream the client cut short is emptied like a range that never came.
+    if(written != msg->total) {
+        if((fd = fs->open(args[2].c_str(), O_TRUNC | O_WRONLY)) != -1)
+            fs->close(fd);
+        BUFFER << LOG_str(log::WARNING, "file: [" + args[2] + "] did not arrive whole, it has been emptied");
+    }
+}
+
+std::shared_ptr<server::transfer_t> server::join_transfer(client_t* client, const std::vector<std::string>& args) noexcept {
+    std::string key = std::to_string(client->session) + ":" + args[2];
+    uint64_t size = strtoull(args[4].c_str(), nullptr, 10);
+    uint64_t parts = std::max<uint64_t>(strtoull(args[5].c_str(), nullptr, 10), 1);
+
+    // a client already gone has had its transfers dropped, it can't start another.
+    std::lock_guard<std::mutex> lock(m_transfers);
+    if(client->state == CFG_SOCK_CLOSE)
+        return nullptr;
+
+    std::shared_ptr<transfer_t>& transfer = transfers[key];
+
+    // whichever lane gets here first creates the file, the rest write into the same handle.
+    if(transfer == nullptr) {
+        transfer = std::make_shared<transfer_t>();
+        transfer->dst = args[2];
+        transfer->size = size;
+        transfer->parts = transfer->left = parts;
+
+        auto sys_lock = remote_share_sys();
+        if((transfer->fs = mnted_fs()) != nullptr)
+            transfer->fd = transfer->fs->open(args[2].c_str(), O_CREAT | O_TRUNC | O_WRONLY);
+    } else if(transfer->size != size || transfer->parts != parts) {
+        BUFFER << LOG_str(log::WARNING, "client: [" + client->ip + "] sent a range of [" + args[2] + "] that doesn't match the rest of it");
+        return nullptr;
+    }
 
-    while(number_of_bytes < buffer_size && (bytes_sent = ::send(client.sock_fd, buffer, (buffer_size - number_of_bytes), MSG_NOSIGNAL))) {
-        number_of_bytes += bytes_sent;
-        buffer += bytes_sent;
+    // the ones it was in that have finished since are let go of here.
+    std::vector<std::string>& joined = client->joined;
+    joined.erase(std::remove_if(joined.begin(), joined.end(), [&](const std::string& it) { return transfers.count(it) == 0; }), joined.end());
 
-        if(bytes_sent == -1) {
-            BUFFER << LOG_str(log::ERROR_, "Issue sending information back towards client");
-            m_send.unlock();
+    transfer->active++;
+    if(std::find(joined.begin(), joined.end(), key) == joined.end())
+        joined.push_back(key);
+    return transfer;
+}
+
+void server::leave_transfer(client_t* client, const std::shared_ptr<transfer_t>& transfer, bool done) noexcept {
+    {
+        std::lock_guard<std::mutex> lock(m_transfers);
+        transfer->failed |= !done;
+        transfer->active--;
+
+        if(--transfer->left > 0)
             return;
+
+        // one that was given up on is already out of the map, a new upload may have taken its key.
+        auto it = transfers.find(std::to_string(client->session) + ":" + transfer->dst);
+        if(it != transfers.end() && it->second == transfer)
+            transfers.erase(it);
+    }
+    end_transfer(transfer);
+}
+
+void server::end_transfer(const std::shared_ptr<transfer_t>& transfer) noexcept {
+    if(transfer->fd == -1)
+        return;
+
+    auto lock = remote_share_sys();
+    transfer->fs->close(transfer->fd);
+
+    // ranges that never arrived would hold whatever their clusters had before, the file is emptied instead.
+    if(transfer->failed) {
+        int fd = transfer->fs->open(transfer->dst.c_str(), O_TRUNC | O_WRONLY);
+        if(fd != -1)
+            transfer->fs->close(fd);
+        BUFFER << LOG_str(log::WARNING, "file: [" + transfer->dst + "] did not arrive whole, it has been emptied");
+    }
+}
+
+void server::drop_transfers(client_t& client) noexcept {
+    std::vector<std::shared_ptr<transfer_t>> ended;
+    {
+        std::lock_guard<std::mutex> lock(m_transfers);
+
+        // the ranges still missing won't come once a lane is gone, the lanes still writing finish it off.
+        for(const std::string& key : client.joined) {
+            auto it = transfers.find(key);
+            if(it == transfers.end())
+                continue;
+
+            std::shared_ptr<transfer_t> transfer = std::move(it->second);
+            transfers.erase(it);
+            transfer->failed = true;
+            transfer->left = transfer->active;
+
+            if(transfer->active == 0)
+                ended.push_back(std::move(transfer));
         }
+        client.joined.clear();
     }
-    m_send.unlock();
+
+    for(auto& transfer : ended)
+        workers->submit([this, transfer] { end_transfer(transfer); });
 }
 
-void server::recv_(char* buffer, client_t& client, size_t bytes) noexcept {
-    m_recieve.lock();
-    int number_of_bytes = {};
-    size_t bytes_received = {};
+void server::stream_out(const std::vector<std::string>& args, uint64_t id, client_t* client) noexcept {
+    // cp exp <src> <dst>, src is read a frame at a time and sent on as it's read. a large file
+    // is split, this sends the first range and the client asks for the rest on lanes of its own
+    // with cp exp <src> <dst> <part> <parts>.
+    IFS::fat32* fs = nullptr;
+    IFS::fat32::stat_t st;
+    int fd = -1;
+    {
+        auto lock = remote_share_sys();
+        if((fs = mnted_fs()) == nullptr || (fd = fs->open(args[1].c_str(), O_RDONLY)) == -1)
+            return;
+        fs->fstat(fd, st);
+    }
 
-    while(number_of_bytes < bytes && (bytes_received = recv(client.sock_fd, buffer, (bytes - number_of_bytes), MSG_NOSIGNAL)) > 0) {
-        number_of_bytes += bytes_received;
-        buffer += bytes_received;
+    uint64_t part = 0, parts = 1;
+    if(args.size() == 5) {
+        part = strtoull(args[3].c_str(), nullptr, 10);
+        parts = std::max<uint64_t>(strtoull(args[4].c_str(), nullptr, 10), 1);
+    } else if((client->caps & CAP_LANES) && st.size >= CFG_RFS_LANE_MIN_SIZE) {
+        parts = CFG_RFS_LANES;
+    }
+
+    uint64_t stripe = (st.size + parts - 1) / parts;
+    uint64_t begin = std::min(st.size, part * stripe);
+    uint64_t end = std::min(st.size, begin + stripe);
+
+    // a range says where it goes, <dst> <src> <offset> <size> <parts>.
+    std::string dst = args[2];
+    if(parts > 1)
+        dst += " " + args[1] + " " + std::to_string(begin) + " " + std::to_string(st.size) + " " + std::to_string(parts);
+
+    {
+        auto lock = remote_share_sys();
+        fs->lseek(fd, (int64_t)begin, SEEK_SET);
+    }
+
+    std::unique_ptr<char[]> window = std::unique_ptr<char[]>(new char[client->max_frame]);
+    bool cut = false;
+
+    // a read that comes up short ends the stream, the client drops what it got instead of keeping a hole.
+    stream_frames((int8_t)type_t::external, FRAME_STREAM, id, dst, end - begin, client->max_frame, client->caps,
+        [&](uint64_t, uint64_t size) {
+            auto lock = remote_share_sys();
+            cut = fs->read(fd, window.get(), size) != (int64_t)size;
+            return cut ? nullptr : (const char*)window.get();
+        },
+        [&](const char* header, size_t header_size, const char* data, uint64_t data_size) {
+            iovec iov[2] = {{(void*)header, header_size}, {(void*)data, data_size}};
+            std::lock_guard<std::mutex> send_lock(client->m_send);
+            send(*client, iov, data_size ? 2 : 1);
+        });
+
+    if(cut)
+        BUFFER << LOG_str(log::WARNING, "file: [" + args[1] + "] could not be read whole, its copy was cut short");
+
+    auto lock = remote_share_sys();
+    fs->close(fd);
+}
 
-        if(bytes_received == -1) {
-            *buffer = '\0';
-            BUFFER << LOG_str(log::ERROR_, "Issue receiving data from client");
+void server::send(client_t& client, iovec* iov, int iov_c, bool wait) noexcept {
+    bool started = false;
+
+    while(iov_c > 0 && client.state == CFG_SOCK_OPEN) {
+        ssize_t bytes_sent = client.link->send(iov, iov_c);
+
+        if(bytes_sent > 0) {
+            advance_iov(iov, iov_c, bytes_sent);
+            client.last_tx = timer_wheel::now();
+            started = true;
+            continue;
+        }
+
+        // a frame that can't start without waiting is dropped, once started it has to go out whole.
+        if(bytes_sent == -1 && (errno == EAGAIN || errno == EWOULDBLOCK) && !wait && !started)
+            return;
+
+        // the link never blocks, wait for room in its send queue.
+        if(bytes_sent == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            if(client.link->wait_send(CFG_SOCK_SEND_TIMEOUT))
+                continue;
         }
+
+        BUFFER << LOG_str(log::WARNING, "Issue sending information back towards client");
+        set_state(client, CFG_SOCK_CLOSE);
+        client.link->shutdown();
+        return;
     }
-    m_recieve.unlock();
 }
 
 std::string server::find_ip(const sockaddr_in& sock) const noexcept {
@@ -351,49 +847,51 @@ std::string server::find_ip(const sockaddr_in& sock) const noexcept {
     return std::string(buffer);
 }
 
-void server::ping(std::shared_ptr<client_t> client) noexcept {
-    int8_t unrecievedAmt = 0;
-
-    while(info.state == CFG_SOCK_OPEN && client->state == CFG_SOCK_OPEN) {
-        sleep(1);
-        if(client->recieved_ping == 1) {
-            m_ping.lock();
-            ping_client(client.get());
+void server::heartbeat(uint64_t id) noexcept {
+    std::shared_ptr<client_t> client = find_client(id);
+    uint64_t now = timer_wheel::now();
 
-            set_recieved_ping(*client, 0);
-            #if _DEBUG_
-                LOG(log::INFO, "Ping");
-            #endif
-            unrecievedAmt ^= unrecievedAmt;
-        } else unrecievedAmt++;
+    if(!client || client->state == CFG_SOCK_CLOSE)
+        return;
 
-        if(unrecievedAmt == 10) {
-            BUFFER << LOG_str(log::WARNING, "client has not replied towards ping, disconnecting..");
-            set_state(*client.get(), CFG_SOCK_CLOSE);
-        }
-        m_ping.unlock();
+    // the reactor sees the socket go down and removes the client.
+    if(now - client->last_rx >= (uint64_t)CFG_HEARTBEAT_INTERVAL * CFG_HEARTBEAT_MISS_AMT) {
+        BUFFER << LOG_str(log::WARNING, "client: [" + client->ip + "] has gone quiet, disconnecting..");
+        set_state(*client, CFG_SOCK_CLOSE);
+        client->link->shutdown();
+        return;
     }
-}
 
-void server::ping_client(client_t* client) noexcept {
-    std::string ping = "PING";
-    std::vector<std::string> flags;
+    // a ping only fills a gap in the traffic. a frame going out right now does the same job.
+    if(now - client->last_tx < (uint64_t)CFG_HEARTBEAT_INTERVAL / 2 || !client->m_send.try_lock())
+        return;
+
+    ping_client(client.get());
+    client->m_send.unlock();
+
+    #if _DEBUG_
+        LOG(log::INFO, "Ping");
+    #endif
+}
 
-    char buffer[BUFFER_SIZE];
-    memset(buffer, 0, BUFFER_SIZE);
+void server::check_hello(uint64_t id) noexcept {
+    std::shared_ptr<client_t> client = find_client(id);
 
-    std::shared_ptr<std::byte[]> bytes = std::shared_ptr<std::byte[]>(new std::byte[ping.length()]);
-    std::memcpy(bytes.get(), ping.data(), ping.length());
+    if(!client || client->said_hello)
+        return;
 
-    std::unique_ptr<pcontainer_t> container = generate_container((int8_t)type_t::ping, flags, bytes, ping.length());
-    serialize_packet(container->info, buffer);
-    send(buffer, *client, sizeof(packet_t));
+    BUFFER << LOG_str(log::WARNING, "client: [" + client->ip + "] did not say hello in time, disconnecting..");
+    set_state(*client, CFG_SOCK_CLOSE);
+    client->link->shutdown();
 }
 
-void server::set_recieved_ping(client_t& client, int8_t val) noexcept {
-    m_lock.lock();
-    client.recieved_ping = val;
-    m_lock.unlock();
+void server::ping_client(client_t* client) noexcept {
+    // the wheel never waits on a full socket, a client that stopped reading times out instead.
+    for_each_frame((int8_t)type_t::ping, 0, "", nullptr, 0, client->max_frame, client->caps,
+        [&](const char* header, size_t header_size, const char*, uint64_t) {
+            iovec iov = {(void*)header, header_size};
+            send(*client, &iov, 1, false);
+        });
 }
 
 void server::set_state(int8_t val) noexcept {
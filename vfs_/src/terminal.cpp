@@ -10,9 +10,15 @@ void remote_interpret_cmd(vfs::system_cmd& cmd, std::vector<std::string>& args,
     terminal::get_instance()->interpret_cmd(cmd, args, payload, size, options);
 }
 
+// held around each call a streamed transfer makes into the mounted system, it only keeps the mount
+// from changing under it. the system locks what it touches itself.
+std::shared_lock<std::shared_mutex> remote_share_sys() noexcept {
+    return std::shared_lock<std::shared_mutex>(terminal::get_instance()->get_sys_lock());
+}
+
 terminal::terminal() {
     m_vfs = vfs::get_vfs();
-    sys_lock = std::make_unique<std::mutex>();
+    sys_lock = std::make_unique<std::shared_mutex>();
     m_syscmds = std::make_shared<std::unordered_map<std::string, cmd_t>>();
     m_mnted_system = reinterpret_cast<vfs::system_t **>((*m_vfs).get_mnted_system().get());
 
@@ -65,6 +71,7 @@ void terminal::run() noexcept {
 void terminal::input(const char* line) noexcept {
     std::vector<std::string> args = lib_::split(line, SEPARATOR);
     vfs::system_cmd command = validate_cmd(args);
+    IFS::fat32::scope cwd(m_vfs->get_cwd());
 
     args.erase(args.begin()); // remove initial to retrieve only args
     interpret_cmd(command, args);
@@ -89,6 +96,10 @@ void terminal::interpret_cmd(vfs::system_cmd& cmd, std::vector<std::string>& arg
     (*this.*m_syscmds->find(vfs::syscmd_str[(int)cmd])->second.funct)(cmd, args, payload, size, options);
 }
 
+std::shared_mutex& terminal::get_sys_lock() noexcept {
+    return *sys_lock;
+}
+
 void terminal::translate_remote_cmd(vfs::system_cmd& cmd, std::vector<std::string>& args) noexcept {
     if(cmd == vfs::system_cmd::cp) {
         if(strcmp(args[0].c_str(), "imp") == 0) {
@@ -120,22 +131,26 @@ void terminal::clear_scr(vfs::system_cmd cmd, std::vector<std::string> args, cha
 }
 
 void terminal::map_vfs_funct(vfs::system_cmd cmd, std::vector<std::string> args, char*& payload, uint64_t size, int8_t options) noexcept {
-    sys_lock->lock();
     if(m_vfs->is_mnted() && strcmp(m_vfs->get_mnted_system()->fs_type, "rfs") == 0) {
-        sys_lock->unlock();
         map_sys_funct(cmd, args, payload, size);
-    } else m_vfs->control_vfs(args);
-    sys_lock->unlock();
+        return;
+    }
+
+    std::unique_lock<std::shared_mutex> lock(*sys_lock);
+    m_vfs->control_vfs(args);
 }
 
 void terminal::map_sys_funct(vfs::system_cmd cmd, std::vector<std::string> args, char*& payload, uint64_t size, int8_t options) noexcept {
-    if(!m_vfs->is_mnted()) {
+    std::shared_ptr<vfs::system_t> system = m_vfs->get_mnted_system();
+
+    if(system->mp_fs == nullptr) {
         BUFFER << LOG_str(log::WARNING, "Please mount a system before carrying out a sys call");
         return;
     }
-    sys_lock->lock();
-    (m_vfs->*m_vfs->get_mnted_system()->access)(cmd, args, payload, size, options);
-    sys_lock->unlock();
+
+    // the mounted system locks the directories a command touches, only mounting and unmounting run alone.
+    std::shared_lock<std::shared_mutex> lock(*sys_lock);
+    (m_vfs->*system->access)(cmd, args, payload, size, options);
 }
 
 
@@ -146,7 +161,8 @@ vfs::system_cmd terminal::valid_vfs(std::vector<std::string>& parts) noexcept {
     switch(lib_::hash(parts[1].c_str())) {
         case lib_::hash("ls"):     if(parts.size() > 2)                       return vfs::system_cmd::invalid; break;
         case lib_::hash("ifs"):    if(parts.size() != 4 && parts.size() != 5) return vfs::system_cmd::invalid; break;
-        case lib_::hash("rfs"):    if(parts.size() != 4 && parts.size() != 6) return vfs::system_cmd::invalid; break;
+        case lib_::hash("rfs"):    if(parts.size() != 3 && parts.size() != 4 && parts.size() != 6) return vfs::system_cmd::invalid;
+                                   if(parts.size() == 3 && parts[2] != "stats")                  return vfs::system_cmd::invalid; break;
         case lib_::hash("mnt"):    if(parts.size() != 3)                      return vfs::system_cmd::invalid; break;
         case lib_::hash("umnt"):   if(parts.size() != 2)                      return vfs::system_cmd::invalid; break;
         case lib_::hash("server"): if(parts.size() != 2 && parts.size() != 3) return vfs::system_cmd::invalid; break;
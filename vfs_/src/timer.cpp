@@ -0,0 +1,171 @@
+#include "../include/timer.h"
+#include <chrono>
+#include <algorithm>
+
+using namespace VFS;
+
+timer_wheel::timer_wheel(uint64_t tick_ms) : m_tick_ms(tick_ms), m_start(now()) {
+    m_thread = std::thread(&timer_wheel::run, this);
+}
+
+timer_wheel::~timer_wheel() {
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_stop = true;
+    }
+    m_cv.notify_all();
+    m_thread.join();
+}
+
+timer_wheel& timer_wheel::get_wheel() noexcept {
+    static timer_wheel wheel;
+    return wheel;
+}
+
+uint64_t timer_wheel::now() noexcept {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+uint64_t timer_wheel::schedule(uint64_t delay_ms, task_t task) noexcept {
+    return arm(delay_ms, 0, std::move(task));
+}
+
+uint64_t timer_wheel::schedule_every(uint64_t period_ms, task_t task) noexcept {
+    return arm(period_ms, period_ms, std::move(task));
+}
+
+void timer_wheel::cancel(uint64_t id) noexcept {
+    std::unique_lock<std::mutex> lock(m_lock);
+    m_timers.erase(id);
+
+    // once cancel returns the task won't run again, unless it's the task cancelling itself.
+    if(std::this_thread::get_id() != m_thread.get_id())
+        m_cv.wait(lock, [this, id] { return m_firing != id; });
+}
+
+size_t timer_wheel::size() noexcept {
+    std::lock_guard<std::mutex> lock(m_lock);
+    return m_timers.size();
+}
+
+uint64_t timer_wheel::arm(uint64_t delay_ms, uint64_t period_ms, task_t task) noexcept {
+    std::lock_guard<std::mutex> lock(m_lock);
+    uint64_t id = ++m_next_id;
+
+    // the wheel doesn't turn while nothing is armed, it catches up before placing the first timer.
+    if(m_timers.empty())
+        m_tick = std::max(m_tick, (now() - m_start) / m_tick_ms);
+
+    // rounded up, a timer never fires early.
+    uint64_t due = (now() - m_start + delay_ms + m_tick_ms - 1) / m_tick_ms;
+    uint64_t period = (period_ms + m_tick_ms - 1) / m_tick_ms;
+
+    m_timers[id] = timer_t{std::max(due, m_tick + 1), std::max<uint64_t>(period, period_ms ? 1 : 0), std::move(task)};
+    place(id, m_timers[id].due);
+    m_cv.notify_all();
+    return id;
+}
+
+void timer_wheel::place(uint64_t id, uint64_t due) noexcept {
+    uint64_t delta = due - m_tick;
+
+    for(size_t level = 0; level < LEVELS; level++) {
+        if(delta < ((uint64_t)1 << (SLOT_BITS * (level + 1)))) {
+            m_slots[level][(due >> (SLOT_BITS * level)) & (SLOTS - 1)].push_back(id);
+            return;
+        }
+    }
+
+    // past the top level, parked in the last slot it reaches and placed again from there.
+    size_t top = SLOT_BITS * (LEVELS - 1);
+    m_slots[LEVELS - 1][((m_tick >> top) - 1) & (SLOTS - 1)].push_back(id);
+}
+
+void timer_wheel::cascade(size_t level) noexcept {
+    size_t slot = (m_tick >> (SLOT_BITS * level)) & (SLOTS - 1);
+
+    if(slot == 0 && level + 1 < LEVELS)
+        cascade(level + 1);
+
+    std::vector<uint64_t> ids;
+    ids.swap(m_slots[level][slot]);
+
+    for(uint64_t id : ids) {
+        auto it = m_timers.find(id);
+        if(it != m_timers.end())
+            place(id, it->second.due);
+    }
+}
+
+void timer_wheel::advance(std::vector<std::pair<uint64_t, task_t>>& due) noexcept {
+    m_tick++;
+    size_t slot = m_tick & (SLOTS - 1);
+
+    if(slot == 0)
+        cascade(1);
+
+    std::vector<uint64_t> ids;
+    ids.swap(m_slots[0][slot]);
+
+    // ids of cancelled timers are left in their slots and skipped here.
+    for(uint64_t id : ids) {
+        auto it = m_timers.find(id);
+        if(it == m_timers.end())
+            continue;
+
+        if(it->second.due > m_tick) {
+            place(id, it->second.due);
+            continue;
+        }
+
+        if(it->second.period) {
+            due.emplace_back(id, it->second.task);
+        } else {
+            due.emplace_back(id, std::move(it->second.task));
+            m_timers.erase(it);
+        }
+    }
+}
+
+uint64_t timer_wheel::idle_ticks() const noexcept {
+    // the next busy slot on the bottom level, or the next cascade, whichever comes first.
+    for(uint64_t t = m_tick + 1; ; t++) {
+        if(!m_slots[0][t & (SLOTS - 1)].empty() || (t & (SLOTS - 1)) == 0)
+            return t - m_tick;
+    }
+}
+
+void timer_wheel::run() noexcept {
+    std::vector<std::pair<uint64_t, task_t>> due;
+    std::unique_lock<std::mutex> lock(m_lock);
+
+    while(!m_stop) {
+        uint64_t target = (now() - m_start) / m_tick_ms;
+
+        while(m_tick < target)
+            advance(due);
+
+        // tasks run without the lock, they are free to arm or cancel timers of their own.
+        for(auto& it : due) {
+            m_firing = it.first;
+            lock.unlock();
+            it.second();
+            lock.lock();
+            m_firing = 0;
+
+            auto timer = m_timers.find(it.first);
+            if(timer != m_timers.end()) {
+                timer->second.due = std::max(timer->second.due + timer->second.period, m_tick + 1);
+                place(it.first, timer->second.due);
+            }
+            m_cv.notify_all();
+        }
+        due.clear();
+
+        if(m_timers.empty()) {
+            m_cv.wait(lock, [this] { return m_stop || !m_timers.empty(); });
+            continue;
+        }
+        m_cv.wait_until(lock, std::chrono::steady_clock::time_point(std::chrono::milliseconds(m_start + (m_tick + idle_ticks()) * m_tick_ms)));
+    }
+}
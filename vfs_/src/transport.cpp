@@ -0,0 +1,344 @@
+#include "../include/transport.h"
+#include "../include/config.h"
+
+#include <poll.h>
+#include <fcntl.h>
+#include <algorithm>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/eventfd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+using namespace VFS::RFS;
+
+transport::addr_t transport::parse(const char* addr, uint32_t port) noexcept {
+    std::string str = addr;
+    addr_t ret = {};
+
+    for(auto [scheme, kind] : {std::make_pair("unix", UNIX), std::make_pair("shm", SHM)}) {
+        size_t len = strlen(scheme);
+
+        if(str.compare(0, len, scheme) != 0 || (str.size() > len && str[len] != ':'))
+            continue;
+
+        ret.kind = kind;
+        ret.host = str.size() > len + 1 ? str.substr(len + 1) : path(kind, port);
+        return ret;
+    }
+    ret.host = str;
+    return ret;
+}
+
+std::string transport::path(kind_t kind, uint32_t port) noexcept {
+    return std::string(CFG_LOCAL_SOCK_DIR) + "/mp_vfs." + std::to_string(port) + (kind == SHM ? ".shm" : ".sock");
+}
+
+sock_transport::sock_transport(int fd, kind_t kind) noexcept : fd(fd), m_kind(kind) {
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+    // frames are corked with MSG_MORE, so nagle would only delay the tail of a reply.
+    if(kind == TCP) {
+        int nodelay = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+    }
+}
+
+sock_transport::~sock_transport() {
+    close(fd);
+}
+
+ssize_t sock_transport::send(const iovec* iov, int iov_c) noexcept {
+    msghdr msg{};
+    msg.msg_iov = (iovec*)iov;
+    msg.msg_iovlen = iov_c;
+    return sendmsg(fd, &msg, MSG_NOSIGNAL);
+}
+
+ssize_t sock_transport::recv(char* buffer, size_t size) noexcept {
+    return ::recv(fd, buffer, size, 0);
+}
+
+bool sock_transport::wait_send(int timeout) noexcept {
+    pollfd pfd = {fd, POLLOUT, 0};
+    return poll(&pfd, 1, timeout) > 0;
+}
+
+bool sock_transport::wait_recv(int timeout) noexcept {
+    pollfd pfd = {fd, POLLIN, 0};
+    return poll(&pfd, 1, timeout) > 0;
+}
+
+void sock_transport::watch(int epoll_fd, uint64_t id) noexcept {
+    epoll_event ev{};
+    ev.events = EPOLLIN | EPOLLRDHUP | EPOLLET;
+    ev.data.u64 = id;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+}
+
+void sock_transport::unwatch(int epoll_fd) noexcept {
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+}
+
+void sock_transport::shutdown() noexcept {
+    ::shutdown(fd, SHUT_RDWR);
+}
+
+transport::kind_t sock_transport::kind() const noexcept {
+    return m_kind;
+}
+
+shm_transport::shm_transport(int sock_fd, int mem_fd, const int* efds, uint64_t ring_size, bool server) noexcept : sock(sock_fd), size(ring_size) {
+    memcpy(efd, efds, sizeof(efd));
+    fcntl(sock, F_SETFL, fcntl(sock, F_GETFL) | O_NONBLOCK);
+
+    map_size = 2 * (sizeof(ring_t) + size);
+    void* mem = mmap(nullptr, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, mem_fd, 0);
+    close(mem_fd);
+
+    if(mem == MAP_FAILED)
+        return;
+    base = (char*)mem;
+
+    ring_t* c2s = (ring_t*)base;
+    ring_t* s2c = (ring_t*)(base + sizeof(ring_t) + size);
+
+    // the memory comes zeroed, which is where both rings start.
+    tx = server ? s2c : c2s;
+    rx = server ? c2s : s2c;
+    tx_data = (char*)(tx + 1);
+    rx_data = (char*)(rx + 1);
+
+    tx_data_fd = efd[server ? S2C_DATA : C2S_DATA];
+    tx_room_fd = efd[server ? S2C_ROOM : C2S_ROOM];
+    rx_data_fd = efd[server ? C2S_DATA : S2C_DATA];
+    rx_room_fd = efd[server ? C2S_ROOM : S2C_ROOM];
+}
+
+shm_transport::~shm_transport() {
+    if(base)
+        munmap(base, map_size);
+
+    for(int fd : efd)
+        close(fd);
+    close(sock);
+}
+
+std::unique_ptr<shm_transport> shm_transport::offer(int sock_fd, uint64_t ring_size) noexcept {
+    int fds[1 + EFD_AMT] = {-1, -1, -1, -1, -1};
+    bool ok = (fds[0] = memfd_create("mp_vfs", MFD_CLOEXEC)) != -1 && ftruncate(fds[0], 2 * (sizeof(ring_t) + ring_size)) == 0;
+
+    for(int i = 1; i <= EFD_AMT && ok; i++)
+        ok = (fds[i] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) != -1;
+
+    // the ring size goes along with the descriptors, they're sent in one go down an empty socket.
+    char cmsg[CMSG_SPACE(sizeof(fds))] = {};
+    iovec iov = {&ring_size, sizeof(ring_size)};
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = cmsg;
+    msg.msg_controllen = sizeof(cmsg);
+
+    cmsghdr* hdr = CMSG_FIRSTHDR(&msg);
+    hdr->cmsg_level = SOL_SOCKET;
+    hdr->cmsg_type = SCM_RIGHTS;
+    hdr->cmsg_len = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(hdr), fds, sizeof(fds));
+
+    if(ok)
+        ok = sendmsg(sock_fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT) == (ssize_t)sizeof(ring_size);
+
+    if(!ok) {
+        for(int fd : fds) {
+            if(fd != -1)
+                close(fd);
+        }
+        close(sock_fd);
+        return nullptr;
+    }
+
+    std::unique_ptr<shm_transport> shm = std::unique_ptr<shm_transport>(new shm_transport(sock_fd, fds[0], fds + 1, ring_size, true));
+    return shm->mapped() ? std::move(shm) : nullptr;
+}
+
+std::unique_ptr<shm_transport> shm_transport::take(int sock_fd, int timeout) noexcept {
+    int fds[1 + EFD_AMT] = {-1, -1, -1, -1, -1};
+    uint64_t ring_size = {};
+    char cmsg[CMSG_SPACE(sizeof(fds))] = {};
+    iovec iov = {&ring_size, sizeof(ring_size)};
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = cmsg;
+    msg.msg_controllen = sizeof(cmsg);
+
+    pollfd pfd = {sock_fd, POLLIN, 0};
+    bool ok = poll(&pfd, 1, timeout) > 0 && recvmsg(sock_fd, &msg, MSG_CMSG_CLOEXEC) == (ssize_t)sizeof(ring_size);
+
+    cmsghdr* hdr = ok ? CMSG_FIRSTHDR(&msg) : nullptr;
+    ok = hdr && hdr->cmsg_level == SOL_SOCKET && hdr->cmsg_type == SCM_RIGHTS && hdr->cmsg_len == CMSG_LEN(sizeof(fds));
+
+    if(ok)
+        memcpy(fds, CMSG_DATA(hdr), sizeof(fds));
+
+    // the memory has to be as large as the rings the server says it holds.
+    struct stat st{};
+    ok = ok && ring_size > 0 && ring_size <= CFG_SHM_RING_MAX && fstat(fds[0], &st) == 0 && (uint64_t)st.st_size == 2 * (sizeof(ring_t) + ring_size);
+
+    if(!ok) {
+        for(int fd : fds) {
+            if(fd != -1)
+                close(fd);
+        }
+        close(sock_fd);
+        return nullptr;
+    }
+
+    std::unique_ptr<shm_transport> shm = std::unique_ptr<shm_transport>(new shm_transport(sock_fd, fds[0], fds + 1, ring_size, false));
+    return shm->mapped() ? std::move(shm) : nullptr;
+}
+
+ssize_t shm_transport::send(const iovec* iov, int iov_c) noexcept {
+    uint64_t head = tx->head.load(std::memory_order_relaxed);
+    uint64_t room = size - (head - tx->tail.load(std::memory_order_acquire));
+    uint64_t n = {};
+
+    if(room == 0) {
+        errno = EAGAIN;
+        return -1;
+    }
+
+    for(int i = 0; i < iov_c && n < room; i++) {
+        const char* p = (const char*)iov[i].iov_base;
+        uint64_t len = std::min<uint64_t>(iov[i].iov_len, room - n);
+
+        // a write that runs off the end of the ring carries on at its start.
+        uint64_t at = (head + n) % size;
+        uint64_t first = std::min(len, size - at);
+        memcpy(tx_data + at, p, first);
+        memcpy(tx_data, p + first, len - first);
+        n += len;
+    }
+
+    tx->head.store(head + n, std::memory_order_release);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    if(tx->reader_waiting.load(std::memory_order_relaxed))
+        signal(tx_data_fd);
+    return (ssize_t)n;
+}
+
+ssize_t shm_transport::recv(char* buffer, size_t cap) noexcept {
+    uint64_t tail = rx->tail.load(std::memory_order_relaxed);
+    uint64_t head = rx->head.load(std::memory_order_acquire);
+
+    // before saying it would block, the reader marks itself waiting and looks once more. the
+    // writer looks at the mark after it moves head, so one of the two always sees the other.
+    if(head == tail) {
+        clear(rx_data_fd);
+        rx->reader_waiting.store(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        if((head = rx->head.load(std::memory_order_acquire)) == tail) {
+            if(peer_gone())
+                return 0;
+
+            errno = EAGAIN;
+            return -1;
+        }
+    }
+    rx->reader_waiting.store(0, std::memory_order_relaxed);
+
+    uint64_t n = std::min<uint64_t>(head - tail, cap);
+    uint64_t at = tail % size;
+    uint64_t first = std::min(n, size - at);
+    memcpy(buffer, rx_data + at, first);
+    memcpy(buffer + first, rx_data, n - first);
+
+    rx->tail.store(tail + n, std::memory_order_release);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    if(rx->writer_waiting.load(std::memory_order_relaxed))
+        signal(rx_room_fd);
+    return (ssize_t)n;
+}
+
+bool shm_transport::wait_send(int timeout) noexcept {
+    clear(tx_room_fd);
+    tx->writer_waiting.store(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    bool ready = tx->head.load(std::memory_order_relaxed) - tx->tail.load(std::memory_order_acquire) < size;
+    if(!ready) {
+        pollfd pfd[2] = {{tx_room_fd, POLLIN, 0}, {sock, POLLIN, 0}};
+        ready = poll(pfd, 2, timeout) > 0 && !peer_gone();
+    }
+
+    tx->writer_waiting.store(0, std::memory_order_relaxed);
+    return ready;
+}
+
+bool shm_transport::wait_recv(int timeout) noexcept {
+    clear(rx_data_fd);
+    rx->reader_waiting.store(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    if(rx->head.load(std::memory_order_acquire) != rx->tail.load(std::memory_order_relaxed))
+        return true;
+
+    pollfd pfd[2] = {{rx_data_fd, POLLIN, 0}, {sock, POLLIN, 0}};
+    return poll(pfd, 2, timeout) > 0;
+}
+
+void shm_transport::watch(int epoll_fd, uint64_t id) noexcept {
+    epoll_event ev{};
+    ev.data.u64 = id;
+
+    // bytes show up on the eventfd, the socket is only there to say the client has gone.
+    ev.events = EPOLLIN | EPOLLET;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, rx_data_fd, &ev);
+
+    ev.events = EPOLLRDHUP | EPOLLET;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, sock, &ev);
+
+    // anything written before the reactor was watching would otherwise sit there unnoticed.
+    rx->reader_waiting.store(1, std::memory_order_relaxed);
+    signal(rx_data_fd);
+}
+
+void shm_transport::unwatch(int epoll_fd) noexcept {
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, rx_data_fd, nullptr);
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, sock, nullptr);
+}
+
+void shm_transport::shutdown() noexcept {
+    ::shutdown(sock, SHUT_RDWR);
+}
+
+transport::kind_t shm_transport::kind() const noexcept {
+    return SHM;
+}
+
+bool shm_transport::mapped() const noexcept {
+    return base != nullptr;
+}
+
+bool shm_transport::peer_gone() const noexcept {
+    char c;
+    ssize_t got = ::recv(sock, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+    return got == 0 || (got == -1 && errno != EAGAIN && errno != EWOULDBLOCK);
+}
+
+void shm_transport::signal(int efd) noexcept {
+    uint64_t val = 1;
+    write(efd, &val, sizeof(val));
+}
+
+void shm_transport::clear(int efd) noexcept {
+    uint64_t val;
+    read(efd, &val, sizeof(val));
+}
@@ -3,6 +3,15 @@
 using namespace VFS;
 
 vfs* vfs::mp_vfs;
+thread_local session_t* vfs::m_session = nullptr;
+
+session_t::scope::scope(session_t& session) noexcept : m_prev(vfs::m_session), m_cwd(session.cwd) {
+    vfs::m_session = &session;
+}
+
+session_t::scope::~scope() noexcept {
+    vfs::m_session = m_prev;
+}
 
 vfs::vfs() {
     sys_cmds     = std::make_shared<std::vector<vfs::cmd_t>>();
@@ -21,37 +30,54 @@ vfs* vfs::get_vfs() noexcept {
 }
 
 void vfs::umnt_disk(std::vector<std::string> &parts) {
-    if(mnted_system->mp_fs != nullptr) {
-        mnted_system->mp_fs.reset();
-        mnted_system->mp_fs = nullptr;
-        mnted_system->fs_type = "";
-        mnted_system->name    = "";
+    if(get_mnted_system()->mp_fs != nullptr) {
+        set_mnted_system(system_t("", nullptr, "", NULL, {}));
     } else BUFFER << LOG_str(log::WARNING, "There is no system currently mounted");
 }
 
 void vfs::mnt_disk(std::vector<std::string>& parts) {
-    if(disks->find(parts[1]) == disks->end()) {
+    auto disk = disks->find(parts[1]);
+
+    if(disk == disks->end()) {
         BUFFER << LOG_str(log::WARNING, "disk does not exist within the vfs");
 
         return;
     }
 
-    if(mnted_system->mp_fs != nullptr) {
+    if(get_mnted_system()->mp_fs != nullptr) {
         BUFFER << LOG_str(log::WARNING, "Unmount the current system before mounting another");
         return;
     }
 
+    bool remote = strcmp(disk->second.fs_type, "RFS::rfs") == 0;
+    if(remote && m_session) {
+        BUFFER << LOG_str(log::WARNING, "A remote session can only mount disks on this server");
+        return;
+    }
+
     BUFFER << "\r\n--------------------  " << parts[1].c_str() << "  --------------------\n";
     BUFFER << LOG_str(log::INFO, "Mounting '" + parts[1] + "' as primary mp_fs on the vfs");
-    disks->find(parts[1])->second.mp_fs = typetofs(parts[1].c_str(), disks->find(parts[1])->second.fs_type);
 
-    this->mnted_system->name    = parts[1].c_str();
-    this->mnted_system->fs_type = disks->find(parts[1])->second.fs_type;
-    this->mnted_system->mp_fs      = *&(disks->find(parts[1])->second.mp_fs);
+    // a disk is loaded once, the console and every session that mounts it share the one fat32.
+    if(disk->second.mp_fs == nullptr || remote)
+        disk->second.mp_fs = typetofs(parts[1].c_str(), disk->second.fs_type);
 
-    if(dynamic_cast<RFS::rfs*>(this->mnted_system->mp_fs.get()))
-        this->mnted_system->access = &vfs::rfs_cmd_func;
-    else this->mnted_system->access  = &vfs::ifs_cmd_func;
+    system_t system(disk->first.c_str(), disk->second.mp_fs, disk->second.fs_type, &vfs::ifs_cmd_func, disk->second.conn);
+    if(remote)
+        system.access = &vfs::rfs_cmd_func;
+
+    set_mnted_system(system);
+}
+
+void vfs::set_mnted_system(const system_t& system) noexcept {
+    std::lock_guard<std::mutex> lock(m_view_lock);
+
+    // the view is swapped rather than changed in place, a command still running on the old one keeps it.
+    if(m_session)
+        m_session->mnted_system = std::make_shared<system_t>(system);
+    else mnted_system = std::make_shared<system_t>(system);
+
+    get_cwd().clu = ROOT_CLUSTER;
 }
 
 void vfs::add_disk(std::vector<std::string>& parts) {
@@ -72,7 +98,7 @@ void vfs::rm_disk(std::vector<std::string>& parts) {
     fs* tmp = (disks->find(parts[2])->second.mp_fs.get());
 
     if(tmp) {
-        if(tmp == mnted_system->mp_fs.get()){
+        if(tmp == get_mnted_system()->mp_fs.get()){
             umnt_disk(parts); // erases mounted system information, if disk deleted is mounted.
         }
     }
@@ -87,18 +113,21 @@ void vfs::add_remote(std::vector<std::string>& parts) {
         return;
     }
 
-    (*disks).insert(std::make_pair(parts[2], system_t{parts[2].c_str(), nullptr, "RFS::rfs", nullptr, system_t::sock_conn_t{parts[3].c_str(), atoi(parts[4].c_str())}})); // add RFS::rfs system with ip and address
+    (*disks).insert(std::make_pair(parts[2], system_t{parts[2].c_str(), nullptr, "RFS::rfs", nullptr, system_t::sock_conn_t{strdup(parts[3].c_str()), atoi(parts[4].c_str())}})); // add RFS::rfs system with ip and address
 }
 
 void vfs::rm_remote(std::vector<std::string>& parts) {
-    if(mnted_system->mp_fs)
-        if(disks->find(parts[2])->second.mp_fs == mnted_system->mp_fs)
+    std::shared_ptr<system_t> system = get_mnted_system();
+
+    if(system->mp_fs)
+        if(disks->find(parts[2])->second.mp_fs == system->mp_fs)
             umnt_disk(parts); // erases mounted system information, if RFS::rfs deleted is mounted.
 
     disks->erase(parts[2]); // deletes file system, on heap.
 }
 
 void vfs::lst_disks(std::vector<std::string>& parts) {
+    std::shared_ptr<system_t> system = get_mnted_system();
     BUFFER << "\r-----------------  vfs  ---------------\n";
 
     if(disks->empty()) {
@@ -111,7 +140,7 @@ void vfs::lst_disks(std::vector<std::string>& parts) {
             BUFFER << " -> (name)" << disk.first.c_str() << " : (address)" << disk.second.conn.addr << ", (port)" << disk.second.conn.port;
         } else BUFFER << " -> (name)" << disk.first.c_str() << " : (filesystem)" << disk.second.fs_type;
 
-        if(strcmp(mnted_system->name, disk.first.c_str()) == 0) {
+        if(strcmp(system->name, disk.first.c_str()) == 0) {
             BUFFER << " ~ [ Mounted ]";
         }
 
@@ -122,6 +151,19 @@ void vfs::lst_disks(std::vector<std::string>& parts) {
     BUFFER << "----------------  END  ----------------\n\n";
 }
 
+void vfs::rfs_stats(std::vector<std::string>& parts) {
+    BUFFER << "\r-----------------  rfs  ---------------\n";
+
+    if(server)
+        server->print_stats("server");
+
+    for(auto& disk : *disks) {
+        if(strcmp(disk.second.fs_type, "RFS::rfs") == 0 && disk.second.mp_fs)
+            dynamic_cast<RFS::rfs*>(disk.second.mp_fs.get())->print_stats(disk.first);
+    }
+    BUFFER << "----------------  END  ----------------\n\n";
+}
+
 void vfs::init_server(std::vector<std::string>& args) {
     if(server == nullptr) {
         server = std::make_unique<RFS::server>();
@@ -136,7 +178,7 @@ void vfs::init_sys_cmds() noexcept {
     sys_cmds->push_back({system_cmd::vfs_,
                          {flag_t{"ls", &vfs::lst_disks, "lists the current mounted systems                          | -> [/vfs ls]"},
                           flag_t{"ifs", &vfs::control_ifs, "controls internal file systems within the vfs             | -> [/vfs ifs add/rm <DISK_NAME> <FS_TYPE>]"},
-                          flag_t{"rfs", &vfs::control_rfs, "controls remote file systems within the vfs               | -> [/vfs rfs add/rm <NAME> <IP> <PORT>]"},
+                          flag_t{"rfs", &vfs::control_rfs, "controls remote file systems within the vfs               | -> [/vfs rfs add/rm <NAME> <IP> <PORT>], [/vfs rfs stats]"},
                           flag_t{"mnt", &vfs::mnt_disk, "initialises the file system and mounts it towards the vfs | -> [/vfs mnt <DISK_NAME>]"},
                           flag_t{"umnt", &vfs::umnt_disk, "deletes file system data/disk from vfs                   | -> [/vfs umnt"},
                           flag_t{"server", &vfs::init_server, "toggles server initialisation for client connection on local host on specified port"}},
@@ -156,6 +198,12 @@ void vfs::init_sys_cmds() noexcept {
 }
 
 void vfs::control_vfs(const std::vector<std::string>& parts) noexcept { // checks vfs flags, if none print help. if not, carry out function.
+    // a session can only change its own view, disks and the server belong to the console.
+    if(m_session && parts[0] != "ls" && parts[0] != "mnt" && parts[0] != "umnt") {
+        BUFFER << LOG_str(log::WARNING, "Only [/vfs ls], [/vfs mnt] and [/vfs umnt] can be used remotely");
+        return;
+    }
+
     for(auto & sys_cmd : *sys_cmds) {
         if(vfs::system_cmd::vfs_ == sys_cmd.cmd) {
             for(int j = 0; j < sys_cmd.flags.size(); j++) {
@@ -205,6 +253,7 @@ void vfs::control_rfs(std::vector<std::string>& parts) noexcept {
     switch(lib_::hash(parts[1].c_str())) {
         case lib_::hash("add"): add_remote(parts); return;
         case lib_::hash("rm"):  rm_remote(parts);  return;
+        case lib_::hash("stats"): rfs_stats(parts); return;
     }
 }
 
@@ -236,17 +285,30 @@ void vfs::load_disks() noexcept {
 std::shared_ptr<fs> vfs::typetofs(const char* name, const char *fs_type) noexcept {
     switch(lib_::hash(fs_type)) {
         case lib_::hash("fat32"): return std::make_shared<IFS::fat32>(name);
-        case lib_::hash("rfs"): auto rm = disks->find(name); return std::make_shared<RFS::client>(rm->second.conn.addr, rm->second.conn.port);
+        case lib_::hash("RFS::rfs"): auto rm = disks->find(name); return std::make_shared<RFS::client>(rm->second.conn.addr, rm->second.conn.port);
     }
     return std::make_shared<IFS::fat32>(name);
 }
 
-const bool vfs::is_mnted() const noexcept {
-    return this->mnted_system->mp_fs != nullptr;
+const bool vfs::is_mnted() noexcept {
+    return get_mnted_system()->mp_fs != nullptr;
+}
+
+std::shared_ptr<vfs::system_t> vfs::get_mnted_system() noexcept {
+    std::lock_guard<std::mutex> lock(m_view_lock);
+
+    if(m_session == nullptr)
+        return mnted_system;
+
+    // a session takes its own copy of the console's mount the first time there's one to take.
+    if(m_session->mnted_system == nullptr && mnted_system->mp_fs != nullptr)
+        m_session->mnted_system = std::make_shared<system_t>(*mnted_system);
+
+    return m_session->mnted_system ? m_session->mnted_system : mnted_system;
 }
 
-std::shared_ptr<vfs::system_t>& vfs::get_mnted_system() noexcept {
-    return mnted_system;
+IFS::fat32::cwd_t& vfs::get_cwd() noexcept {
+    return m_session ? m_session->cwd : console_cwd;
 }
 
 std::shared_ptr<std::vector<vfs::cmd_t>> vfs::get_sys_cmds() noexcept {
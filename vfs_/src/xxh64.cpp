@@ -0,0 +1,71 @@
+#include "../include/xxh64.h"
+
+using namespace VFS;
+
+uint64_t xxh64::rotl(uint64_t val, int bits) noexcept {
+    return (val << bits) | (val >> (64 - bits));
+}
+
+uint64_t xxh64::read64(const uint8_t* p) noexcept {
+    uint64_t val;
+    memcpy(&val, p, sizeof(val));
+    return val;
+}
+
+uint32_t xxh64::read32(const uint8_t* p) noexcept {
+    uint32_t val;
+    memcpy(&val, p, sizeof(val));
+    return val;
+}
+
+uint64_t xxh64::round(uint64_t acc, uint64_t input) noexcept {
+    acc += input * PRIME_2;
+    acc = rotl(acc, 31);
+    return acc * PRIME_1;
+}
+
+uint64_t xxh64::merge(uint64_t acc, uint64_t val) noexcept {
+    acc ^= round(0, val);
+    return acc * PRIME_1 + PRIME_4;
+}
+
+uint64_t xxh64::hash(const char* data, size_t n, uint64_t seed) noexcept {
+    const uint8_t* p = (const uint8_t*)data;
+    const uint8_t* end = p + n;
+    uint64_t h = {};
+
+    if(n >= 32) {
+        uint64_t v[4] = {seed + PRIME_1 + PRIME_2, seed + PRIME_2, seed, seed - PRIME_1};
+
+        for(; p + 32 <= end; p += 32) {
+            for(int i = 0; i < 4; i++)
+                v[i] = round(v[i], read64(p + 8 * i));
+        }
+
+        h = rotl(v[0], 1) + rotl(v[1], 7) + rotl(v[2], 12) + rotl(v[3], 18);
+        for(int i = 0; i < 4; i++)
+            h = merge(h, v[i]);
+    } else
+        h = seed + PRIME_5;
+
+    h += n;
+
+    // whatever is left past the last block goes in 8, 4 and then 1 byte at a time.
+    for(; p + 8 <= end; p += 8)
+        h = rotl(h ^ round(0, read64(p)), 27) * PRIME_1 + PRIME_4;
+
+    if(p + 4 <= end) {
+        h = rotl(h ^ ((uint64_t)read32(p) * PRIME_1), 23) * PRIME_2 + PRIME_3;
+        p += 4;
+    }
+
+    for(; p < end; p++)
+        h = rotl(h ^ (*p * PRIME_5), 11) * PRIME_1;
+
+    h ^= h >> 33;
+    h *= PRIME_2;
+    h ^= h >> 29;
+    h *= PRIME_3;
+    h ^= h >> 32;
+    return h;
+}